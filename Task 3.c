@@ -1,7 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 #include <mpi.h>
+#include "common/philox.h"
+#include "common/threads.h"
+#include "common/elementwise.h"
+#include "common/pipeline.h"
+#include "common/shared_array.h"
+#include "common/distribution.h"
+#include "common/bench.h"
+#include "common/prof_regions.h"
+#include "common/perf_counters.h"
+#include "common/large_count.h"
+#include "common/block_source.h"
+#include "common/arrayfile.h"
+#include "common/arena.h"
+#include "common/expr.h"
+#include "common/comm_plan.h"
 
 #define ITERATIONS 100
 #define DEFAULT_SIZE 30000000
@@ -11,172 +27,944 @@ typedef struct {
     double sub_time;
     double mul_time;
     double div_time;
+    double fused_time;
+    PerfKernel* perf;  // counters per operation (OP_ADD .. OP_FUSED), NULL when off
 } OpTimes;
 
-void fill_arrays(double* a, double* b, int size, unsigned int seed) {
+enum { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_FUSED, NUM_OPS };
+
+void fill_arrays(double* a, double* b, long long size, unsigned int seed) {
     srand(seed);
-    for (int i = 0; i < size; i++) {
+    for (long long i = 0; i < size; i++) {
         a[i] = (double)(rand() % 100 + 1); // Avoid division by zero
         b[i] = (double)(rand() % 100 + 1);
     }
 }
 
+// Counter-based fill keyed by global index: a rank can generate its own
+// slice of a and b, and the values do not depend on the process count.
+void fill_arrays_philox(double* a, double* b, long long first, long long size, unsigned int seed) {
+    philox_fill_double(a, (size_t)first, (size_t)size, seed, 0, 1, 100); // Avoid division by zero
+    philox_fill_double(b, (size_t)first, (size_t)size, seed, 1, 1, 100);
+}
+
+PerfKernel* op_perf(const OpTimes* times, int op) {
+    return times->perf ? &times->perf[op] : NULL;
+}
+
+// Zeroes the accumulated times and counters, keeping the counter set
+void op_times_reset(OpTimes* times) {
+    PerfKernel* perf = times->perf;
+    memset(times, 0, sizeof(*times));
+    times->perf = perf;
+    for (int op = 0; perf && op < NUM_OPS; op++) perf_kernel_reset(&perf[op]);
+}
+
+// Each loop is split across `threads` OpenMP threads (1 = plain loop)
 void array_operations_timed(double* a, double* b, double* add, double* sub,
-                          double* mul, double* div, int size, OpTimes* times) {
+                          double* mul, double* div, long long size, int threads, OpTimes* times) {
     double start;
     
+    perf_kernel_begin(op_perf(times, OP_ADD));
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) add[i] = a[i] + b[i];
+    ew_op(EW_ADD, a, b, add, (size_t)size, threads);
     times->add_time += MPI_Wtime() - start;
+    perf_kernel_end(op_perf(times, OP_ADD), (size_t)size);
     
+    perf_kernel_begin(op_perf(times, OP_SUB));
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) sub[i] = a[i] - b[i];
+    ew_op(EW_SUB, a, b, sub, (size_t)size, threads);
     times->sub_time += MPI_Wtime() - start;
+    perf_kernel_end(op_perf(times, OP_SUB), (size_t)size);
     
+    perf_kernel_begin(op_perf(times, OP_MUL));
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) mul[i] = a[i] * b[i];
+    ew_op(EW_MUL, a, b, mul, (size_t)size, threads);
     times->mul_time += MPI_Wtime() - start;
+    perf_kernel_end(op_perf(times, OP_MUL), (size_t)size);
     
+    perf_kernel_begin(op_perf(times, OP_DIV));
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) div[i] = a[i] / b[i];
+    ew_op(EW_DIV, a, b, div, (size_t)size, threads);
     times->div_time += MPI_Wtime() - start;
+    perf_kernel_end(op_perf(times, OP_DIV), (size_t)size);
+}
+
+// Single streaming pass computing all four results (ELEMENTWISE=fused)
+void array_operations_fused(double* a, double* b, double* add, double* sub,
+                          double* mul, double* div, long long size, int threads, OpTimes* times) {
+    perf_kernel_begin(op_perf(times, OP_FUSED));
+    double start = MPI_Wtime();
+    ew_fused_threaded(a, b, add, sub, mul, div, (size_t)size, threads);
+    times->fused_time += MPI_Wtime() - start;
+    perf_kernel_end(op_perf(times, OP_FUSED), (size_t)size);
+}
+
+typedef void (*ArrayOpsFn)(double*, double*, double*, double*, double*, double*,
+                           long long, int, OpTimes*);
+
+typedef struct {
+    ArrayOpsFn ops;
+    double* add, * sub, * mul, * div;
+    int threads;
+    OpTimes* times;
+} OpsContext;
+
+// Pipeline consumer: runs the operations on one received chunk of a and b
+void ops_chunk(void* const* chunks, int count, int offset, void* ctx) {
+    OpsContext* ops_ctx = (OpsContext*)ctx;
+    double start = MPI_Wtime();
+    ops_ctx->ops((double*)chunks[0], (double*)chunks[1], ops_ctx->add + offset,
+                 ops_ctx->sub + offset, ops_ctx->mul + offset, ops_ctx->div + offset,
+                 count, ops_ctx->threads, ops_ctx->times);
+    prof_region("local_ops", start, MPI_Wtime());
+}
+
+typedef struct {
+    double* buffer;  // a, b and the four results, or the inputs and the result; n elements each
+    ArrayOpsFn ops;
+    const Expr* expr;  // EXPR mode
+    int threads;
+    OpTimes times;
+} CalibrationContext;
+
+// Calibration kernel for BALANCE=calibrate: the selected operations
+void ops_calibration(size_t n, void* ctx) {
+    CalibrationContext* calib = (CalibrationContext*)ctx;
+    double* x = calib->buffer;
+    calib->ops(x, x + n, x + 2 * n, x + 3 * n, x + 4 * n, x + 5 * n,
+               (long long)n, calib->threads, &calib->times);
+}
+
+// The same for EXPR: the pass each rank will run
+void expr_calibration(size_t n, void* ctx) {
+    CalibrationContext* calib = (CalibrationContext*)ctx;
+    const double* inputs[EXPR_MAX_INPUTS];
+    int num_inputs = calib->expr->num_inputs;
+    for (int k = 0; k < num_inputs; k++) inputs[k] = calib->buffer + (size_t)k * n;
+    expr_eval_threaded(calib->expr, inputs, calib->buffer + (size_t)num_inputs * n, n, calib->threads);
+}
+
+// Streaming mode: runs the operations on elements [first, first + count)
+// of the sources one block of `block_size` elements at a time; the results
+// of a block are overwritten by the next. *read_time accumulates the time
+// spent reading (or generating) a and b.
+void stream_operations(const BlockSource* src_a, const BlockSource* src_b, double* a, double* b,
+                       double* add, double* sub, double* mul, double* div, long long first,
+                       long long count, long long block_size, ArrayOpsFn ops, int threads,
+                       OpTimes* times, const char* region, double* read_time) {
+    for (long long done = 0; done < count; done += block_size) {
+        long long n = count - done < block_size ? count - done : block_size;
+        double read_start = MPI_Wtime();
+        if (block_source_read(src_a, a, first + done, n) != 0 ||
+            block_source_read(src_b, b, first + done, n) != 0) {
+            printf("Error: Reading elements %lld..%lld failed\n", first + done, first + done + n - 1);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        double read_end = MPI_Wtime();
+        *read_time += read_end - read_start;
+        ops(a, b, add, sub, mul, div, n, threads, times);
+        prof_region(region, read_end, MPI_Wtime());
+    }
+}
+
+// Per-iteration samples: what one iteration added to each timed operation
+// (one sample in fused mode, four in timed mode)
+int op_times_delta(const OpTimes* before, const OpTimes* after, int fused, double* out) {
+    if (fused) {
+        out[0] = after->fused_time - before->fused_time;
+        return 1;
+    }
+    out[0] = after->add_time - before->add_time;
+    out[1] = after->sub_time - before->sub_time;
+    out[2] = after->mul_time - before->mul_time;
+    out[3] = after->div_time - before->div_time;
+    return 4;
+}
+
+void print_speedup(const char* name, const BenchSeries* seq, const BenchSeries* par,
+                   const BenchConfig* bench) {
+    printf("%s: %.2fx\n", name, bench_speedup(seq, par, bench));
+}
+
+// EXPR mode: one expression over inputs a, b, c, ... (Philox stream k in
+// [1, 100] for input k, so a and b are the arrays of the other modes),
+// scattered with the same distribution and evaluated in a single fused pass
+// per rank into one result slice. The result stays distributed and is
+// checked against rank 0's sequential result by checksum. Returns 0 when
+// they match.
+int run_expression(const Expr* expr, const char* text, const Distribution* dist, long long array_size,
+                   int local_gen, unsigned int seed, int threads, int persistent) {
+    int rank, num_procs, inputs = expr->num_inputs;
+    long long local_size = dist->local_count;
+    size_t local_bytes = (size_t)(local_size > 0 ? local_size : 1) * sizeof(double);
+    size_t full_bytes = (size_t)array_size * sizeof(double);
+    double* full[EXPR_MAX_INPUTS] = {NULL}, * local[EXPR_MAX_INPUTS] = {NULL};
+    CommPlan plans[EXPR_MAX_INPUTS];
+    double* seq_out = NULL, * local_out;
+    double seq_time = 0.0, par_time = 0.0;
+    Arena arena;
+    MemUsage mem_before, mem_after;
+    BenchConfig bench;
+    BenchSeries series[3];
+    BenchWarmup warmup = {{0}, 0};
+    int warming, warmup_iterations = 0;
+    static const char* names[] = {"sequential_expr", "parallel_expr", "parallel_with_scatter"};
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    // The input slices and the result slice; on rank 0 also the whole
+    // inputs and the sequential result
+    size_t arena_capacity = (size_t)(inputs + 1) * arena_size(local_bytes) +
+                            (rank == 0 ? (size_t)(inputs + 1) * arena_size(full_bytes) : 0);
+    if (arena_init(&arena, arena_capacity, threads) != 0) {
+        printf("Error: Memory allocation failed for %.1f MB of buffers in process %d\n",
+               arena_capacity / 1e6, rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int k = 0; k < inputs; k++) {
+        local[k] = (double*)arena_alloc(&arena, local_bytes);
+        if (rank == 0) full[k] = (double*)arena_alloc(&arena, full_bytes);
+        if (!local[k] || (rank == 0 && !full[k])) {
+            printf("Error: Arena too small for the buffers of process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    local_out = (double*)arena_alloc(&arena, local_bytes);
+    if (rank == 0) seq_out = (double*)arena_alloc(&arena, full_bytes);
+    if (!local_out || (rank == 0 && !seq_out)) {
+        printf("Error: Arena too small for the buffers of process %d\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    for (int k = 0; k < inputs; k++) {
+        if (rank == 0) philox_fill_double(full[k], 0, (size_t)array_size, seed, (uint32_t)k, 1, 100);
+        if (local_gen) {
+            philox_fill_double(local[k], (size_t)dist->local_first, (size_t)local_size, seed, (uint32_t)k, 1, 100);
+        }
+    }
+
+    // One scatter plan per input, all started together every iteration
+    for (int k = 0; k < inputs && !local_gen; k++) {
+        int rc = comm_plan_scatterv(&plans[k], full[k], dist->counts, dist->displs, MPI_DOUBLE, local[k],
+                                    local_size, 0, MPI_COMM_WORLD, persistent);
+        if (rc != MPI_SUCCESS) {
+            printf("Error: Setting up the scatter of %c failed in process %d\n", 'a' + k, rank);
+            MPI_Abort(MPI_COMM_WORLD, rc);
+        }
+    }
+
+    bench_config_from_env(&bench, ITERATIONS);
+    for (int i = 0; i < 3; i++) {
+        if (bench_series_init(&series[i], names[i], bench.iterations) != 0) {
+            printf("Error: Memory allocation failed for benchmark samples\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    warming = bench.max_warmup > 0;
+    mem_usage_now(&mem_before);
+
+    for (int iter = 0, measured = 0; measured < bench.iterations; iter++) {
+        double seq_sample = 0.0;
+        if (rank == 0) {
+            double seq_start = MPI_Wtime();
+            expr_eval(expr, (const double* const*)full, seq_out, (size_t)array_size);
+            seq_sample = MPI_Wtime() - seq_start;
+            prof_region("sequential_expr", seq_start, seq_start + seq_sample);
+        }
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double par_start = MPI_Wtime();
+        if (!local_gen) {
+            int rc = comm_plan_run_all(plans, inputs);
+            if (rc != MPI_SUCCESS) {
+                printf("Error in MPI_Scatterv of the inputs in process %d\n", rank);
+                MPI_Abort(MPI_COMM_WORLD, rc);
+            }
+        }
+        double ops_start = MPI_Wtime();
+        expr_eval_threaded(expr, (const double* const*)local, local_out, (size_t)local_size, threads);
+        double par_sample = MPI_Wtime() - ops_start;
+        prof_region("local_expr", ops_start, ops_start + par_sample);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double par_end = MPI_Wtime();
+
+        if (warming) {
+            int done = 0;
+            if (rank == 0) done = bench_warmup_done(&warmup, &bench, par_sample);
+            MPI_Bcast(&done, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            warmup_iterations++;
+            if (done) {
+                warming = 0;
+                mem_usage_now(&mem_before);
+            }
+        } else {
+            if (rank == 0) {
+                bench_series_add(&series[0], seq_sample);
+                bench_series_add(&series[1], par_sample);
+                bench_series_add(&series[2], par_end - par_start);
+            }
+            seq_time += seq_sample;
+            par_time += par_sample;
+            measured++;
+        }
+    }
+
+    mem_usage_now(&mem_after);
+
+    // Elementwise results do not depend on the split: the checksums agree exactly
+    uint64_t par_checksum = arrayfile_checksum_all(local_out, ARRAYFILE_FLOAT64, dist->local_first, local_size,
+                                                   MPI_COMM_WORLD);
+    int match = rank == 0 && arrayfile_checksum(seq_out, ARRAYFILE_FLOAT64, 0, (size_t)array_size) == par_checksum;
+    MPI_Bcast(&match, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        const char* data_mode = local_gen ? "rank-local (Philox)" : "rank 0 + MPI_Scatterv";
+        int iterations = bench.iterations;
+
+        if (bench_human_output(&bench)) {
+            printf("=== Array Expression Benchmark ===\n");
+            printf("Expression: %s\n", text);
+            printf("Program: %d instructions, %d inputs, %d tile registers of %d elements\n",
+                   expr->length, inputs, expr->depth, EXPR_TILE);
+            printf("Array size: %lld\n", array_size);
+            printf("Processes: %d\n", num_procs);
+            printf("Layout: %d ranks x %d threads\n", num_procs, threads);
+            printf("Iterations: %d (after %d warm-up)\n", iterations, warmup_iterations);
+            printf("Data generation: %s\n", data_mode);
+            printf("Balance: %s (largest slice %lld elements)\n",
+                   dist->weighted ? "calibrated throughput weights" : "even", dist->max_count);
+            if (!local_gen) printf("Collectives: %s\n", comm_plan_backend(persistent));
+
+            printf("\nAverage sequential time: %.6f sec\n", seq_time / iterations);
+            printf("Average parallel time: %.6f sec\n", par_time / iterations);
+            print_speedup("Speedup (medians)", &series[0], &series[1], &bench);
+
+            BenchStats seq_stats, stats;
+            bench_stats(&series[0], &bench, &seq_stats);
+            bench_stats(&series[2], &bench, &stats);
+            printf("\nIncluding the %s of the inputs (median):\n", local_gen ? "generation" : "scatter");
+            printf("Parallel time: %.6f sec\n", stats.median);
+            printf("Speedup: %.2fx\n", stats.median > 0 ? seq_stats.median / stats.median : 0.0);
+
+            double fused_bytes = expr_traffic_bytes(expr, (size_t)array_size);
+            double unfused_bytes = expr_unfused_traffic_bytes(expr, (size_t)array_size);
+            printf("\nMemory traffic per iteration:\n");
+            printf("One pass per operation: %.1f MB, fused: %.1f MB\n", unfused_bytes / 1e6, fused_bytes / 1e6);
+
+            printf("\nResult checksum: %016llx (%s)\n", (unsigned long long)par_checksum,
+                   match ? "matches sequential" : "MISMATCH with sequential");
+        }
+
+        BenchParam params[6];
+        bench_param(&params[0], "array_size", "%.0f", array_size);
+        bench_param(&params[1], "processes", "%.0f", num_procs);
+        bench_param(&params[2], "threads", "%.0f", threads);
+        bench_param_str(&params[3], "data", data_mode);
+        bench_param_str(&params[4], "expr", text);
+        bench_param_str(&params[5], "comm_plan", persistent ? "persistent" : "replay");
+        bench_report(&bench, "task3", series, 3, params, 6, warmup_iterations);
+    }
+    if (bench_human_output(&bench)) {
+        numa_report(MPI_COMM_WORLD);
+        mem_usage_report(&mem_before, &mem_after, MPI_COMM_WORLD);
+    }
+
+    for (int k = 0; k < inputs && !local_gen; k++) comm_plan_free(&plans[k]);
+    for (int i = 0; i < 3; i++) bench_series_free(&series[i]);
+    arena_free(&arena);
+    return match ? 0 : 1;
 }
 
 int main(int argc, char* argv[]) {
-    int rank, num_procs, array_size, local_size;
+    int rank, num_procs;
+    long long array_size, local_size, alloc_size;
+    size_t local_bytes;
     double* a = NULL, * b = NULL;
     double* local_a = NULL, * local_b = NULL;
     double* local_add = NULL, * local_sub = NULL;
     double* local_mul = NULL, * local_div = NULL;
+    double* seq_add = NULL, * seq_sub = NULL, * seq_mul = NULL, * seq_div = NULL;
+    Arena arena;
+    MemUsage mem_before, mem_after;
 
     OpTimes seq_times = {0}, par_times = {0};
+    PerfCounters counters;
+    PerfKernel perf_kernels[2 * NUM_OPS];  // sequential, then local
+    int perf;
+    static const char* perf_names[] = {"sequential_add", "sequential_sub", "sequential_mul",
+                                       "sequential_div", "sequential_fused", "local_add",
+                                       "local_sub", "local_mul", "local_div", "local_fused"};
+    unsigned int seed;
+    int local_gen, threads, thread_support, fused;
+    int pipelined, chunk_size, pipeline_depth, shared;
+    long long stream_block;
+    int streaming;
+    BlockSource source_a, source_b;
+    char* stream_file_a, * stream_file_b;
+    ArrayInput input_a, input_b;
+    char* input_a_file, * input_b_file;
+    int from_file;
+    Distribution dist;
+    ScatterPipeline pipeline;
+    SharedArray shared_a, shared_b;
+    double blocking_scatter_time = 0.0;
+    int persistent, planned_scatter;
+    CommPlan scatter_plans[2];  // a and b
+    BenchConfig bench;
+    BenchSeries series[9];  // sequential then parallel per timed operation, then with scatter
+    BenchWarmup warmup = {{0}, 0};
+    int num_ops, warming, warmup_iterations = 0;
+    static const char* fused_names[] = {"sequential_fused", "parallel_fused"};
+    static const char* timed_names[] = {"sequential_add", "sequential_sub", "sequential_mul",
+                                        "sequential_div", "parallel_add", "parallel_sub",
+                                        "parallel_mul", "parallel_div"};
 
-    // Initialize MPI
-    MPI_Init(&argc, &argv);
+    // Initialize MPI (only the main thread of each rank calls MPI)
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
+    // Hybrid mode: THREADS_PER_RANK threads share each rank's slice
+    threads = threads_per_rank();
+    if (threads > 1 && thread_support < MPI_THREAD_FUNNELED) {
+        if (rank == 0) {
+            printf("Warning: MPI library lacks MPI_THREAD_FUNNELED, using 1 thread per rank\n");
+        }
+        threads = 1;
+    }
+    // PERF_COUNTERS=1: the counters open before numa_setup starts the
+    // OpenMP threads, as only threads started later inherit them
+    perf = perf_counters_requested();
+    if (perf) perf_counters_open(&counters);
+
+    // Pinning, and the big buffers on each rank's own NUMA node
+    numa_setup(threads, MPI_COMM_WORLD);
+
     // Get array size from environment or use default
     char* size_str = getenv("ARRAY_SIZE");
-    array_size = size_str ? atoi(size_str) : DEFAULT_SIZE;
+    array_size = size_str ? atoll(size_str) : DEFAULT_SIZE;
+
+    // DATA_GEN=local: every rank generates its own slices of a and b
+    char* data_gen_str = getenv("DATA_GEN");
+    local_gen = data_gen_str && strcmp(data_gen_str, "local") == 0;
+    seed = (unsigned int)time(NULL);
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+
+    // INPUT_A and INPUT_B: operate on float64 array files (tools/make_array.c)
+    // instead of random data; every rank reads only its own slices
+    // (common/arrayfile.h)
+    input_a_file = getenv("INPUT_A");
+    input_b_file = getenv("INPUT_B");
+    from_file = input_a_file || input_b_file;
+    if (from_file) {
+        int use_mmap = array_input_mmap_from_env(MPI_COMM_WORLD);
+        if (!input_a_file || !input_b_file ||
+            array_input_open(&input_a, input_a_file, ARRAYFILE_FLOAT64, use_mmap, MPI_COMM_WORLD) != 0 ||
+            array_input_open(&input_b, input_b_file, ARRAYFILE_FLOAT64, use_mmap, MPI_COMM_WORLD) != 0) {
+            if (rank == 0) printf("Error: INPUT_A and INPUT_B must both be float64 array files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        if (array_input_count(&input_a) != array_input_count(&input_b)) {
+            if (rank == 0) printf("Error: INPUT_A and INPUT_B differ in length\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        array_size = array_input_count(&input_a);
+        local_gen = 0;
+    }
 
-    // Check if array size is divisible by number of processes
-    if (array_size % num_procs != 0) {
+    // STREAM_BLOCK: out-of-core mode, every rank reads its slices block by
+    // block from STREAM_FILE_A and STREAM_FILE_B (raw doubles) or generates
+    // them, so memory stays at six blocks per rank however large the arrays are
+    stream_block = stream_block_from_env();
+    streaming = stream_block > 0 && !from_file;
+    stream_file_a = getenv("STREAM_FILE_A");
+    stream_file_b = getenv("STREAM_FILE_B");
+    if (streaming && (stream_file_a || stream_file_b)) {
+        if (!stream_file_a || !stream_file_b ||
+            block_source_file(&source_a, stream_file_a, sizeof(double)) != 0 ||
+            block_source_file(&source_b, stream_file_b, sizeof(double)) != 0) {
+            printf("Error: Cannot open STREAM_FILE_A and STREAM_FILE_B in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        long long file_size = source_a.count < source_b.count ? source_a.count : source_b.count;
+        if (!size_str || array_size <= 0 || array_size > file_size) array_size = file_size;
+    } else if (streaming) {
+        block_source_philox_double(&source_a, seed, 0, 1, 100); // Avoid division by zero
+        block_source_philox_double(&source_b, seed, 1, 1, 100);
+    }
+    local_gen = local_gen && !streaming;  // streaming replaces the other data modes
+
+    if (array_size <= 0) {
         if (rank == 0) {
-            printf("Error: Array size (%d) must be divisible by number of processes (%d)\n",
-                array_size, num_procs);
+            printf("Error: Invalid array size %lld\n", array_size);
         }
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
-    local_size = array_size / num_procs;
 
-    // Allocate memory
-    if (rank == 0) {
-        a = (double*)malloc(array_size * sizeof(double));
-        b = (double*)malloc(array_size * sizeof(double));
-        if (a == NULL || b == NULL) {
-            printf("Error: Memory allocation failed for main arrays\n");
+    // ELEMENTWISE=fused (default) or timed (four separately timed passes)
+    char* elementwise_str = getenv("ELEMENTWISE");
+    fused = !(elementwise_str && strcmp(elementwise_str, "timed") == 0);
+    ArrayOpsFn array_operations = fused ? array_operations_fused : array_operations_timed;
+
+    // EXPR: one fused expression over several inputs (common/expr.h) instead
+    // of the four operations
+    char* expr_text = getenv("EXPR");
+    Expr expr;
+    if (expr_text && expr_compile(&expr, expr_text) != 0) {
+        if (rank == 0) printf("Error: EXPR: %s\n", expr.error);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // SCATTER=pipelined: chunked MPI_Iscatterv of a and b overlapped with the operations
+    char* scatter_str = getenv("SCATTER");
+    pipelined = !local_gen && !streaming && !from_file && scatter_str && strcmp(scatter_str, "pipelined") == 0;
+    // SCATTER=shared: a and b live in node-shared windows, slices are read in place
+    shared = !local_gen && !streaming && !from_file && scatter_str && strcmp(scatter_str, "shared") == 0;
+    pipeline_params_from_env(&chunk_size, &pipeline_depth);
+
+    // Slices for MPI_Scatterv: any array size; even, or weighted by each
+    // rank's measured throughput with BALANCE=calibrate
+    int dist_rc;
+    if (distribution_calibrate_requested()) {
+        size_t calib_size = 1 << 18;
+        size_t arrays = expr_text ? (size_t)expr.num_inputs + 1 : 6;
+        CalibrationContext calib = {0};
+        calib.buffer = (double*)calloc(arrays * calib_size, sizeof(double));
+        calib.ops = array_operations;
+        calib.expr = expr_text ? &expr : NULL;
+        calib.threads = threads;
+        double throughput = calib.buffer ? distribution_calibrate(expr_text ? expr_calibration : ops_calibration,
+                                                                  &calib, calib_size, 5) : 0.0;
+        free(calib.buffer);
+        dist_rc = distribution_init_weighted(&dist, array_size, throughput, MPI_COMM_WORLD);
+    } else {
+        dist_rc = distribution_init(&dist, array_size, NULL, MPI_COMM_WORLD);
+    }
+    if (dist_rc != 0) {
+        printf("Error: Memory allocation failed for distribution in process %d\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (expr_text) {
+        if (streaming || from_file || pipelined || shared) {
+            if (rank == 0) printf("Error: EXPR supports the MPI_Scatterv and DATA_GEN=local modes only\n");
             MPI_Abort(MPI_COMM_WORLD, 1);
         }
+        int rc = run_expression(&expr, expr_text, &dist, array_size, local_gen, seed, threads,
+                                comm_plan_persistent_from_env());
+        distribution_free(&dist);
+        if (perf) perf_counters_close(&counters);
+        MPI_Finalize();
+        return rc;
+    }
+
+    local_size = dist.local_count;
+    alloc_size = local_size > 0 ? local_size : 1;
+    if (streaming) alloc_size = stream_block;  // rank 0's sequential pass reuses the blocks
+    local_bytes = (size_t)alloc_size * sizeof(double);
+
+    // One arena per rank holds every big buffer, allocated and first-touched
+    // once: the rank's slices and results, and on rank 0 the whole a and b
+    // and the sequential results, which are reused by every iteration
+    size_t full_bytes = (size_t)array_size * sizeof(double);
+    int own_slices = !shared && !(from_file && input_a.use_mmap);
+    int own_full = rank == 0 && !shared && !streaming && !from_file;
+    int seq_results = rank == 0 && !streaming;
+    size_t arena_capacity = (own_slices ? 6 : 4) * arena_size(local_bytes) +
+                            ((own_full ? 2 : 0) + (seq_results ? 4 : 0)) * arena_size(full_bytes);
+    if (arena_init(&arena, arena_capacity, threads) != 0) {
+        printf("Error: Memory allocation failed for %.1f MB of buffers in process %d\n",
+               arena_capacity / 1e6, rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    local_a = (double*)malloc(local_size * sizeof(double));
-    local_b = (double*)malloc(local_size * sizeof(double));
-    local_add = (double*)malloc(local_size * sizeof(double));
-    local_sub = (double*)malloc(local_size * sizeof(double));
-    local_mul = (double*)malloc(local_size * sizeof(double));
-    local_div = (double*)malloc(local_size * sizeof(double));
+    // Allocate memory
+    if (shared) {
+        if (shared_array_create(&shared_a, array_size, dist.counts, dist.displs, MPI_DOUBLE, MPI_COMM_WORLD) != MPI_SUCCESS ||
+            shared_array_create(&shared_b, array_size, dist.counts, dist.displs, MPI_DOUBLE, MPI_COMM_WORLD) != MPI_SUCCESS) {
+            printf("Error: Shared window allocation failed in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        a = (double*)shared_array_full(&shared_a);
+        b = (double*)shared_array_full(&shared_b);
+        local_a = (double*)shared_array_local(&shared_a);
+        local_b = (double*)shared_array_local(&shared_b);
+    } else if (from_file && input_a.use_mmap) {
+        // Rank 0's sequential pass and every slice read the mapped files in place
+        a = (double*)array_input_data(&input_a);
+        b = (double*)array_input_data(&input_b);
+        local_a = a + dist.local_first;
+        local_b = b + dist.local_first;
+    } else {
+        if (rank == 0 && from_file) {
+            a = (double*)array_input_data(&input_a);
+            b = (double*)array_input_data(&input_b);
+        } else if (rank == 0 && !streaming) {
+            a = (double*)arena_alloc(&arena, full_bytes);
+            b = (double*)arena_alloc(&arena, full_bytes);
+        }
+
+        local_a = (double*)arena_alloc(&arena, local_bytes);
+        local_b = (double*)arena_alloc(&arena, local_bytes);
+    }
+    local_add = (double*)arena_alloc(&arena, local_bytes);
+    local_sub = (double*)arena_alloc(&arena, local_bytes);
+    local_mul = (double*)arena_alloc(&arena, local_bytes);
+    local_div = (double*)arena_alloc(&arena, local_bytes);
+    if (seq_results) {
+        seq_add = (double*)arena_alloc(&arena, full_bytes);
+        seq_sub = (double*)arena_alloc(&arena, full_bytes);
+        seq_mul = (double*)arena_alloc(&arena, full_bytes);
+        seq_div = (double*)arena_alloc(&arena, full_bytes);
+    }
 
     if (local_a == NULL || local_b == NULL || local_add == NULL ||
-        local_sub == NULL || local_mul == NULL || local_div == NULL) {
-        printf("Error: Memory allocation failed in process %d\n", rank);
+        local_sub == NULL || local_mul == NULL || local_div == NULL ||
+        (own_full && (a == NULL || b == NULL)) || (seq_results && seq_div == NULL)) {
+        printf("Error: Arena too small for the buffers of process %d\n", rank);
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+    if (pipelined) {
+        int rc = pipeline_init(&pipeline, 2, MPI_DOUBLE, dist.counts, dist.displs, chunk_size,
+                               pipeline_depth, 0, MPI_COMM_WORLD);
+        if (rc != 0) {
+            printf(rc == MPI_ERR_COUNT
+                   ? "Error: SCATTER=pipelined supports at most INT_MAX elements\n"
+                   : "Error: Memory allocation failed for pipeline buffers in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // Scatters of a and b set up once and restarted every iteration
+    // (common/comm_plan.h)
+    persistent = comm_plan_persistent_from_env();
+    planned_scatter = !pipelined && !streaming && !shared && !from_file && !local_gen;
+    if (planned_scatter) {
+        int rc = comm_plan_scatterv(&scatter_plans[0], a, dist.counts, dist.displs, MPI_DOUBLE, local_a,
+                                    local_size, 0, MPI_COMM_WORLD, persistent);
+        if (rc == MPI_SUCCESS) {
+            rc = comm_plan_scatterv(&scatter_plans[1], b, dist.counts, dist.displs, MPI_DOUBLE, local_b,
+                                    local_size, 0, MPI_COMM_WORLD, persistent);
+        }
+        if (rc != MPI_SUCCESS) {
+            printf("Error: Setting up the scatters of a and b failed in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, rc);
+        }
+    }
+
+    // Check the inputs once against their header checksums, slice by slice
+    if (from_file) {
+        if (!input_a.use_mmap &&
+            (array_input_read(&input_a, dist.local_first, local_size, local_a, MPI_COMM_WORLD) != MPI_SUCCESS ||
+             array_input_read(&input_b, dist.local_first, local_size, local_b, MPI_COMM_WORLD) != MPI_SUCCESS)) {
+            printf("Error: Reading INPUT_A or INPUT_B failed in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        int valid_a = array_input_verify(&input_a, local_a, dist.local_first, local_size, MPI_COMM_WORLD);
+        int valid_b = array_input_verify(&input_b, local_b, dist.local_first, local_size, MPI_COMM_WORLD);
+        if (!valid_a || !valid_b) {
+            if (rank == 0) printf("Error: %s does not match its checksum\n", valid_a ? input_b_file : input_a_file);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
     // Warm-up run
-    if (rank == 0) {
-        fill_arrays(a, b, array_size, time(NULL));
+    if (rank == 0 && !streaming && !from_file) {
+        if (local_gen) {
+            fill_arrays_philox(a, b, 0, array_size, seed);
+        } else {
+            fill_arrays(a, b, array_size, seed);
+        }
     }
 
-    // Benchmark loop
-    for (int iter = 0; iter < ITERATIONS; iter++) {
-        if (rank == 0) {
-            fill_arrays(a, b, array_size, time(NULL) + iter);
+    // Reference for the pipeline: best of a few blocking scatters of a and b
+    if (pipelined) {
+        double scatter_time = 0.0;
+        for (int rep = 0; rep < 3; rep++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double scatter_start = MPI_Wtime();
+            large_scatterv(a, dist.counts, dist.displs, MPI_DOUBLE, local_a, local_size, 0, MPI_COMM_WORLD);
+            large_scatterv(b, dist.counts, dist.displs, MPI_DOUBLE, local_b, local_size, 0, MPI_COMM_WORLD);
+            double elapsed = MPI_Wtime() - scatter_start;
+            if (rep == 0 || elapsed < scatter_time) scatter_time = elapsed;
+        }
+        MPI_Reduce(&scatter_time, &blocking_scatter_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    }
 
-            // Sequential timing
-            double* seq_add = (double*)malloc(array_size * sizeof(double));
-            double* seq_sub = (double*)malloc(array_size * sizeof(double));
-            double* seq_mul = (double*)malloc(array_size * sizeof(double));
-            double* seq_div = (double*)malloc(array_size * sizeof(double));
+    // Hardware counters around every operation; nominal traffic 24 bytes
+    // per element per pass, 48 for the fused pass
+    for (int k = 0; k < 2 * NUM_OPS; k++) {
+        perf_kernel_init(&perf_kernels[k], perf_names[k], perf ? &counters : NULL,
+                         k % NUM_OPS == OP_FUSED ? 48.0 : 24.0);
+    }
+    seq_times.perf = perf_kernels;
+    par_times.perf = perf_kernels + NUM_OPS;
 
-            if (seq_add == NULL || seq_sub == NULL || seq_mul == NULL || seq_div == NULL) {
-                printf("Error: Memory allocation failed for sequential arrays\n");
-                MPI_Abort(MPI_COMM_WORLD, 1);
-            }
+    // Harness: ITERATIONS measured samples after a warm-up that ends once
+    // rank 0's parallel timings are stable (decided on rank 0, broadcast)
+    bench_config_from_env(&bench, ITERATIONS);
+    num_ops = fused ? 1 : 4;
+    for (int i = 0; i < 2 * num_ops; i++) {
+        if (bench_series_init(&series[i], fused ? fused_names[i] : timed_names[i], bench.iterations) != 0) {
+            printf("Error: Memory allocation failed for benchmark samples\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    // The operation series leave the distribution out; this one includes it
+    if (bench_series_init(&series[2 * num_ops], "parallel_with_scatter", bench.iterations) != 0) {
+        printf("Error: Memory allocation failed for benchmark samples\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    warming = bench.max_warmup > 0;
+    mem_usage_now(&mem_before);
+
+    // Benchmark loop
+    for (int iter = 0, measured = 0; measured < bench.iterations; iter++) {
+        OpTimes seq_before = seq_times, par_before = par_times;
+        if (local_gen) {
+            // Each rank generates only its own slices
+            fill_arrays_philox(local_a, local_b, dist.local_first, local_size, seed + iter);
+        }
 
-            array_operations_timed(a, b, seq_add, seq_sub, seq_mul, seq_div, array_size, &seq_times);
+        if (rank == 0 && streaming) {
+            // Sequential timing over all blocks, through rank 0's block buffers
+            double read_time = 0.0;
+            stream_operations(&source_a, &source_b, local_a, local_b, local_add, local_sub,
+                              local_mul, local_div, 0, array_size, stream_block, array_operations,
+                              1, &seq_times, "sequential_ops", &read_time);
+        } else if (rank == 0) {
+            if (local_gen) {
+                fill_arrays_philox(a, b, 0, array_size, seed + iter);
+            } else if (!from_file) {
+                fill_arrays(a, b, array_size, seed + iter);
+            }
 
-            free(seq_add); free(seq_sub); free(seq_mul); free(seq_div);
+            // Sequential timing (results go to the same arena buffers every time)
+            double seq_start = MPI_Wtime();
+            array_operations(a, b, seq_add, seq_sub, seq_mul, seq_div, array_size, 1, &seq_times);
+            prof_region("sequential_ops", seq_start, MPI_Wtime());
         }
 
         MPI_Barrier(MPI_COMM_WORLD);
+        double par_start = MPI_Wtime();
 
-        // Scatter data with error checking
-        int rc;
-        rc = MPI_Scatter(a, local_size, MPI_DOUBLE, local_a, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-        if (rc != MPI_SUCCESS) {
-            printf("Error in MPI_Scatter (a) in process %d\n", rank);
-            MPI_Abort(MPI_COMM_WORLD, rc);
+        if (pipelined) {
+            // Operations run on chunk k while chunk k+1 of a and b is in flight
+            OpsContext ops_ctx = {array_operations, local_add, local_sub, local_mul, local_div,
+                                  threads, &par_times};
+            const void* sendbufs[2] = {a, b};
+            int rc = pipeline_run(&pipeline, sendbufs, ops_chunk, &ops_ctx);
+            if (rc != MPI_SUCCESS) {
+                printf("Error in pipelined MPI_Iscatterv in process %d\n", rank);
+                MPI_Abort(MPI_COMM_WORLD, rc);
+            }
+        } else if (streaming) {
+            // Reading the blocks takes the place of the scatter
+            double read_time = 0.0;
+            stream_operations(&source_a, &source_b, local_a, local_b, local_add, local_sub,
+                              local_mul, local_div, dist.local_first, local_size, stream_block,
+                              array_operations, threads, &par_times, "local_ops", &read_time);
+        } else {
+            // Scatter data with error checking (not needed when generated locally)
+            if (shared) {
+                // Only slices of other nodes move; on the root's node this is a fence
+                int rc = shared_array_distribute(&shared_a);
+                if (rc == MPI_SUCCESS) rc = shared_array_distribute(&shared_b);
+                if (rc != MPI_SUCCESS) {
+                    printf("Error distributing shared windows in process %d\n", rank);
+                    MPI_Abort(MPI_COMM_WORLD, rc);
+                }
+            } else if (from_file) {
+                // Each rank reads its own slices: no scatter through rank 0
+                if (!input_a.use_mmap) {
+                    array_input_read(&input_a, dist.local_first, local_size, local_a, MPI_COMM_WORLD);
+                    array_input_read(&input_b, dist.local_first, local_size, local_b, MPI_COMM_WORLD);
+                }
+            } else if (planned_scatter) {
+                // Both scatters in flight at once
+                int rc = comm_plan_run_all(scatter_plans, 2);
+                if (rc != MPI_SUCCESS) {
+                    printf("Error in MPI_Scatterv of a and b in process %d\n", rank);
+                    MPI_Abort(MPI_COMM_WORLD, rc);
+                }
+            }
+
+            // Parallel operations with timing
+            double ops_start = MPI_Wtime();
+            array_operations(local_a, local_b, local_add, local_sub, 
+                             local_mul, local_div, local_size, threads, &par_times);
+            prof_region("local_ops", ops_start, MPI_Wtime());
         }
 
-        rc = MPI_Scatter(b, local_size, MPI_DOUBLE, local_b, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-        if (rc != MPI_SUCCESS) {
-            printf("Error in MPI_Scatter (b) in process %d\n", rank);
-            MPI_Abort(MPI_COMM_WORLD, rc);
+        // Distribution plus operations of the slowest rank
+        MPI_Barrier(MPI_COMM_WORLD);
+        double par_end = MPI_Wtime();
+
+        double seq_samples[4], par_samples[4], par_total = 0.0;
+        op_times_delta(&seq_before, &seq_times, fused, seq_samples);
+        op_times_delta(&par_before, &par_times, fused, par_samples);
+        for (int i = 0; i < num_ops; i++) par_total += par_samples[i];
+
+        if (warming) {
+            int done = 0;
+            if (rank == 0) done = bench_warmup_done(&warmup, &bench, par_total);
+            MPI_Bcast(&done, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            warmup_iterations++;
+            if (done) {
+                // Averages cover measured iterations only
+                warming = 0;
+                op_times_reset(&seq_times);
+                op_times_reset(&par_times);
+                if (pipelined) pipeline.wait_time = pipeline.compute_time = 0.0;
+                mem_usage_now(&mem_before);
+            }
+        } else {
+            if (rank == 0) {
+                for (int i = 0; i < num_ops; i++) {
+                    bench_series_add(&series[i], seq_samples[i]);
+                    bench_series_add(&series[num_ops + i], par_samples[i]);
+                }
+                bench_series_add(&series[2 * num_ops], par_end - par_start);
+            }
+            measured++;
         }
+    }
 
-        // Parallel operations with timing
-        array_operations_timed(local_a, local_b, local_add, local_sub, 
-                             local_mul, local_div, local_size, &par_times);
+    mem_usage_now(&mem_after);
 
-        MPI_Barrier(MPI_COMM_WORLD);
+    // Pipeline statistics of the slowest rank
+    double max_wait_time = 0.0, max_compute_time = 0.0;
+    if (pipelined) {
+        MPI_Reduce(&pipeline.wait_time, &max_wait_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&pipeline.compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        pipeline_free(&pipeline);
     }
 
     // Print results
     if (rank == 0) {
-        printf("=== Array Operations Benchmark ===\n");
-        printf("Array size: %d\n", array_size);
-        printf("Processes: %d\n", num_procs);
-        printf("Iterations: %d\n", ITERATIONS);
-        
-        printf("\nAverage sequential times:\n");
-        printf("Addition: %.6f sec\n", seq_times.add_time / ITERATIONS);
-        printf("Subtraction: %.6f sec\n", seq_times.sub_time / ITERATIONS);
-        printf("Multiplication: %.6f sec\n", seq_times.mul_time / ITERATIONS);
-        printf("Division: %.6f sec\n", seq_times.div_time / ITERATIONS);
-        
-        printf("\nAverage parallel times:\n");
-        printf("Addition: %.6f sec\n", par_times.add_time / ITERATIONS);
-        printf("Subtraction: %.6f sec\n", par_times.sub_time / ITERATIONS);
-        printf("Multiplication: %.6f sec\n", par_times.mul_time / ITERATIONS);
-        printf("Division: %.6f sec\n", par_times.div_time / ITERATIONS);
-        
-        printf("\nSpeedup factors:\n");
-        printf("Addition: %.2fx\n", (seq_times.add_time / ITERATIONS) / (par_times.add_time / ITERATIONS));
-        printf("Subtraction: %.2fx\n", (seq_times.sub_time / ITERATIONS) / (par_times.sub_time / ITERATIONS));
-        printf("Multiplication: %.2fx\n", (seq_times.mul_time / ITERATIONS) / (par_times.mul_time / ITERATIONS));
-        printf("Division: %.2fx\n", (seq_times.div_time / ITERATIONS) / (par_times.div_time / ITERATIONS));
+        char stream_mode[64];
+        snprintf(stream_mode, sizeof(stream_mode), "streamed in %lld-element blocks from %s",
+                 stream_block, stream_file_a ? "files" : "Philox");
+        const char* data_mode = streaming ? stream_mode : local_gen ? "rank-local (Philox)"
+            : from_file ? (input_a.use_mmap ? "array files (mmap per rank)" : "array files (MPI_File_read_at_all)")
+            : pipelined ? "rank 0 + pipelined MPI_Iscatterv"
+            : shared ? "rank 0 into node-shared windows (zero-copy)" : "rank 0 + MPI_Scatterv";
+        int iterations = bench.iterations;
+
+        if (bench_human_output(&bench)) {
+            printf("=== Array Operations Benchmark ===\n");
+            printf("Array size: %lld\n", array_size);
+            printf("Processes: %d\n", num_procs);
+            printf("Layout: %d ranks x %d threads\n", num_procs, threads);
+            printf("Iterations: %d (after %d warm-up)\n", iterations, warmup_iterations);
+            printf("Data generation: %s\n", data_mode);
+            printf("Balance: %s (largest slice %lld elements)\n",
+                   dist.weighted ? "calibrated throughput weights" : "even", dist.max_count);
+            if (planned_scatter) printf("Collectives: %s\n", comm_plan_backend(persistent));
+
+            printf("Mode: %s\n", fused ? "fused single pass (non-temporal stores)" : "timed (one pass per operation)");
+
+            if (fused) {
+                printf("\nAverage sequential time:\n");
+                printf("All four operations: %.6f sec\n", seq_times.fused_time / iterations);
+
+                printf("\nAverage parallel time:\n");
+                printf("All four operations: %.6f sec\n", par_times.fused_time / iterations);
+
+                printf("\nSpeedup factor (medians):\n");
+                print_speedup("All four operations", &series[0], &series[1], &bench);
+            } else {
+                printf("\nAverage sequential times:\n");
+                printf("Addition: %.6f sec\n", seq_times.add_time / iterations);
+                printf("Subtraction: %.6f sec\n", seq_times.sub_time / iterations);
+                printf("Multiplication: %.6f sec\n", seq_times.mul_time / iterations);
+                printf("Division: %.6f sec\n", seq_times.div_time / iterations);
+
+                printf("\nAverage parallel times:\n");
+                printf("Addition: %.6f sec\n", par_times.add_time / iterations);
+                printf("Subtraction: %.6f sec\n", par_times.sub_time / iterations);
+                printf("Multiplication: %.6f sec\n", par_times.mul_time / iterations);
+                printf("Division: %.6f sec\n", par_times.div_time / iterations);
+
+                printf("\nSpeedup factors (medians):\n");
+                print_speedup("Addition", &series[0], &series[4], &bench);
+                print_speedup("Subtraction", &series[1], &series[5], &bench);
+                print_speedup("Multiplication", &series[2], &series[6], &bench);
+                print_speedup("Division", &series[3], &series[7], &bench);
+            }
+
+            // Sequential reference: sum of the per-operation medians
+            BenchStats stats;
+            double seq_median = 0.0;
+            for (int i = 0; i < num_ops; i++) {
+                bench_stats(&series[i], &bench, &stats);
+                seq_median += stats.median;
+            }
+            bench_stats(&series[2 * num_ops], &bench, &stats);
+            printf("\nIncluding the %s of a and b (median):\n", streaming ? "block reads" : from_file ? "file reads" : "scatter");
+            printf("Parallel time: %.6f sec\n", stats.median);
+            printf("Speedup: %.2fx\n", stats.median > 0 ? seq_median / stats.median : 0.0);
+
+            double timed_bytes = ew_traffic_bytes((size_t)array_size, 0);
+            double fused_bytes = ew_traffic_bytes((size_t)array_size, 1);
+            printf("\nMemory traffic per iteration:\n");
+            printf("Four passes: %.1f MB, fused: %.1f MB (saves %.1f MB, %.0f%%)\n",
+                   timed_bytes / 1e6, fused_bytes / 1e6, (timed_bytes - fused_bytes) / 1e6,
+                   100.0 * (timed_bytes - fused_bytes) / timed_bytes);
+
+            if (pipelined) {
+                double wait = max_wait_time / iterations;
+                printf("\nPipeline (chunk %d elements, depth %d):\n", chunk_size, pipeline_depth);
+                printf("Exposed wait: %.6f sec\n", wait);
+                printf("Compute: %.6f sec\n", max_compute_time / iterations);
+                printf("Blocking scatter of a and b: %.6f sec\n", blocking_scatter_time);
+                printf("Overlap: %.0f%% of scatter time hidden\n",
+                       100.0 * pipeline_overlap(wait, blocking_scatter_time));
+            }
+        }
+
+        BenchParam params[6];
+        bench_param(&params[0], "array_size", "%.0f", array_size);
+        bench_param(&params[1], "processes", "%.0f", num_procs);
+        bench_param(&params[2], "threads", "%.0f", threads);
+        bench_param_str(&params[3], "data", data_mode);
+        bench_param_str(&params[4], "elementwise", fused ? "fused" : "timed");
+        bench_param_str(&params[5], "comm_plan", persistent ? "persistent" : "replay");
+        bench_report(&bench, "task3", series, 2 * num_ops + 1, params, 6, warmup_iterations);
+    }
+
+    // Counters per rank against the STREAM roof measured on all ranks at once
+    if (perf) {
+        double stream_gbs = perf_stream_triad_gbs(perf_stream_size(), threads, 5, MPI_COMM_WORLD);
+        if (bench_human_output(&bench)) perf_report(perf_kernels, 2 * NUM_OPS, stream_gbs, MPI_COMM_WORLD);
+        perf_counters_close(&counters);
+    }
+    if (bench_human_output(&bench)) {
+        numa_report(MPI_COMM_WORLD);
+        mem_usage_report(&mem_before, &mem_after, MPI_COMM_WORLD);
     }
 
     // Cleanup
-    if (a) free(a);
-    if (b) free(b);
-    if (local_a) free(local_a);
-    if (local_b) free(local_b);
-    if (local_add) free(local_add);
-    if (local_sub) free(local_sub);
-    if (local_mul) free(local_mul);
-    if (local_div) free(local_div);
+    if (shared) {
+        shared_array_free(&shared_a);
+        shared_array_free(&shared_b);
+    } else if (from_file) {
+        array_input_close(&input_a);
+        array_input_close(&input_b);
+    }
+    if (planned_scatter) {
+        comm_plan_free(&scatter_plans[0]);
+        comm_plan_free(&scatter_plans[1]);
+    }
+    distribution_free(&dist);
+    for (int i = 0; i <= 2 * num_ops; i++) bench_series_free(&series[i]);
+    arena_free(&arena);
+    if (streaming) {
+        block_source_close(&source_a);
+        block_source_close(&source_b);
+    }
 
     MPI_Finalize();
     return 0;
@@ -1,112 +1,803 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 #include <mpi.h>
+#include "common/philox.h"
+#include "common/sum_kernels.h"
+#include "common/threads.h"
+#include "common/pipeline.h"
+#include "common/shared_array.h"
+#include "common/distribution.h"
+#include "common/bench.h"
+#include "common/prof_regions.h"
+#include "common/perf_counters.h"
+#include "common/large_count.h"
+#include "common/block_source.h"
+#include "common/arrayfile.h"
+#include "common/arena.h"
+#include "common/narrow_sum.h"
+#include "common/stats.h"
+#include "common/comm_plan.h"
+#include "common/reduce_algo.h"
+#include "common/scan.h"
 
 #define ITERATIONS 100
+#define VALUE_BOUND 100  // generated values are in [0, VALUE_BOUND)
 
-void fill_array_random(int* arr, int size, unsigned int seed) {
+void fill_array_random(void* arr, long long size, unsigned int seed, ElementType type) {
     srand(seed);
-    for (int i = 0; i < size; i++) {
-        arr[i] = rand() % 100;
+    for (long long i = 0; i < size; i++) {
+        int value = rand() % VALUE_BOUND;
+        if (type == ELEMENT_UINT8) {
+            ((uint8_t*)arr)[i] = (uint8_t)value;
+        } else if (type == ELEMENT_UINT16) {
+            ((uint16_t*)arr)[i] = (uint16_t)value;
+        } else {
+            ((int*)arr)[i] = value;
+        }
+    }
+}
+
+// Counter-based fill: element i depends only on (seed, i), so a rank can
+// generate its own slice without rank 0 and the scatter.
+void fill_array_philox(void* arr, long long first, long long size, unsigned int seed, ElementType type) {
+    if (type == ELEMENT_UINT8) {
+        philox_fill_u8((uint8_t*)arr, (size_t)first, (size_t)size, seed, 0, VALUE_BOUND);
+    } else if (type == ELEMENT_UINT16) {
+        philox_fill_u16((uint16_t*)arr, (size_t)first, (size_t)size, seed, 0, VALUE_BOUND);
+    } else {
+        philox_fill_int((int*)arr, (size_t)first, (size_t)size, seed, 0, VALUE_BOUND);
     }
 }
 
-long long sequential_sum(int* arr, int size) {
+long long sequential_sum(const void* arr, long long size, ElementType type) {
+    return sum_elements(arr, (size_t)size, type);
+}
+
+// Running totals of the whole array in one pass; returns the last one
+long long sequential_scan(const void* arr, long long size, ElementType type, long long* out) {
+    return scan_elements(arr, type, out, (size_t)size);
+}
+
+// Wrapping hash of running totals in order, to compare a distributed scan
+// with the sequential one slice by slice without moving the slices
+unsigned long long scan_hash(const long long* out, long long count) {
+    unsigned long long h = 0;
+    for (long long i = 0; i < count; i++) h = h * 1000003u + (unsigned long long)out[i];
+    return h;
+}
+
+// Local reduction of n elements whose first one has global index `first`:
+// the sum, or with `stats` set (OPERATION=stats) the fused statistics,
+// merged into *stats
+long long reduce_elements(const void* arr, size_t n, ElementType type, long long first, int threads,
+                          Stats* stats) {
+    if (!stats) return sum_elements_threaded(arr, n, type, threads);
+    stats_elements_threaded(arr, n, type, first, threads, stats);
+    return 0;
+}
+
+// Streaming mode: reduces elements [first, first + count) of `src` one
+// block of `block_size` elements at a time; *read_time accumulates the time
+// spent reading (or generating) blocks
+long long stream_sum(const BlockSource* src, int* block, long long first, long long count,
+                     long long block_size, int threads, Stats* stats, PerfKernel* perf, double* read_time) {
     long long sum = 0;
-    for (int i = 0; i < size; i++) {
-        sum += arr[i];
+    for (long long done = 0; done < count; done += block_size) {
+        long long n = count - done < block_size ? count - done : block_size;
+        double read_start = MPI_Wtime();
+        if (block_source_read(src, block, first + done, n) != 0) {
+            fprintf(stderr, "Error: Reading elements %lld..%lld failed\n", first + done, first + done + n - 1);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        double read_end = MPI_Wtime();
+        *read_time += read_end - read_start;
+        perf_kernel_begin(perf);
+        sum += reduce_elements(block, (size_t)n, ELEMENT_INT32, first + done, threads, stats);
+        perf_kernel_end(perf, (size_t)n);
+        prof_region(perf->name, read_end, MPI_Wtime());
     }
     return sum;
 }
 
+typedef struct {
+    long long sum;
+    int threads;
+    ElementType type;
+    long long first;  // global index of the rank's slice
+    Stats* stats;     // OPERATION=stats, NULL for the sum
+    PerfKernel* perf;
+} SumContext;
+
+// Pipeline consumer: adds one received chunk to the running local result
+void sum_chunk(void* const* chunks, int count, int offset, void* ctx) {
+    SumContext* sum_ctx = (SumContext*)ctx;
+    perf_kernel_begin(sum_ctx->perf);
+    double start = MPI_Wtime();
+    sum_ctx->sum += reduce_elements(chunks[0], (size_t)count, sum_ctx->type, sum_ctx->first + offset,
+                                    sum_ctx->threads, sum_ctx->stats);
+    prof_region("local_sum", start, MPI_Wtime());
+    perf_kernel_end(sum_ctx->perf, (size_t)count);
+}
+
+typedef struct {
+    void* buffer;
+    int threads;
+    ElementType type;
+    long long sink;
+} CalibrationContext;
+
+// Calibration kernel for BALANCE=calibrate: the threaded local sum
+void sum_calibration(size_t n, void* ctx) {
+    CalibrationContext* calib = (CalibrationContext*)ctx;
+    calib->sink += sum_elements_threaded(calib->buffer, n, calib->type, calib->threads);
+}
+
 int main(int argc, char* argv[]) {
-    int rank, num_procs, array_size, local_size;
-    int* arr = NULL, * local_arr = NULL;
+    int rank, num_procs;
+    long long array_size;
+    void* arr = NULL, * local_arr = NULL;
+    int* block = NULL;
+    Arena arena;
+    MemUsage mem_before, mem_after;
     long long total_sum = 0, local_sum = 0, sequential_result = 0;
-    double total_seq_time = 0.0, total_par_time = 0.0;
+    int stats_mode, scan_mode;
+    Stats total_stats, local_stats, sequential_stats;
+    StatsMpi stats_mpi;
+    BenchConfig bench;
+    BenchSeries series[5];  // sequential, parallel, then its scatter/compute/reduce phases
+    BenchWarmup warmup = {{0}, 0};
+    int warming, warmup_iterations = 0;
     unsigned int seed = 0;
+    int local_gen = 0;
+    int threads = 1, thread_support = 0;
+    int pipelined = 0, chunk_size = 0, pipeline_depth = 0, shared = 0;
+    long long stream_block;
+    int streaming;
+    BlockSource source;
+    char* stream_file;
+    ArrayInput input;
+    char* input_file;
+    ElementType elem = ELEMENT_INT32;
+    size_t elem_size;
+    Distribution dist;
+    ScatterPipeline pipeline;
+    SharedArray shared_arr;
+    PerfCounters counters;
+    PerfKernel perf_kernels[2];  // sequential and local sum
+    int perf;
+    double blocking_scatter_time = 0.0;
+    int persistent, planned_scatter;
+    CommPlan scatter_plan, reduce_plan, phase_plan;
+    double phases[3], max_phases[3];  // this rank's scatter, compute and reduce time; slowest rank's
+    int reduce_algo, reduce_auto, reduce_ctx_open = 0;
+    ReduceContext reduce_ctx;
+    double reduce_times[REDUCE_NUM_ALGOS];
+    long long* scan_out = NULL, * sequential_scan_out = NULL;  // this rank's running totals; rank 0's baseline
+    long long scan_offset = 0;
+    ScanState scan_state;
 
-    // Initialize MPI
-    MPI_Init(&argc, &argv);
+    // Initialize MPI (only the main thread of each rank calls MPI)
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
+    // Hybrid mode: THREADS_PER_RANK threads share each rank's slice
+    threads = threads_per_rank();
+    if (threads > 1 && thread_support < MPI_THREAD_FUNNELED) {
+        if (rank == 0) {
+            fprintf(stderr, "Warning: MPI library lacks MPI_THREAD_FUNNELED, using 1 thread per rank\n");
+        }
+        threads = 1;
+    }
+    // PERF_COUNTERS=1: the counters open before numa_setup starts the
+    // OpenMP threads, as only threads started later inherit them
+    perf = perf_counters_requested();
+    if (perf) perf_counters_open(&counters);
+
+    // Pinning, and the big buffers on each rank's own NUMA node
+    numa_setup(threads, MPI_COMM_WORLD);
+
     // Get parameters
     char* array_size_str = getenv("ARRAY_SIZE");
-    array_size = array_size_str ? atoi(array_size_str) : 100000000;
+    array_size = array_size_str ? atoll(array_size_str) : 100000000;
     seed = (unsigned int)time(NULL) + rank;  // Different seed for each process
 
+    // DATA_GEN=local: every rank generates its own slice (no scatter)
+    char* data_gen_str = getenv("DATA_GEN");
+    local_gen = data_gen_str && strcmp(data_gen_str, "local") == 0;
+    if (local_gen) {
+        // All ranks must agree on the key of the counter-based generator
+        MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    }
+
+    // INPUT_FILE: sum an int32 array file (tools/make_array.c) instead of
+    // random data; every rank reads only its own slice (common/arrayfile.h)
+    input_file = getenv("INPUT_FILE");
+    if (input_file) {
+        int use_mmap = array_input_mmap_from_env(MPI_COMM_WORLD);
+        if (array_input_open(&input, input_file, ARRAYFILE_INT32, use_mmap, MPI_COMM_WORLD) != 0 ||
+            array_input_count(&input) <= 0) {
+            if (rank == 0) fprintf(stderr, "Error: %s is not a non-empty int32 array file\n", input_file);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        array_size = array_input_count(&input);
+        local_gen = 0;
+    }
+
+    // STREAM_BLOCK: out-of-core mode, every rank reads its share block by
+    // block from STREAM_FILE (raw int32) or generates it, so memory stays at
+    // one block per rank however large the array is
+    stream_block = stream_block_from_env();
+    streaming = stream_block > 0 && !input_file;
+    stream_file = getenv("STREAM_FILE");
+    if (streaming && stream_file) {
+        if (block_source_file(&source, stream_file, sizeof(int)) != 0) {
+            fprintf(stderr, "Error: Cannot open STREAM_FILE %s in process %d\n", stream_file, rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        if (!array_size_str || array_size <= 0 || array_size > source.count) array_size = source.count;
+    } else if (streaming) {
+        if (!local_gen) MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+        block_source_philox_int(&source, seed, 0, VALUE_BOUND);
+    }
+    local_gen = local_gen && !streaming;  // streaming replaces the other data modes
+
+    // ELEMENT_TYPE: generated data in [0, VALUE_BOUND) is stored, scattered
+    // and summed in the narrowest type that holds it (uint8 by default);
+    // files and streamed blocks are int32
+    if (!input_file && !streaming) {
+        int type = element_type_from_env(0, VALUE_BOUND - 1);
+        if (type < 0) {
+            if (rank == 0) fprintf(stderr, "Error: Invalid ELEMENT_TYPE %s for values in [0, %d)\n",
+                                   getenv("ELEMENT_TYPE"), VALUE_BOUND);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        elem = (ElementType)type;
+    }
+    elem_size = element_size(elem);
+
+    // OPERATION=stats: count, min, max, argmax, mean and variance in one
+    // fused pass per rank and one MPI_Reduce with a user-defined MPI_Op
+    // (common/stats.h) instead of the sum.
+    // OPERATION=scan: running totals (inclusive prefix sum) that stay
+    // distributed: a local scan per rank, the offsets of the slices before
+    // it from MPI_Exscan, and a second pass adding them (common/scan.h)
+    char* operation_str = getenv("OPERATION");
+    stats_mode = operation_str && strcmp(operation_str, "stats") == 0;
+    scan_mode = operation_str && strcmp(operation_str, "scan") == 0;
+    if (operation_str && !stats_mode && !scan_mode && strcmp(operation_str, "sum") != 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid OPERATION %s (sum, stats or scan)\n", operation_str);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (stats_mode) stats_mpi_init(&stats_mpi);
+    stats_init(&total_stats);
+    stats_init(&sequential_stats);
+
     // Validate parameters
     if (array_size <= 0) array_size = 100000000;
     if (array_size < num_procs && rank == 0) {
         fprintf(stderr, "Warning: Array size is smaller than number of processes\n");
     }
 
-    local_size = (array_size + num_procs - 1) / num_procs;
+    // Slices for MPI_Scatterv: even, or weighted by each rank's measured
+    // sum throughput with BALANCE=calibrate (for mixed node generations)
+    int dist_rc;
+    if (distribution_calibrate_requested()) {
+        size_t calib_size = 1 << 22;
+        CalibrationContext calib = {calloc(calib_size, elem_size), threads, elem, 0};
+        double throughput = calib.buffer ? distribution_calibrate(sum_calibration, &calib, calib_size, 5) : 0.0;
+        free(calib.buffer);
+        dist_rc = distribution_init_weighted(&dist, array_size, throughput, MPI_COMM_WORLD);
+    } else {
+        dist_rc = distribution_init(&dist, array_size, NULL, MPI_COMM_WORLD);
+    }
+    if (dist_rc != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for distribution in process %d\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-    // Allocate memory once
-    if (rank == 0) {
-        arr = (int*)malloc(array_size * sizeof(int));
+    // SCATTER=pipelined: chunked MPI_Iscatterv overlapped with the local sum
+    char* scatter_str = getenv("SCATTER");
+    pipelined = !local_gen && !streaming && !input_file && scatter_str && strcmp(scatter_str, "pipelined") == 0;
+    // SCATTER=shared: arr lives in a node-shared window, slices are read in place
+    shared = !local_gen && !streaming && !input_file && scatter_str && strcmp(scatter_str, "shared") == 0;
+    pipeline_params_from_env(&chunk_size, &pipeline_depth);
+    if (scan_mode && (streaming || pipelined)) {
+        if (rank == 0) fprintf(stderr, "Error: OPERATION=scan needs whole slices, not STREAM_BLOCK or SCATTER=pipelined\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Allocate memory once, from one arena per rank: the rank's slice (or
+    // stream block) and on rank 0 the whole array; for the scan also the
+    // rank's running totals and on rank 0 those of the sequential scan
+    size_t full_bytes = (size_t)array_size * elem_size;
+    size_t local_bytes = (size_t)(dist.local_count > 0 ? dist.local_count : 1) * elem_size;
+    size_t scan_bytes = (size_t)(dist.local_count > 0 ? dist.local_count : 1) * sizeof(long long);
+    size_t full_scan_bytes = (size_t)array_size * sizeof(long long);
+    size_t block_bytes = (size_t)stream_block * sizeof(int);
+    int own_buffers = !shared && !streaming && !(input_file && input.use_mmap);
+    int own_full = own_buffers && rank == 0 && !input_file;
+    size_t arena_capacity = (streaming ? arena_size(block_bytes) : 0) +
+                            (own_buffers ? arena_size(local_bytes) : 0) +
+                            (own_full ? arena_size(full_bytes) : 0) +
+                            (scan_mode ? arena_size(scan_bytes) : 0) +
+                            (scan_mode && rank == 0 ? arena_size(full_scan_bytes) : 0);
+    if (arena_init(&arena, arena_capacity, threads) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for %.1f MB of buffers in process %d\n",
+                arena_capacity / 1e6, rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (shared) {
+        if (shared_array_create(&shared_arr, array_size, dist.counts, dist.displs, element_mpi_type(elem),
+                                MPI_COMM_WORLD) != MPI_SUCCESS) {
+            fprintf(stderr, "Error: Shared window allocation failed in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        arr = shared_array_full(&shared_arr);
+        local_arr = shared_array_local(&shared_arr);
+    } else if (streaming) {
+        block = (int*)arena_alloc(&arena, block_bytes);
+    } else if (input_file && input.use_mmap) {
+        // Rank 0's sequential pass and every slice read the mapped file in place
+        arr = (void*)array_input_data(&input);
+        local_arr = (int*)arr + dist.local_first;
+    } else {
+        if (rank == 0) {
+            arr = input_file ? (void*)array_input_data(&input) : arena_alloc(&arena, full_bytes);
+        }
+        local_arr = arena_alloc(&arena, local_bytes);
+    }
+    if (scan_mode) {
+        scan_out = (long long*)arena_alloc(&arena, scan_bytes);
+        if (rank == 0) sequential_scan_out = (long long*)arena_alloc(&arena, full_scan_bytes);
+        if (scan_state_init(&scan_state, threads) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed for the scan in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    if ((streaming && !block) || (own_buffers && !local_arr) || (own_full && !arr) ||
+        (scan_mode && (!scan_out || (rank == 0 && !sequential_scan_out)))) {
+        fprintf(stderr, "Error: Arena too small for the buffers of process %d\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (pipelined) {
+        int rc = pipeline_init(&pipeline, 1, element_mpi_type(elem), dist.counts, dist.displs, chunk_size,
+                               pipeline_depth, 0, MPI_COMM_WORLD);
+        if (rc != 0) {
+            fprintf(stderr, rc == MPI_ERR_COUNT
+                    ? "Error: SCATTER=pipelined supports at most INT_MAX elements\n"
+                    : "Error: Memory allocation failed for pipeline buffers in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // Plans for the collectives of every iteration, set up once: the
+    // scatter, the final reduction and the phase times (common/comm_plan.h)
+    persistent = comm_plan_persistent_from_env();
+    planned_scatter = !pipelined && !streaming && !shared && !input_file && !local_gen;
+    int plan_rc = planned_scatter
+        ? comm_plan_scatterv(&scatter_plan, arr, dist.counts, dist.displs, element_mpi_type(elem), local_arr,
+                             dist.local_count, 0, MPI_COMM_WORLD, persistent)
+        : MPI_SUCCESS;
+    if (plan_rc == MPI_SUCCESS) {
+        plan_rc = stats_mode
+            ? comm_plan_reduce(&reduce_plan, &local_stats, &total_stats, 1, stats_mpi.type, stats_mpi.op, 0,
+                               MPI_COMM_WORLD, persistent)
+            : comm_plan_reduce(&reduce_plan, &local_sum, &total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0,
+                               MPI_COMM_WORLD, persistent);
+    }
+    if (plan_rc == MPI_SUCCESS) {
+        plan_rc = comm_plan_reduce(&phase_plan, phases, max_phases, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD,
+                                   persistent);
+    }
+    if (plan_rc != MPI_SUCCESS) {
+        fprintf(stderr, "Error: Setting up the communication plans failed in process %d\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, plan_rc);
+    }
+
+    // REDUCE_ALGO: the final reduction through the library's MPI_Reduce
+    // (the plan above, default) or an algorithm of common/reduce_algo.h;
+    // auto times them all on this job's ranks and keeps the fastest. The
+    // scan has no final reduction.
+    reduce_algo = scan_mode ? REDUCE_LIBRARY : reduce_algo_from_env(REDUCE_LIBRARY);
+    if (reduce_algo == -2) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid REDUCE_ALGO %s\n", getenv("REDUCE_ALGO"));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    reduce_auto = reduce_algo == -1;
+    if (reduce_algo != REDUCE_LIBRARY) {
+        if (reduce_context_init(&reduce_ctx, MPI_COMM_WORLD, sizeof(Stats)) != MPI_SUCCESS) {
+            fprintf(stderr, "Error: Setting up the reduction in process %d failed\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        reduce_ctx_open = 1;
+    }
+    if (reduce_auto) {
+        reduce_algo = stats_mode
+            ? reduce_select(&reduce_ctx, &local_stats, &total_stats, 1, stats_mpi.type, stats_mpi.op, 0, 100,
+                            reduce_times)
+            : reduce_select(&reduce_ctx, &local_sum, &total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, 100, reduce_times);
+    }
+
+    // Check the input once against the header checksum, slice by slice
+    if (input_file) {
+        if (!input.use_mmap &&
+            array_input_read(&input, dist.local_first, dist.local_count, local_arr, MPI_COMM_WORLD) != MPI_SUCCESS) {
+            fprintf(stderr, "Error: Reading %s failed in process %d\n", input_file, rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        if (!array_input_verify(&input, local_arr, dist.local_first, dist.local_count, MPI_COMM_WORLD)) {
+            if (rank == 0) fprintf(stderr, "Error: %s does not match its checksum\n", input_file);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
     }
-    local_arr = (int*)malloc(local_size * sizeof(int));
+
+    // Hardware counters around the sum kernels
+    // (elem_size in and 8 bytes out per element for the scan)
+    double kernel_bytes = (double)elem_size + (scan_mode ? sizeof(long long) : 0);
+    perf_kernel_init(&perf_kernels[0], scan_mode ? "sequential_scan" : "sequential_sum", perf ? &counters : NULL,
+                     kernel_bytes);
+    perf_kernel_init(&perf_kernels[1], scan_mode ? "local_scan" : "local_sum", perf ? &counters : NULL,
+                     kernel_bytes);
 
     // Warm-up run (to avoid cold start effects)
-    if (rank == 0) {
-        fill_array_random(arr, array_size, seed);
-        sequential_sum(arr, array_size);
+    if (rank == 0 && !streaming) {
+        if (local_gen) {
+            fill_array_philox(arr, 0, array_size, seed, elem);
+        } else if (!input_file) {
+            fill_array_random(arr, array_size, seed, elem);
+        }
+        if (scan_mode) {
+            sequential_scan(arr, array_size, elem, sequential_scan_out);
+        } else {
+            sequential_sum(arr, array_size, elem);
+        }
     }
     MPI_Barrier(MPI_COMM_WORLD);
 
+    // Reference for the pipeline: best of a few blocking scatters of the same data
+    if (pipelined) {
+        double scatter_time = 0.0;
+        for (int rep = 0; rep < 3; rep++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double scatter_start = MPI_Wtime();
+            large_scatterv(arr, dist.counts, dist.displs, element_mpi_type(elem), local_arr, dist.local_count, 0,
+                           MPI_COMM_WORLD);
+            double elapsed = MPI_Wtime() - scatter_start;
+            if (rep == 0 || elapsed < scatter_time) scatter_time = elapsed;
+        }
+        MPI_Reduce(&scatter_time, &blocking_scatter_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    }
+
+    // Harness: ITERATIONS measured samples after a warm-up that ends once
+    // rank 0's parallel timings are stable (decided on rank 0, broadcast)
+    bench_config_from_env(&bench, ITERATIONS);
+    const char* operation = stats_mode ? "stats" : scan_mode ? "scan" : "sum";
+    char seq_name[32], par_name[32];
+    snprintf(seq_name, sizeof(seq_name), "sequential_%s", operation);
+    snprintf(par_name, sizeof(par_name), "parallel_%s", operation);
+    if (bench_series_init(&series[0], seq_name, bench.iterations) != 0 ||
+        bench_series_init(&series[1], par_name, bench.iterations) != 0 ||
+        bench_series_init(&series[2], "scatter", bench.iterations) != 0 ||
+        bench_series_init(&series[3], "compute", bench.iterations) != 0 ||
+        bench_series_init(&series[4], scan_mode ? "exscan" : "reduce", bench.iterations) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for benchmark samples\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    warming = bench.max_warmup > 0;
+    mem_usage_now(&mem_before);
+
     // Main measurement loop
-    for (int iter = 0; iter < ITERATIONS; iter++) {
+    for (int iter = 0, measured = 0; measured < bench.iterations; iter++) {
+        double seq_time = 0.0;
+
+        if (local_gen) {
+            // Each rank generates only its own slice
+            fill_array_philox(local_arr, dist.local_first, dist.local_count, seed + iter, elem);
+        }
+
         if (rank == 0) {
-            // Prepare new random data
-            fill_array_random(arr, array_size, seed + iter);
+            // Prepare new random data (same values as the slices in local mode)
+            if (local_gen) {
+                fill_array_philox(arr, 0, array_size, seed + iter, elem);
+            } else if (!streaming && !input_file) {
+                fill_array_random(arr, array_size, seed + iter, elem);
+            }
 
-            // Measure sequential time
+            // Measure sequential time (stream_sum counts and reports each block)
             double seq_start = MPI_Wtime();
-            sequential_result = sequential_sum(arr, array_size);
+            if (stats_mode) stats_init(&sequential_stats);
+            if (streaming) {
+                double read_time = 0.0;
+                sequential_result = stream_sum(&source, block, 0, array_size, stream_block, 1,
+                                               stats_mode ? &sequential_stats : NULL, &perf_kernels[0], &read_time);
+            } else {
+                perf_kernel_begin(&perf_kernels[0]);
+                if (stats_mode) {
+                    stats_elements(arr, (size_t)array_size, elem, 0, &sequential_stats);
+                } else if (scan_mode) {
+                    sequential_result = sequential_scan(arr, array_size, elem, sequential_scan_out);
+                } else {
+                    sequential_result = sequential_sum(arr, array_size, elem);
+                }
+                perf_kernel_end(&perf_kernels[0], (size_t)array_size);
+            }
             double seq_end = MPI_Wtime();
-            total_seq_time += (seq_end - seq_start);
+            seq_time = seq_end - seq_start;
+            if (!streaming) prof_region(perf_kernels[0].name, seq_start, seq_end);
         }
 
         // Synchronize before parallel section
         MPI_Barrier(MPI_COMM_WORLD);
         double par_start = MPI_Wtime();
+        Stats* local_result = stats_mode ? &local_stats : NULL;
+        stats_init(&local_stats);
 
         // Parallel computation
-        MPI_Scatter(arr, local_size, MPI_INT, local_arr, local_size, MPI_INT, 0, MPI_COMM_WORLD);
+        if (pipelined) {
+            // Scatter and compute interleave: exposed wait vs consumer time
+            double wait_before = pipeline.wait_time, compute_before = pipeline.compute_time;
+            SumContext sum_ctx = {0, threads, elem, dist.local_first, local_result, &perf_kernels[1]};
+            const void* sendbufs[1] = {arr};
+            pipeline_run(&pipeline, sendbufs, sum_chunk, &sum_ctx);
+            local_sum = sum_ctx.sum;
+            phases[0] = pipeline.wait_time - wait_before;
+            phases[1] = pipeline.compute_time - compute_before;
+        } else if (streaming) {
+            // Reading the blocks takes the place of the scatter
+            double read_time = 0.0;
+            local_sum = stream_sum(&source, block, dist.local_first, dist.local_count, stream_block,
+                                   threads, local_result, &perf_kernels[1], &read_time);
+            phases[0] = read_time;
+            phases[1] = MPI_Wtime() - par_start - read_time;
+        } else {
+            if (shared) {
+                // Only slices of other nodes move; on the root's node this is a fence
+                shared_array_distribute(&shared_arr);
+            } else if (input_file) {
+                // Each rank reads its own slice: no scatter through rank 0
+                if (!input.use_mmap) {
+                    array_input_read(&input, dist.local_first, dist.local_count, local_arr, MPI_COMM_WORLD);
+                }
+            } else if (planned_scatter) {
+                comm_plan_run(&scatter_plan);
+            }
+            perf_kernel_begin(&perf_kernels[1]);
+            double compute_start = MPI_Wtime(), exchange_time = 0.0;
 
-        local_sum = 0;
-        for (int i = 0; i < local_size; i++) {
-            local_sum += local_arr[i];
+            if (scan_mode) {
+                // Pass 1 from zero, the slices' offsets, pass 2; rank 0's offset is 0
+                size_t n = (size_t)dist.local_count;
+                local_sum = scan_local(&scan_state, local_arr, elem, scan_out, n);
+                double exchange_start = MPI_Wtime();
+                MPI_Exscan(&local_sum, &scan_offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+                if (rank == 0) scan_offset = 0;
+                exchange_time = MPI_Wtime() - exchange_start;
+                scan_add_offset(&scan_state, scan_out, n, scan_offset);
+            } else {
+                local_sum = reduce_elements(local_arr, (size_t)dist.local_count, elem, dist.local_first, threads,
+                                            local_result);
+            }
+            double compute_end = MPI_Wtime();
+            perf_kernel_end(&perf_kernels[1], (size_t)dist.local_count);
+            prof_region(perf_kernels[1].name, compute_start, compute_end);
+            phases[0] = compute_start - par_start;
+            phases[1] = compute_end - compute_start - exchange_time;
+            phases[2] = exchange_time;
         }
 
-        MPI_Reduce(&local_sum, &total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        double reduce_start = MPI_Wtime();
+        if (scan_mode) {
+            // The exchange was MPI_Exscan between the passes; the results stay distributed
+        } else if (reduce_algo == REDUCE_LIBRARY) {
+            comm_plan_run(&reduce_plan);
+        } else if (stats_mode) {
+            reduce_run(&reduce_ctx, (ReduceAlgo)reduce_algo, &local_stats, &total_stats, 1, stats_mpi.type,
+                       stats_mpi.op, 0);
+        } else {
+            reduce_run(&reduce_ctx, (ReduceAlgo)reduce_algo, &local_sum, &total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0);
+        }
         double par_end = MPI_Wtime();
+        if (!scan_mode) phases[2] = par_end - reduce_start;
+
+        // Phase times of the slowest rank, outside the timed region
+        comm_plan_run(&phase_plan);
+
+        if (warming) {
+            int done = 0;
+            if (rank == 0) done = bench_warmup_done(&warmup, &bench, par_end - par_start);
+            MPI_Bcast(&done, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            warmup_iterations++;
+            if (done) {
+                warming = 0;
+                if (pipelined) pipeline.wait_time = pipeline.compute_time = 0.0;
+                perf_kernel_reset(&perf_kernels[0]);
+                perf_kernel_reset(&perf_kernels[1]);
+                mem_usage_now(&mem_before);
+            }
+        } else {
+            if (rank == 0) {
+                bench_series_add(&series[0], seq_time);
+                bench_series_add(&series[1], par_end - par_start);
+                for (int p = 0; p < 3; p++) bench_series_add(&series[2 + p], max_phases[p]);
+            }
+            measured++;
+        }
+    }
+
+    mem_usage_now(&mem_after);
 
+    // Scan check: each rank's running totals against the same slice of the
+    // sequential scan, through one hash and the last total per rank
+    unsigned long long scan_check[2] = {0, 0}, * scan_checks = NULL;
+    int scan_matches = 1;
+    if (scan_mode) {
+        scan_check[0] = scan_hash(scan_out, dist.local_count);
+        scan_check[1] = (unsigned long long)(scan_offset + local_sum);
+        if (rank == 0) scan_checks = (unsigned long long*)malloc((size_t)num_procs * 2 * sizeof(unsigned long long));
+        if (rank == 0 && !scan_checks) {
+            fprintf(stderr, "Error: Memory allocation failed for the scan check\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Gather(scan_check, 2, MPI_UNSIGNED_LONG_LONG, scan_checks, 2, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
         if (rank == 0) {
-            total_par_time += (par_end - par_start);
+            for (int r = 0; r < num_procs; r++) {
+                long long first = dist.displs[r], count = dist.counts[r];
+                long long last = count > 0 ? sequential_scan_out[first + count - 1] : 0;
+                if (scan_checks[2 * r] != scan_hash(sequential_scan_out + first, count) ||
+                    (count > 0 && scan_checks[2 * r + 1] != (unsigned long long)last)) {
+                    scan_matches = 0;
+                }
+            }
+            total_sum = (long long)scan_checks[2 * (num_procs - 1) + 1];
+            free(scan_checks);
         }
     }
 
+    // Pipeline statistics of the slowest rank
+    double max_wait_time = 0.0, max_compute_time = 0.0;
+    if (pipelined) {
+        MPI_Reduce(&pipeline.wait_time, &max_wait_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&pipeline.compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        pipeline_free(&pipeline);
+    }
+
     // Print results
     if (rank == 0) {
-        double avg_seq_time = total_seq_time / ITERATIONS;
-        double avg_par_time = total_par_time / ITERATIONS;
+        long long min_count = dist.max_count;
+        for (int r = 0; r < num_procs; r++) {
+            if (dist.counts[r] < min_count) min_count = dist.counts[r];
+        }
+        BenchStats seq_stats, par_stats, phase_stats[3];
+        bench_stats(&series[0], &bench, &seq_stats);
+        bench_stats(&series[1], &bench, &par_stats);
+        for (int p = 0; p < 3; p++) bench_stats(&series[2 + p], &bench, &phase_stats[p]);
+        double speedup = bench_speedup(&series[0], &series[1], &bench);
+        double seq_gbs = scan_mode ? scan_gbs((size_t)array_size, elem, seq_stats.median)
+                                   : element_sum_gbs((size_t)array_size, elem, seq_stats.median);
+        const char* kernel_name = scan_mode ? scan_kernel()->name : element_sum_kernel(elem);
+        double node_bw = node_mem_bw_gbs();
+        char stream_mode[64];
+        snprintf(stream_mode, sizeof(stream_mode), "streamed in %lld-element blocks from %s",
+                 stream_block, stream_file ? "file" : "Philox");
+        const char* data_mode = streaming ? stream_mode : local_gen ? "rank-local (Philox)"
+            : input_file ? (input.use_mmap ? "array file (mmap per rank)" : "array file (MPI_File_read_at_all)")
+            : pipelined ? "rank 0 + pipelined MPI_Iscatterv"
+            : shared ? "rank 0 into node-shared window (zero-copy)" : "rank 0 + MPI_Scatterv";
+
+        if (bench_human_output(&bench)) {
+            printf("Array size: %lld\n", array_size);
+            printf("Number of processes: %d\n", num_procs);
+            printf("Layout: %d ranks x %d threads\n", num_procs, threads);
+            printf("Data generation: %s\n", data_mode);
+            printf("Element type: %s (%zu byte%s per element)\n", element_name(elem), elem_size,
+                   elem_size > 1 ? "s" : "");
+            printf("Balance: %s (slices %lld..%lld elements)\n",
+                   dist.weighted ? "calibrated throughput weights" : "even", min_count, dist.max_count);
+            printf("Collectives: %s\n", comm_plan_backend(persistent));
+            if (stats_mode) {
+                printf("Statistics: count %lld, min %.0f, max %.0f (first at %lld), mean %.6f, variance %.6f\n",
+                       total_stats.count, total_stats.min, total_stats.max, total_stats.argmax, total_stats.mean,
+                       stats_variance(&total_stats));
+                printf("Check: parallel statistics %s sequential statistics\n",
+                       stats_match(&total_stats, &sequential_stats, 1e-9) ? "match" : "DO NOT match");
+            } else if (scan_mode) {
+                printf("Scan: %lld running totals (int64), distributed over %d ranks, last %lld\n", array_size,
+                       num_procs, total_sum);
+                printf("Check: distributed scan %s sequential scan\n", scan_matches ? "matches" : "DOES NOT match");
+            } else {
+                printf("Check: parallel sum %s sequential sum\n",
+                       total_sum == sequential_result ? "matches" : "DOES NOT match");
+            }
+            printf("\nAverage execution time:\n");
+            printf("  Sequential %s: %.6f sec\n", operation, seq_stats.mean);
+            printf("  Parallel %s:   %.6f sec\n", operation, par_stats.mean);
+            printf("  Speedup:       %.2fx (medians)\n", speedup);
+            printf("\nParallel phases (median, slowest rank):\n");
+            printf("  %s %.6f sec\n", pipelined ? "Scatter wait:" : streaming ? "Block reads: "
+                   : input_file ? "File read:   " : "Scatter:     ",
+                   phase_stats[0].median);
+            printf("  Compute:      %.6f sec\n", phase_stats[1].median);
+            if (scan_mode) {
+                printf("  Exscan:       %.6f sec (offsets between the two passes)\n", phase_stats[2].median);
+            } else {
+                printf("  Reduce:       %.6f sec (%s%s)\n", phase_stats[2].median, reduce_algo_names[reduce_algo],
+                       reduce_auto ? ", picked by REDUCE_ALGO=auto" : "");
+            }
+            if (reduce_auto) {
+                printf("  Reduction candidates (slowest rank, per call):");
+                for (int a = 0; a < REDUCE_NUM_ALGOS; a++) {
+                    printf("%s %s %.2f us", a ? "," : "", reduce_algo_names[a], 1e6 * reduce_times[a]);
+                }
+                printf("\n");
+            }
 
-        printf("Array size: %d\n", array_size);
-        printf("Number of processes: %d\n", num_procs);
-        printf("\nAverage execution time:\n");
-        printf("  Sequential sum: %.6f sec\n", avg_seq_time);
-        printf("  Parallel sum:   %.6f sec\n", avg_par_time);
-        printf("  Speedup:       %.2fx\n", avg_seq_time / avg_par_time);
+            if (stats_mode) {
+                printf("\nKernel: fused stats, %d-element blocks (%s)\n", STATS_BLOCK, element_name(elem));
+            } else if (scan_mode) {
+                printf("\nScan kernel: %s (%s in, int64 out)\n", kernel_name, element_name(elem));
+            } else {
+                printf("\nSum kernel: %s (%s)\n", element_sum_kernel(elem), element_name(elem));
+            }
+            printf("  Sequential bandwidth: %.2f GB/s", seq_gbs);
+            if (node_bw > 0) {
+                printf(" (%.1f%% of %.1f GB/s node bandwidth)", 100.0 * seq_gbs / node_bw, node_bw);
+            }
+            printf("\n");
 
-        free(arr);
+            if (pipelined) {
+                double wait = max_wait_time / bench.iterations;
+                printf("\nPipeline (chunk %d elements, depth %d):\n", chunk_size, pipeline_depth);
+                printf("  Exposed wait:       %.6f sec\n", wait);
+                printf("  Compute:            %.6f sec\n", max_compute_time / bench.iterations);
+                printf("  Blocking scatter:   %.6f sec\n", blocking_scatter_time);
+                printf("  Overlap:            %.0f%% of scatter time hidden\n",
+                       100.0 * pipeline_overlap(wait, blocking_scatter_time));
+            }
+        }
+
+        BenchParam params[11];
+        bench_param(&params[0], "array_size", "%.0f", array_size);
+        bench_param(&params[1], "processes", "%.0f", num_procs);
+        bench_param(&params[2], "threads", "%.0f", threads);
+        bench_param_str(&params[3], "data", data_mode);
+        bench_param_str(&params[4], "sum_kernel", kernel_name);
+        bench_param(&params[5], "speedup", "%.4f", speedup);
+        bench_param(&params[6], "seq_gbs", "%.3f", seq_gbs);
+        bench_param_str(&params[7], "element_type", element_name(elem));
+        bench_param_str(&params[8], "operation", operation);
+        bench_param_str(&params[9], "comm_plan", persistent ? "persistent" : "replay");
+        bench_param_str(&params[10], "reduce_algo", reduce_algo_names[reduce_algo]);
+        bench_report(&bench, "task1", series, 5, params, 11, warmup_iterations);
     }
 
-    free(local_arr);
+    // Counters per rank against the STREAM roof measured on all ranks at once
+    if (perf) {
+        double stream_gbs = perf_stream_triad_gbs(perf_stream_size(), threads, 5, MPI_COMM_WORLD);
+        if (bench_human_output(&bench)) perf_report(perf_kernels, 2, stream_gbs, MPI_COMM_WORLD);
+        perf_counters_close(&counters);
+    }
+    if (bench_human_output(&bench)) {
+        numa_report(MPI_COMM_WORLD);
+        mem_usage_report(&mem_before, &mem_after, MPI_COMM_WORLD);
+    }
+
+    if (shared) {
+        shared_array_free(&shared_arr);
+    }
+    arena_free(&arena);
+    if (input_file) array_input_close(&input);
+    if (streaming) block_source_close(&source);
+    if (planned_scatter) comm_plan_free(&scatter_plan);
+    comm_plan_free(&reduce_plan);
+    comm_plan_free(&phase_plan);
+    if (reduce_ctx_open) reduce_context_free(&reduce_ctx);
+    distribution_free(&dist);
+    if (stats_mode) stats_mpi_free(&stats_mpi);
+    if (scan_mode) scan_state_free(&scan_state);
+    for (int i = 0; i < 5; i++) bench_series_free(&series[i]);
     MPI_Finalize();
     return 0;
 }
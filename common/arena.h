@@ -0,0 +1,84 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "bench.h"
+#include "numa_alloc.h"
+
+// Buffer arena: one region per rank from numa_alloc (NUMA placed, first
+// touched, huge pages requested) that all input and output buffers are
+// carved from before the benchmark loop. Nothing is allocated or faulted
+// inside the loop, so timings measure the kernels only. Buffers of 2 MB
+// and more start on a huge-page boundary, smaller ones on a cache line.
+//
+// mem_usage_report() prints the peak RSS and page faults (bench.h) of every
+// rank, so allocation effects show up apart from kernel cost.
+
+#define ARENA_ALIGN 64
+
+typedef struct {
+    char* base;
+    size_t capacity;
+    size_t used;
+} Arena;
+
+static inline size_t arena_align_of(size_t bytes) {
+    return bytes >= NUMA_PAGE_SIZE ? NUMA_PAGE_SIZE : ARENA_ALIGN;
+}
+
+// Capacity to reserve for one buffer of `bytes`, including the worst-case
+// alignment padding in front of it. The base is only 16-byte aligned when
+// numa_alloc falls back to calloc (NUMA_ALLOC=0), so nothing is assumed.
+static inline size_t arena_size(size_t bytes) {
+    size_t align = arena_align_of(bytes);
+    return (bytes + align - 1) / align * align + (align - 1);
+}
+
+// 0 on success; `threads` first-touch the region (see numa_alloc)
+static inline int arena_init(Arena* a, size_t capacity, int threads) {
+    a->capacity = capacity > 0 ? capacity : ARENA_ALIGN;
+    a->used = 0;
+    a->base = (char*)numa_alloc(a->capacity, threads);
+    return a->base ? 0 : -1;
+}
+
+// NULL when the arena is exhausted
+static inline void* arena_alloc(Arena* a, size_t bytes) {
+    size_t align = arena_align_of(bytes);
+    size_t start = ((size_t)a->base + a->used + align - 1) / align * align - (size_t)a->base;
+    if (start + bytes > a->capacity) return NULL;
+    a->used = start + bytes;
+    return a->base + start;
+}
+
+static inline void arena_free(Arena* a) {
+    numa_free(a->base, a->capacity);
+    a->base = NULL;
+    a->capacity = a->used = 0;
+}
+
+// Collective over `comm`: rank 0 prints the peak RSS of every rank and the
+// page faults each took between `before` and `after` (the measured loop)
+static inline void mem_usage_report(const MemUsage* before, const MemUsage* after, MPI_Comm comm) {
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    MemUsage d = mem_usage_delta(before, after);
+    long mine[3] = {d.peak_rss_kb, d.minor_faults, d.major_faults};
+    long* all = rank == 0 ? (long*)malloc(3 * (size_t)num_procs * sizeof(long)) : NULL;
+    MPI_Gather(mine, 3, MPI_LONG, all, 3, MPI_LONG, 0, comm);
+    if (!all) return;
+    printf("\nMemory (page faults during the measured iterations):\n");
+    for (int r = 0; r < num_procs; r++) {
+        const long* f = all + 3 * (size_t)r;
+        MemUsage delta = {f[0], f[1], f[2]};
+        printf("  rank %d: ", r);
+        mem_usage_print(&delta);
+    }
+    free(all);
+}
+
+#endif
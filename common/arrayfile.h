@@ -0,0 +1,282 @@
+#ifndef ARRAYFILE_H
+#define ARRAYFILE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mpi.h>
+
+// Binary array files: a 64-byte header followed by `count` native-endian
+// elements. The checksum is sum(mix(bits(x[i]) + i * golden)) mod 2^64 with
+// the splitmix64 finalizer as mix: it depends on every bit and position, and
+// any rank can compute the part of its own slice; the parts add up to the
+// header value.
+//
+// Readers: arrayfile_map() maps a whole file (mmap + MADV_SEQUENTIAL, for
+// one process or one node), ArrayInput lets every rank of an MPI job read
+// only its slice, with collective MPI_File_read_at_all or from the mapping.
+// array_output_write() writes the slices of all ranks as one file with
+// collective MPI-IO; tools/make_array.c writes files from one process.
+//
+// Environment:
+//   INPUT_IO  mpiio (collective reads) or mmap (every rank maps the file);
+//             default mmap when all ranks share one node, mpiio otherwise
+
+#define ARRAYFILE_MAGIC "ARRFILE"
+#define ARRAYFILE_VERSION 1
+#define ARRAYFILE_IO_BLOCK (1 << 27)  // elements per collective read
+
+typedef enum { ARRAYFILE_INT32 = 1, ARRAYFILE_FLOAT64 = 2 } ArrayFileType;
+
+typedef struct {
+    char magic[8];  // ARRAYFILE_MAGIC, NUL terminated
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t count;
+    uint64_t checksum;
+    uint8_t reserved[32];
+} ArrayFileHeader;
+
+static inline size_t arrayfile_dtype_size(uint32_t dtype) {
+    return dtype == ARRAYFILE_INT32 ? 4 : dtype == ARRAYFILE_FLOAT64 ? 8 : 0;
+}
+
+static inline const char* arrayfile_dtype_name(uint32_t dtype) {
+    return dtype == ARRAYFILE_INT32 ? "int32" : dtype == ARRAYFILE_FLOAT64 ? "float64" : "unknown";
+}
+
+static inline void arrayfile_header_init(ArrayFileHeader* h, uint32_t dtype, uint64_t count,
+                                         uint64_t checksum) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, ARRAYFILE_MAGIC, sizeof(ARRAYFILE_MAGIC));
+    h->version = ARRAYFILE_VERSION;
+    h->dtype = dtype;
+    h->count = count;
+    h->checksum = checksum;
+}
+
+// 1 for a header this code can read
+static inline int arrayfile_header_valid(const ArrayFileHeader* h) {
+    return memcmp(h->magic, ARRAYFILE_MAGIC, sizeof(ARRAYFILE_MAGIC)) == 0 &&
+           h->version == ARRAYFILE_VERSION && arrayfile_dtype_size(h->dtype) > 0;
+}
+
+static inline uint64_t arrayfile_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Checksum part of elements [first, first + count) held in `data`
+static inline uint64_t arrayfile_checksum(const void* data, uint32_t dtype, uint64_t first, size_t count) {
+    const uint64_t golden = 0x9E3779B97F4A7C15ull;
+    uint64_t sum = 0;
+    if (dtype == ARRAYFILE_INT32) {
+        const uint32_t* x = (const uint32_t*)data;
+        for (size_t i = 0; i < count; i++) sum += arrayfile_mix(x[i] + (first + i) * golden);
+    } else {
+        const unsigned char* x = (const unsigned char*)data;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t bits;
+            memcpy(&bits, x + 8 * i, 8);
+            sum += arrayfile_mix(bits + (first + i) * golden);
+        }
+    }
+    return sum;
+}
+
+// Writes the header at the start of `out` (again, once the checksum is known)
+static inline int arrayfile_write_header(FILE* out, const ArrayFileHeader* h) {
+    return fseek(out, 0, SEEK_SET) == 0 && fwrite(h, sizeof(*h), 1, out) == 1 ? 0 : -1;
+}
+
+typedef struct {
+    void* base;
+    size_t length;
+    ArrayFileHeader header;
+} ArrayFileMap;
+
+// Maps `path` read-only; 0 on success, -1 if it cannot be opened or is not
+// a complete array file
+static inline int arrayfile_map(ArrayFileMap* m, const char* path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    m->base = NULL;
+    m->length = 0;
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ArrayFileHeader) ||
+        pread(fd, &m->header, sizeof(m->header), 0) != (ssize_t)sizeof(m->header) ||
+        !arrayfile_header_valid(&m->header) ||
+        (uint64_t)st.st_size - sizeof(ArrayFileHeader) < m->header.count * arrayfile_dtype_size(m->header.dtype)) {
+        close(fd);
+        return -1;
+    }
+    m->length = (size_t)st.st_size;
+    m->base = mmap(NULL, m->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file
+    if (m->base == MAP_FAILED) {
+        m->base = NULL;
+        return -1;
+    }
+    madvise(m->base, m->length, MADV_SEQUENTIAL);
+    return 0;
+}
+
+static inline const void* arrayfile_map_data(const ArrayFileMap* m) {
+    return (const char*)m->base + sizeof(ArrayFileHeader);
+}
+
+static inline void arrayfile_unmap(ArrayFileMap* m) {
+    if (m->base) munmap(m->base, m->length);
+    m->base = NULL;
+}
+
+// One input array of an MPI job. Rank 0 always maps the whole file for
+// the sequential baseline; with INPUT_IO=mmap every rank does, and a slice
+// is a pointer into the mapping instead of a read.
+typedef struct {
+    MPI_File fh;
+    ArrayFileHeader header;
+    ArrayFileMap map;
+    int use_mmap;
+} ArrayInput;
+
+// INPUT_IO: 1 for mmap, 0 for collective MPI-IO
+static inline int array_input_mmap_from_env(MPI_Comm comm) {
+    const char* str = getenv("INPUT_IO");
+    if (str) return strcmp(str, "mmap") == 0;
+    int size, node_size;
+    MPI_Comm node_comm;
+    MPI_Comm_size(comm, &size);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm_free(&node_comm);
+    return node_size == size;
+}
+
+// Collective over `comm`. Returns 0 on success on every rank, -1 when the
+// file is missing, truncated, not an array file or not of type `dtype`.
+static inline int array_input_open(ArrayInput* in, const char* path, uint32_t dtype, int use_mmap,
+                                   MPI_Comm comm) {
+    int rank, ok;
+    MPI_Comm_rank(comm, &rank);
+    in->use_mmap = use_mmap;
+    in->fh = MPI_FILE_NULL;
+    in->map.base = NULL;
+    ok = MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &in->fh) == MPI_SUCCESS;
+    if (ok) {
+        MPI_Status status;
+        int got = 0;
+        ok = MPI_File_read_at_all(in->fh, 0, &in->header, (int)sizeof(in->header), MPI_BYTE,
+                                  &status) == MPI_SUCCESS;
+        if (ok) MPI_Get_count(&status, MPI_BYTE, &got);
+        ok = ok && got == (int)sizeof(in->header) && arrayfile_header_valid(&in->header) &&
+             in->header.dtype == dtype;
+    }
+    if (ok && (rank == 0 || use_mmap)) ok = arrayfile_map(&in->map, path) == 0;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!ok) {
+        if (in->fh != MPI_FILE_NULL) MPI_File_close(&in->fh);
+        arrayfile_unmap(&in->map);
+        return -1;
+    }
+    return 0;
+}
+
+static inline long long array_input_count(const ArrayInput* in) {
+    return (long long)in->header.count;
+}
+
+// Whole array (rank 0, or every rank with mmap)
+static inline const void* array_input_data(const ArrayInput* in) {
+    return in->map.base ? arrayfile_map_data(&in->map) : NULL;
+}
+
+// Collective over `comm`: elements [first, first + count) into `buf`, in
+// rounds of at most ARRAYFILE_IO_BLOCK elements so counts stay in an int
+static inline int array_input_read(ArrayInput* in, long long first, long long count, void* buf,
+                                   MPI_Comm comm) {
+    size_t esize = arrayfile_dtype_size(in->header.dtype);
+    long long rounds = (count + ARRAYFILE_IO_BLOCK - 1) / ARRAYFILE_IO_BLOCK;
+    int rc = MPI_SUCCESS;
+    MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_LONG_LONG, MPI_MAX, comm);
+    for (long long r = 0; r < rounds; r++) {
+        long long done = r * ARRAYFILE_IO_BLOCK;
+        long long n = count - done < ARRAYFILE_IO_BLOCK ? count - done : ARRAYFILE_IO_BLOCK;
+        if (n < 0) n = 0;
+        MPI_Offset offset = (MPI_Offset)sizeof(ArrayFileHeader) + (MPI_Offset)(first + done) * (MPI_Offset)esize;
+        int step = MPI_File_read_at_all(in->fh, offset, (char*)buf + (size_t)done * esize,
+                                        (int)(n * (long long)esize), MPI_BYTE, MPI_STATUS_IGNORE);
+        if (rc == MPI_SUCCESS) rc = step;
+    }
+    return rc;
+}
+
+
+// Collective over `comm`: checksum of the whole array from the slices
+// [first, first + count) of all ranks
+static inline uint64_t arrayfile_checksum_all(const void* slice, uint32_t dtype, long long first,
+                                              long long count, MPI_Comm comm) {
+    uint64_t sum = arrayfile_checksum(slice, dtype, (uint64_t)first, (size_t)count);
+    MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_UINT64_T, MPI_SUM, comm);
+    return sum;
+}
+
+// Collective over `comm`: writes `path` as an array file of `total`
+// elements, each rank its slice [first, first + count), in rounds of at most
+// ARRAYFILE_IO_BLOCK elements. The header (written by rank 0) carries the
+// checksum, which is also stored in *checksum. Returns 0 on every rank on
+// success.
+static inline int array_output_write(const char* path, uint32_t dtype, const void* slice, long long first,
+                                     long long count, long long total, uint64_t* checksum,
+                                     MPI_Comm comm) {
+    int rank, ok;
+    size_t esize = arrayfile_dtype_size(dtype);
+    MPI_File fh;
+    MPI_Comm_rank(comm, &rank);
+    *checksum = arrayfile_checksum_all(slice, dtype, first, count, comm);
+    ok = MPI_File_open(comm, path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) == MPI_SUCCESS;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!ok) return -1;
+    // Truncates a longer file from an earlier run
+    ok = MPI_File_set_size(fh, (MPI_Offset)sizeof(ArrayFileHeader) + (MPI_Offset)total * (MPI_Offset)esize) ==
+         MPI_SUCCESS;
+    if (rank == 0) {
+        ArrayFileHeader header;
+        arrayfile_header_init(&header, dtype, (uint64_t)total, *checksum);
+        ok = ok && MPI_File_write_at(fh, 0, &header, (int)sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE) ==
+                       MPI_SUCCESS;
+    }
+    long long rounds = (count + ARRAYFILE_IO_BLOCK - 1) / ARRAYFILE_IO_BLOCK;
+    MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_LONG_LONG, MPI_MAX, comm);
+    for (long long r = 0; r < rounds; r++) {
+        long long done = r * ARRAYFILE_IO_BLOCK;
+        long long n = count - done < ARRAYFILE_IO_BLOCK ? count - done : ARRAYFILE_IO_BLOCK;
+        if (n < 0) n = 0;
+        MPI_Offset offset = (MPI_Offset)sizeof(ArrayFileHeader) + (MPI_Offset)(first + done) * (MPI_Offset)esize;
+        ok = MPI_File_write_at_all(fh, offset, (const char*)slice + (size_t)done * esize,
+                                   (int)(n * (long long)esize), MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS && ok;
+    }
+    ok = MPI_File_close(&fh) == MPI_SUCCESS && ok;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    return ok ? 0 : -1;
+}
+
+// Collective over `comm`: 1 on every rank when the slices of all ranks
+// together match the header checksum
+static inline int array_input_verify(const ArrayInput* in, const void* slice, long long first,
+                                     long long count, MPI_Comm comm) {
+    return arrayfile_checksum_all(slice, in->header.dtype, first, count, comm) == in->header.checksum;
+}
+
+static inline void array_input_close(ArrayInput* in) {
+    if (in->fh != MPI_FILE_NULL) MPI_File_close(&in->fh);
+    arrayfile_unmap(&in->map);
+}
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Benchmark harness shared by all programs. Every iteration's wall-clock
+// sample is kept, so the report has min, median, p90, p99, mean and
+// stddev instead of a bare average. Warm-up stops once the last few samples
+// agree, and runs that are too noisy to trust are flagged.
+//
+// Environment:
+//   ITERATIONS     measured iterations (program default otherwise)
+//   WARMUP_MAX     upper bound on warm-up iterations (default 20)
+//   WARMUP_CV      warm-up ends when the last 3 samples are within this
+//                  coefficient of variation (default 0.05)
+//   BENCH_MAX_CV   runs above this coefficient of variation are flagged
+//                  as unstable (default 0.10)
+//   BENCH_FORMAT   text (default), csv or json
+//   BENCH_OUTPUT   append the csv/json record to this file instead of stdout
+//
+// mem_usage_now() samples peak RSS and page-fault counters; the difference
+// of two samples around the measured loop shows allocation cost apart from
+// kernel time.
+
+#define BENCH_WARMUP_WINDOW 3
+
+typedef enum { BENCH_TEXT, BENCH_CSV, BENCH_JSON } BenchFormat;
+
+typedef struct {
+    int iterations;
+    int max_warmup;
+    double warmup_cv;
+    double max_cv;
+    BenchFormat format;
+    const char* output;
+} BenchConfig;
+
+typedef struct {
+    const char* name;
+    double* samples;
+    int count;
+    int capacity;
+} BenchSeries;
+
+typedef struct {
+    int count;
+    double min, median, p90, p99, mean, stddev, cv;
+    int unstable;
+} BenchStats;
+
+typedef struct {
+    double recent[BENCH_WARMUP_WINDOW];
+    int count;
+} BenchWarmup;
+
+// Free-form key/value pair reported with the results (size, processes, ...).
+// Numbers are formatted into `value`; strings are referenced as `text`, so
+// they must live until bench_report and are never cut (expressions).
+typedef struct {
+    const char* key;
+    char value[64];
+    const char* text;
+} BenchParam;
+
+static inline void bench_config_from_env(BenchConfig* cfg, int default_iterations) {
+    const char* str;
+    cfg->iterations = (str = getenv("ITERATIONS")) ? atoi(str) : default_iterations;
+    cfg->max_warmup = (str = getenv("WARMUP_MAX")) ? atoi(str) : 20;
+    cfg->warmup_cv = (str = getenv("WARMUP_CV")) ? atof(str) : 0.05;
+    cfg->max_cv = (str = getenv("BENCH_MAX_CV")) ? atof(str) : 0.10;
+    cfg->output = getenv("BENCH_OUTPUT");
+    cfg->format = BENCH_TEXT;
+    if ((str = getenv("BENCH_FORMAT"))) {
+        if (strcmp(str, "csv") == 0) cfg->format = BENCH_CSV;
+        if (strcmp(str, "json") == 0) cfg->format = BENCH_JSON;
+    }
+    if (cfg->iterations < 1) cfg->iterations = default_iterations;
+    if (cfg->max_warmup < 0) cfg->max_warmup = 0;
+}
+
+// Wall-clock time in seconds (clock() would measure CPU time)
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline int bench_series_init(BenchSeries* s, const char* name, int capacity) {
+    s->name = name;
+    s->count = 0;
+    s->capacity = capacity > 0 ? capacity : 1;
+    s->samples = (double*)malloc(s->capacity * sizeof(double));
+    return s->samples ? 0 : -1;
+}
+
+static inline void bench_series_add(BenchSeries* s, double seconds) {
+    if (s->count == s->capacity) {
+        double* grown = (double*)realloc(s->samples, 2 * s->capacity * sizeof(double));
+        if (!grown) return;
+        s->samples = grown;
+        s->capacity *= 2;
+    }
+    s->samples[s->count++] = seconds;
+}
+
+static inline void bench_series_free(BenchSeries* s) {
+    free(s->samples);
+    s->samples = NULL;
+}
+
+static inline int bench_compare_double(const void* x, const void* y) {
+    double a = *(const double*)x, b = *(const double*)y;
+    return (a > b) - (a < b);
+}
+
+// Nearest-rank percentile of sorted samples
+static inline double bench_percentile(const double* sorted, int count, double p) {
+    int rank = (int)ceil(p / 100.0 * count);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static inline void bench_stats(const BenchSeries* s, const BenchConfig* cfg, BenchStats* st) {
+    memset(st, 0, sizeof(*st));
+    st->count = s->count;
+    if (s->count == 0) return;
+    double* sorted = (double*)malloc(s->count * sizeof(double));
+    if (!sorted) return;
+    memcpy(sorted, s->samples, s->count * sizeof(double));
+    qsort(sorted, s->count, sizeof(double), bench_compare_double);
+
+    double sum = 0.0, sq = 0.0;
+    for (int i = 0; i < s->count; i++) sum += sorted[i];
+    st->mean = sum / s->count;
+    for (int i = 0; i < s->count; i++) sq += (sorted[i] - st->mean) * (sorted[i] - st->mean);
+    st->stddev = s->count > 1 ? sqrt(sq / (s->count - 1)) : 0.0;
+    st->cv = st->mean > 0 ? st->stddev / st->mean : 0.0;
+    st->min = sorted[0];
+    st->median = s->count % 2 ? sorted[s->count / 2]
+                              : 0.5 * (sorted[s->count / 2 - 1] + sorted[s->count / 2]);
+    st->p90 = bench_percentile(sorted, s->count, 90.0);
+    st->p99 = bench_percentile(sorted, s->count, 99.0);
+    st->unstable = st->cv > cfg->max_cv;
+    free(sorted);
+}
+
+// Feeds one warm-up sample; returns 1 once warm-up is over (the last
+// BENCH_WARMUP_WINDOW samples are stable, or WARMUP_MAX was reached).
+static inline int bench_warmup_done(BenchWarmup* w, const BenchConfig* cfg, double sample) {
+    w->recent[w->count % BENCH_WARMUP_WINDOW] = sample;
+    w->count++;
+    if (w->count >= cfg->max_warmup) return 1;
+    if (w->count < BENCH_WARMUP_WINDOW) return 0;
+    double mean = 0.0, sq = 0.0;
+    for (int i = 0; i < BENCH_WARMUP_WINDOW; i++) mean += w->recent[i];
+    mean /= BENCH_WARMUP_WINDOW;
+    for (int i = 0; i < BENCH_WARMUP_WINDOW; i++) sq += (w->recent[i] - mean) * (w->recent[i] - mean);
+    return mean > 0 && sqrt(sq / (BENCH_WARMUP_WINDOW - 1)) / mean <= cfg->warmup_cv;
+}
+
+static inline void bench_param(BenchParam* p, const char* key, const char* fmt, double value) {
+    p->key = key;
+    p->text = NULL;
+    snprintf(p->value, sizeof(p->value), fmt, value);
+}
+
+static inline void bench_param_str(BenchParam* p, const char* key, const char* value) {
+    p->key = key;
+    p->value[0] = '\0';
+    p->text = value;
+}
+
+static inline const char* bench_param_value(const BenchParam* p) {
+    return p->text ? p->text : p->value;
+}
+
+// Median-based speedup of `base` over `improved`
+static inline double bench_speedup(const BenchSeries* base, const BenchSeries* improved,
+                                   const BenchConfig* cfg) {
+    BenchStats b, i;
+    bench_stats(base, cfg, &b);
+    bench_stats(improved, cfg, &i);
+    return i.median > 0 ? b.median / i.median : 0.0;
+}
+
+static inline void bench_report_text(FILE* out, const BenchConfig* cfg, const BenchSeries* series,
+                                     int num_series, int warmup_iterations) {
+    fprintf(out, "\nPer-iteration statistics (%d iterations after %d warm-up, seconds):\n",
+            cfg->iterations, warmup_iterations);
+    fprintf(out, "  %-22s %10s %10s %10s %10s %10s %7s\n",
+            "series", "min", "median", "p90", "p99", "stddev", "cv");
+    for (int i = 0; i < num_series; i++) {
+        BenchStats st;
+        bench_stats(&series[i], cfg, &st);
+        fprintf(out, "  %-22s %10.6f %10.6f %10.6f %10.6f %10.6f %6.1f%%%s\n",
+                series[i].name, st.min, st.median, st.p90, st.p99, st.stddev, 100.0 * st.cv,
+                st.unstable ? "  UNSTABLE" : "");
+    }
+}
+
+// One CSV field, RFC 4180: quoted when it holds a comma, quote or line
+// break, with embedded quotes doubled
+static inline void bench_csv_field(FILE* out, const char* text) {
+    if (!strpbrk(text, ",\"\r\n")) {
+        fputs(text, out);
+        return;
+    }
+    fputc('"', out);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"') fputc('"', out);
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+// One JSON string with its quotes; quote, backslash and control characters
+// escaped
+static inline void bench_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') fprintf(out, "\\%c", *c);
+        else if (*c < 0x20) fprintf(out, "\\u%04x", *c);
+        else fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static inline void bench_report_csv(FILE* out, const char* program, const BenchConfig* cfg,
+                                    const BenchSeries* series, int num_series,
+                                    const BenchParam* params, int num_params) {
+    if (out == stdout || (fseek(out, 0, SEEK_END) == 0 && ftell(out) <= 0)) {  // header once per file
+        fprintf(out, "program,series,iterations,min,median,p90,p99,mean,stddev,cv,unstable");
+        for (int p = 0; p < num_params; p++) {
+            fputc(',', out);
+            bench_csv_field(out, params[p].key);
+        }
+        fprintf(out, "\n");
+    }
+    for (int i = 0; i < num_series; i++) {
+        BenchStats st;
+        bench_stats(&series[i], cfg, &st);
+        bench_csv_field(out, program);
+        fputc(',', out);
+        bench_csv_field(out, series[i].name);
+        fprintf(out, ",%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.6f,%d", st.count, st.min, st.median, st.p90, st.p99,
+                st.mean, st.stddev, st.cv, st.unstable);
+        for (int p = 0; p < num_params; p++) {
+            fputc(',', out);
+            bench_csv_field(out, bench_param_value(&params[p]));
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static inline void bench_report_json(FILE* out, const char* program, const BenchConfig* cfg,
+                                     const BenchSeries* series, int num_series,
+                                     const BenchParam* params, int num_params, int warmup_iterations) {
+    fprintf(out, "{\"program\":");
+    bench_json_string(out, program);
+    fprintf(out, ",\"warmup_iterations\":%d,\"params\":{", warmup_iterations);
+    for (int p = 0; p < num_params; p++) {
+        if (p) fputc(',', out);
+        bench_json_string(out, params[p].key);
+        fputc(':', out);
+        bench_json_string(out, bench_param_value(&params[p]));
+    }
+    fprintf(out, "},\"series\":[");
+    for (int i = 0; i < num_series; i++) {
+        BenchStats st;
+        bench_stats(&series[i], cfg, &st);
+        fprintf(out, "%s{\"name\":", i ? "," : "");
+        bench_json_string(out, series[i].name);
+        fprintf(out, ",\"iterations\":%d,\"min\":%.9f,\"median\":%.9f,"
+                "\"p90\":%.9f,\"p99\":%.9f,\"mean\":%.9f,\"stddev\":%.9f,\"cv\":%.6f,"
+                "\"unstable\":%s,\"samples\":[",
+                st.count, st.min, st.median, st.p90, st.p99,
+                st.mean, st.stddev, st.cv, st.unstable ? "true" : "false");
+        for (int k = 0; k < series[i].count; k++) {
+            fprintf(out, "%s%.9f", k ? "," : "", series[i].samples[k]);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "]}\n");
+}
+
+// Peak resident set and page faults of this process (getrusage)
+typedef struct {
+    long peak_rss_kb;
+    long minor_faults;
+    long major_faults;
+} MemUsage;
+
+static inline void mem_usage_now(MemUsage* m) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    m->peak_rss_kb = ru.ru_maxrss;  // kB on Linux
+    m->minor_faults = ru.ru_minflt;
+    m->major_faults = ru.ru_majflt;
+}
+
+// Faults between `before` and `after`, with the peak RSS of `after`
+static inline MemUsage mem_usage_delta(const MemUsage* before, const MemUsage* after) {
+    MemUsage d = {after->peak_rss_kb, after->minor_faults - before->minor_faults,
+                  after->major_faults - before->major_faults};
+    return d;
+}
+
+// One line, e.g. "peak RSS 36.2 MB, 0 minor / 0 major faults"
+static inline void mem_usage_print(const MemUsage* d) {
+    printf("peak RSS %.1f MB, %ld minor / %ld major faults\n", d->peak_rss_kb / 1024.0,
+           d->minor_faults, d->major_faults);
+}
+
+// Human-readable summaries go to stdout unless stdout carries csv/json
+static inline int bench_human_output(const BenchConfig* cfg) {
+    return cfg->format == BENCH_TEXT || cfg->output != NULL;
+}
+
+// Writes the report in the configured format. Text goes to stdout; csv and
+// json go to BENCH_OUTPUT (appended) when set, stdout otherwise.
+static inline void bench_report(const BenchConfig* cfg, const char* program,
+                                const BenchSeries* series, int num_series,
+                                const BenchParam* params, int num_params, int warmup_iterations) {
+    if (cfg->format == BENCH_TEXT) {
+        bench_report_text(stdout, cfg, series, num_series, warmup_iterations);
+        return;
+    }
+    FILE* out = cfg->output ? fopen(cfg->output, "a") : stdout;
+    if (!out) {
+        fprintf(stderr, "Warning: cannot open %s, writing to stdout\n", cfg->output);
+        out = stdout;
+    }
+    if (cfg->format == BENCH_CSV) {
+        bench_report_csv(out, program, cfg, series, num_series, params, num_params);
+    } else {
+        bench_report_json(out, program, cfg, series, num_series, params, num_params, warmup_iterations);
+    }
+    if (out != stdout) fclose(out);
+}
+
+#endif
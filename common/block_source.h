@@ -0,0 +1,121 @@
+#ifndef BLOCK_SOURCE_H
+#define BLOCK_SOURCE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "philox.h"
+#include "arrayfile.h"
+
+// Out-of-core input for the streaming mode (STREAM_BLOCK). A rank walks its
+// share [first, first + count) in blocks of STREAM_BLOCK elements, so peak
+// memory is a few blocks per rank however large the array is. Blocks come
+// from a raw binary file of native-endian elements or an array file
+// (common/arrayfile.h; pread at the element offset, no shared file pointer)
+// or, without a file, from the Philox
+// generator, which gives the same values as the in-memory DATA_GEN=local
+// fill of the same seed and stream.
+
+typedef enum { BLOCK_FILE, BLOCK_PHILOX_INT, BLOCK_PHILOX_DOUBLE } BlockSourceKind;
+
+typedef struct {
+    BlockSourceKind kind;
+    int fd;
+    off_t offset;     // of element 0 in the file
+    size_t elem_size;
+    long long count;  // elements in the file, -1 for the generator
+    uint64_t seed;
+    uint32_t stream;
+    uint32_t bound;
+    uint32_t lo;
+} BlockSource;
+
+// STREAM_BLOCK elements per block; 0 (unset) disables streaming
+static inline long long stream_block_from_env(void) {
+    const char* str = getenv("STREAM_BLOCK");
+    long long block = str ? atoll(str) : 0;
+    return block > 0 ? block : 0;
+}
+
+static inline void block_source_close(BlockSource* src) {
+    if (src->fd >= 0) close(src->fd);
+    src->fd = -1;
+}
+
+// Raw elements, or the data of an array file of the same element size.
+// On failure nothing stays open (fd -1).
+static inline int block_source_file(BlockSource* src, const char* path, size_t elem_size) {
+    struct stat st;
+    ArrayFileHeader header;
+    src->kind = BLOCK_FILE;
+    src->elem_size = elem_size;
+    src->offset = 0;
+    src->fd = open(path, O_RDONLY);
+    if (src->fd < 0 || fstat(src->fd, &st) != 0) {
+        block_source_close(src);
+        return -1;
+    }
+    src->count = (long long)st.st_size / (long long)elem_size;
+    if (pread(src->fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        arrayfile_header_valid(&header)) {
+        if (arrayfile_dtype_size(header.dtype) != elem_size) {
+            block_source_close(src);
+            return -1;
+        }
+        src->offset = (off_t)sizeof(header);
+        src->count = (long long)header.count;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(src->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return 0;
+}
+
+// Integers in [0, bound), as philox_fill_int
+static inline void block_source_philox_int(BlockSource* src, uint64_t seed, uint32_t stream, uint32_t bound) {
+    src->kind = BLOCK_PHILOX_INT;
+    src->fd = -1;
+    src->offset = 0;
+    src->elem_size = sizeof(int);
+    src->count = -1;
+    src->seed = seed;
+    src->stream = stream;
+    src->bound = bound;
+}
+
+// Doubles lo + [0, bound), as philox_fill_double
+static inline void block_source_philox_double(BlockSource* src, uint64_t seed, uint32_t stream,
+                                              uint32_t lo, uint32_t bound) {
+    block_source_philox_int(src, seed, stream, bound);
+    src->kind = BLOCK_PHILOX_DOUBLE;
+    src->elem_size = sizeof(double);
+    src->lo = lo;
+}
+
+// Elements [first, first + count) into `out`; 0 on success
+static inline int block_source_read(const BlockSource* src, void* out, long long first, long long count) {
+    if (src->kind == BLOCK_PHILOX_INT) {
+        philox_fill_int((int*)out, (size_t)first, (size_t)count, src->seed, src->stream, src->bound);
+        return 0;
+    }
+    if (src->kind == BLOCK_PHILOX_DOUBLE) {
+        philox_fill_double((double*)out, (size_t)first, (size_t)count, src->seed, src->stream,
+                           src->lo, src->bound);
+        return 0;
+    }
+    char* dst = (char*)out;
+    size_t left = (size_t)count * src->elem_size;
+    off_t offset = src->offset + (off_t)first * (off_t)src->elem_size;
+    while (left > 0) {
+        ssize_t got = pread(src->fd, dst, left, offset);
+        if (got <= 0) return -1;
+        dst += got;
+        offset += got;
+        left -= (size_t)got;
+    }
+    return 0;
+}
+
+#endif
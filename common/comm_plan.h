@@ -0,0 +1,197 @@
+#ifndef COMM_PLAN_H
+#define COMM_PLAN_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#if !defined(MPI_VERSION) || MPI_VERSION < 4
+#if defined(OPEN_MPI) && OPEN_MPI
+#include <mpi-ext.h>  // MPIX_*_init of the pcollreq extension (Open MPI 4)
+#endif
+#endif
+#include "large_count.h"
+
+// Communication plans: a collective of the measurement loops (the scatter
+// of the inputs, the final reduction) set up once for its buffers and
+// shape and then only restarted, so argument checks, count conversions and
+// algorithm selection are paid once instead of every iteration.
+//
+// Backends, best first:
+//   MPI 4           MPI_Scatterv_init_c / MPI_Reduce_init + MPI_Start/MPI_Wait
+//   Open MPI 4      MPIX_Scatterv_init / MPIX_Reduce_init (pcollreq extension)
+//   anything else   the blocking call replayed from the stored arguments
+// The replay also covers scatters whose counts do not fit in an int where
+// only the int persistent collectives exist (large_count_p2p then).
+//
+// A plan is bound to its buffers: the contents may change between starts,
+// the addresses may not. Every rank must start its plans in the same order.
+//
+// COMM_PLAN=persistent (default) uses the best backend; COMM_PLAN=replay
+// forces the replay for comparison.
+
+enum { COMM_PLAN_SCATTERV, COMM_PLAN_REDUCE };
+
+typedef struct {
+    int collective;
+    int persistent;  // request holds a persistent collective
+    MPI_Request request;
+    // Arguments of the replayed call
+    const void* sendbuf;
+    void* recvbuf;
+    const long long* counts;
+    const long long* displs;
+    int* int_counts;  // int copies for MPI_Scatterv, NULL when they do not fit
+    int* int_displs;
+    long long count;  // recvcount of the scatter, count of the reduction
+    MPI_Datatype type;
+    MPI_Op op;
+    int root;
+    MPI_Comm comm;
+} CommPlan;
+
+// 1 unless COMM_PLAN=replay
+static inline int comm_plan_persistent_from_env(void) {
+    char* mode = getenv("COMM_PLAN");
+    return !(mode && strcmp(mode, "replay") == 0);
+}
+
+// Name of the backend the plans use
+static inline const char* comm_plan_backend(int persistent) {
+    if (!persistent) return "replayed blocking calls";
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+    return "MPI 4 persistent collectives";
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ)
+    return "MPIX persistent collectives (Open MPI)";
+#else
+    return "replayed blocking calls (no persistent collectives)";
+#endif
+}
+
+// MPI_Scatterv with 64-bit counts and displacements (same type on both
+// sides); counts and displs must stay valid for the life of the plan
+static inline int comm_plan_scatterv(CommPlan* plan, const void* sendbuf, const long long* counts,
+                                     const long long* displs, MPI_Datatype type, void* recvbuf,
+                                     long long recvcount, int root, MPI_Comm comm, int persistent) {
+    int num_procs, rc = MPI_SUCCESS;
+    MPI_Comm_size(comm, &num_procs);
+    memset(plan, 0, sizeof(*plan));
+    plan->collective = COMM_PLAN_SCATTERV;
+    plan->request = MPI_REQUEST_NULL;
+    plan->sendbuf = sendbuf;
+    plan->recvbuf = recvbuf;
+    plan->counts = counts;
+    plan->displs = displs;
+    plan->count = recvcount;
+    plan->type = type;
+    plan->root = root;
+    plan->comm = comm;
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+    if (persistent) {
+        MPI_Count* c_counts = (MPI_Count*)malloc((size_t)num_procs * sizeof(MPI_Count));
+        MPI_Aint* c_displs = (MPI_Aint*)malloc((size_t)num_procs * sizeof(MPI_Aint));
+        if (!c_counts || !c_displs) {
+            free(c_counts);
+            free(c_displs);
+            return MPI_ERR_NO_MEM;
+        }
+        for (int r = 0; r < num_procs; r++) {
+            c_counts[r] = (MPI_Count)counts[r];
+            c_displs[r] = (MPI_Aint)displs[r];
+        }
+        // The library copies the arrays it needs at initialization
+        rc = MPI_Scatterv_init_c(sendbuf, c_counts, c_displs, type, recvbuf, (MPI_Count)recvcount, type, root,
+                                 comm, MPI_INFO_NULL, &plan->request);
+        free(c_counts);
+        free(c_displs);
+        plan->persistent = rc == MPI_SUCCESS;
+        return rc;
+    }
+#endif
+    // counts and displs are the same on every rank, so all take the same path
+    if (large_count_fits_int(counts, displs, num_procs)) {
+        rc = large_count_to_int(counts, displs, num_procs, &plan->int_counts, &plan->int_displs);
+        if (rc != MPI_SUCCESS) return rc;
+#if !(defined(MPI_VERSION) && MPI_VERSION >= 4) && defined(OMPI_HAVE_MPI_EXT_PCOLLREQ)
+        if (persistent) {
+            // int_counts and int_displs stay alive with the plan
+            rc = MPIX_Scatterv_init(sendbuf, plan->int_counts, plan->int_displs, type, recvbuf, (int)recvcount,
+                                    type, root, comm, MPI_INFO_NULL, &plan->request);
+            plan->persistent = rc == MPI_SUCCESS;
+        }
+#endif
+    }
+    return rc;
+}
+
+// MPI_Reduce of `count` elements (an int count: reductions here are scalars
+// or small structs)
+static inline int comm_plan_reduce(CommPlan* plan, const void* sendbuf, void* recvbuf, int count,
+                                   MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm, int persistent) {
+    int rc = MPI_SUCCESS;
+    memset(plan, 0, sizeof(*plan));
+    plan->collective = COMM_PLAN_REDUCE;
+    plan->request = MPI_REQUEST_NULL;
+    plan->sendbuf = sendbuf;
+    plan->recvbuf = recvbuf;
+    plan->count = count;
+    plan->type = type;
+    plan->op = op;
+    plan->root = root;
+    plan->comm = comm;
+    if (persistent) {
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+        rc = MPI_Reduce_init(sendbuf, recvbuf, count, type, op, root, comm, MPI_INFO_NULL, &plan->request);
+        plan->persistent = rc == MPI_SUCCESS;
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ)
+        rc = MPIX_Reduce_init(sendbuf, recvbuf, count, type, op, root, comm, MPI_INFO_NULL, &plan->request);
+        plan->persistent = rc == MPI_SUCCESS;
+#endif
+    }
+    return rc;
+}
+
+// Starts one run of the plan; a replayed plan completes here
+static inline int comm_plan_start(CommPlan* plan) {
+    if (plan->persistent) return MPI_Start(&plan->request);
+    if (plan->collective == COMM_PLAN_REDUCE) {
+        return MPI_Reduce(plan->sendbuf, plan->recvbuf, (int)plan->count, plan->type, plan->op, plan->root,
+                          plan->comm);
+    }
+    if (plan->int_counts) {
+        return MPI_Scatterv(plan->sendbuf, plan->int_counts, plan->int_displs, plan->type, plan->recvbuf,
+                            (int)plan->count, plan->type, plan->root, plan->comm);
+    }
+    return large_scatterv(plan->sendbuf, plan->counts, plan->displs, plan->type, plan->recvbuf, plan->count,
+                          plan->root, plan->comm);
+}
+
+static inline int comm_plan_wait(CommPlan* plan) {
+    return plan->persistent ? MPI_Wait(&plan->request, MPI_STATUS_IGNORE) : MPI_SUCCESS;
+}
+
+// Start and wait: one blocking run
+static inline int comm_plan_run(CommPlan* plan) {
+    int rc = comm_plan_start(plan);
+    return rc == MPI_SUCCESS ? comm_plan_wait(plan) : rc;
+}
+
+// Starts several plans at once and waits for all of them, so independent
+// transfers (the scatters of a and b) are in flight together
+static inline int comm_plan_run_all(CommPlan* plans, int n) {
+    int rc = MPI_SUCCESS;
+    for (int k = 0; k < n && rc == MPI_SUCCESS; k++) rc = comm_plan_start(&plans[k]);
+    for (int k = 0; k < n; k++) {
+        int wait_rc = comm_plan_wait(&plans[k]);
+        if (rc == MPI_SUCCESS) rc = wait_rc;
+    }
+    return rc;
+}
+
+static inline void comm_plan_free(CommPlan* plan) {
+    if (plan->persistent) MPI_Request_free(&plan->request);
+    free(plan->int_counts);  // owns int_displs too
+    plan->int_counts = plan->int_displs = NULL;
+    plan->persistent = 0;
+}
+
+#endif
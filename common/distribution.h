@@ -0,0 +1,117 @@
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+// Distribution layer for MPI_Scatterv/MPI_Gatherv (64-bit counts, see
+// large_count.h): any array size, split
+// evenly (the first total % P ranks get one extra element) or in proportion
+// to per-rank weights, e.g. the throughput each rank measured for the kernel
+// in a short calibration run, so that slower nodes get smaller slices and
+// every rank finishes at about the same time.
+
+typedef struct {
+    int num_procs;
+    long long* counts;      // elements per rank
+    long long* displs;      // offset of each rank's slice in the full array
+    long long local_count;  // this rank's share
+    long long local_first;
+    long long max_count;
+    int weighted;
+} Distribution;
+
+// Splits `total` elements across the ranks of `comm`; weights[r] >= 0 on
+// every rank, or NULL for an even split.
+static inline int distribution_init(Distribution* d, long long total, const double* weights, MPI_Comm comm) {
+    int rank;
+    double weight_sum = 0.0;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &d->num_procs);
+    d->counts = (long long*)malloc(d->num_procs * sizeof(long long));
+    d->displs = (long long*)malloc(d->num_procs * sizeof(long long));
+    if (!d->counts || !d->displs) return -1;
+
+    if (weights) {
+        for (int r = 0; r < d->num_procs; r++) weight_sum += weights[r] > 0 ? weights[r] : 0;
+    }
+    d->weighted = weight_sum > 0;
+
+    if (!d->weighted) {
+        for (int r = 0; r < d->num_procs; r++) {
+            d->counts[r] = total / d->num_procs + (r < total % d->num_procs ? 1 : 0);
+        }
+    } else {
+        // Largest remainder rounding keeps the counts summing to `total`
+        double* remainder = (double*)malloc(d->num_procs * sizeof(double));
+        long long assigned = 0;
+        if (!remainder) return -1;
+        for (int r = 0; r < d->num_procs; r++) {
+            double share = weights[r] > 0 ? (double)total * weights[r] / weight_sum : 0.0;
+            d->counts[r] = (long long)share;
+            remainder[r] = share - d->counts[r];
+            assigned += d->counts[r];
+        }
+        for (; assigned < total; assigned++) {
+            int best = 0;
+            for (int r = 1; r < d->num_procs; r++) {
+                if (remainder[r] > remainder[best]) best = r;
+            }
+            d->counts[best]++;
+            remainder[best] = -1.0;
+        }
+        free(remainder);
+    }
+
+    d->max_count = 0;
+    long long offset = 0;
+    for (int r = 0; r < d->num_procs; r++) {
+        d->displs[r] = offset;
+        offset += d->counts[r];
+        if (d->counts[r] > d->max_count) d->max_count = d->counts[r];
+    }
+    d->local_count = d->counts[rank];
+    d->local_first = d->displs[rank];
+    return 0;
+}
+
+// Weighted split from this rank's own weight (gathered from all ranks).
+static inline int distribution_init_weighted(Distribution* d, long long total, double my_weight, MPI_Comm comm) {
+    int num_procs;
+    MPI_Comm_size(comm, &num_procs);
+    double* weights = (double*)malloc(num_procs * sizeof(double));
+    if (!weights) return -1;
+    MPI_Allgather(&my_weight, 1, MPI_DOUBLE, weights, 1, MPI_DOUBLE, comm);
+    int rc = distribution_init(d, total, weights, comm);
+    free(weights);
+    return rc;
+}
+
+static inline void distribution_free(Distribution* d) {
+    free(d->counts);
+    free(d->displs);
+}
+
+// BALANCE=calibrate asks for throughput-weighted slices
+static inline int distribution_calibrate_requested(void) {
+    const char* balance = getenv("BALANCE");
+    return balance && strcmp(balance, "calibrate") == 0;
+}
+
+// Throughput (elements/s) of `kernel` on `n` elements: best of `reps` runs
+// after one untimed warm-up.
+static inline double distribution_calibrate(void (*kernel)(size_t n, void* ctx), void* ctx,
+                                            size_t n, int reps) {
+    double best = 0.0;
+    kernel(n, ctx);
+    for (int rep = 0; rep < reps; rep++) {
+        double start = MPI_Wtime();
+        kernel(n, ctx);
+        double elapsed = MPI_Wtime() - start;
+        if (rep == 0 || elapsed < best) best = elapsed;
+    }
+    return best > 0 ? (double)n / best : 0.0;
+}
+
+#endif
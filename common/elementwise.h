@@ -0,0 +1,159 @@
+#ifndef ELEMENTWISE_H
+#define ELEMENTWISE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ELEMENTWISE_X86 1
+#endif
+
+#include "threads.h"
+#include "fast_div.h"
+
+// Fused elementwise engine: add, sub, mul and div of a and b in a single
+// streaming pass. Inputs are read once instead of four times, and the
+// outputs go out with non-temporal stores, so they neither evict the inputs
+// from cache nor pay a read-for-ownership before every written line.
+// Division returns 0 where b is 0 (masked, no branch).
+
+static inline void ew_fused_scalar(const double* a, const double* b, double* add, double* sub,
+                                   double* mul, double* div, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double x = a[i], y = b[i];
+        add[i] = x + y;
+        sub[i] = x - y;
+        mul[i] = x * y;
+        div[i] = y != 0 ? x / y : 0;
+    }
+}
+
+// One operation as its own pass over a and b: the unfused path of
+// Task 3.c and task3(super), timed operation by operation. Plain loops the
+// compiler vectorizes; division is masked like ew_fused and goes through
+// the kernels of fast_div.h, EW_DIV_FAST through the reciprocal.
+typedef enum { EW_ADD, EW_SUB, EW_MUL, EW_DIV, EW_DIV_FAST } EwOp;
+
+static inline void ew_op(EwOp op, const double* a, const double* b, double* out, size_t n, int threads) {
+    long long size = (long long)n;
+    switch (op) {
+    case EW_ADD:
+#pragma omp parallel for num_threads(threads) if (threads > 1) schedule(static)
+        for (long long i = 0; i < size; i++) out[i] = a[i] + b[i];
+        break;
+    case EW_SUB:
+#pragma omp parallel for num_threads(threads) if (threads > 1) schedule(static)
+        for (long long i = 0; i < size; i++) out[i] = a[i] - b[i];
+        break;
+    case EW_MUL:
+#pragma omp parallel for num_threads(threads) if (threads > 1) schedule(static)
+        for (long long i = 0; i < size; i++) out[i] = a[i] * b[i];
+        break;
+    case EW_DIV:
+    case EW_DIV_FAST: {
+        DivFn div = div_kernel(op == EW_DIV_FAST)->fn;  // resolved before the region
+#pragma omp parallel num_threads(threads) if (threads > 1)
+        {
+            size_t begin, end;
+            thread_range(n, &begin, &end);
+            div(a + begin, b + begin, out + begin, end - begin);
+        }
+        break;
+    }
+    }
+}
+
+#ifdef ELEMENTWISE_X86
+
+static inline int ew_aligned(const void* p, uintptr_t alignment) {
+    return ((uintptr_t)p & (alignment - 1)) == 0;
+}
+
+__attribute__((target("sse2")))
+static inline void ew_fused_sse2(const double* a, const double* b, double* add, double* sub,
+                                 double* mul, double* div, size_t n) {
+    const __m128d zero = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i), y = _mm_loadu_pd(b + i);
+        __m128d nonzero = _mm_cmpneq_pd(y, zero);
+        _mm_stream_pd(add + i, _mm_add_pd(x, y));
+        _mm_stream_pd(sub + i, _mm_sub_pd(x, y));
+        _mm_stream_pd(mul + i, _mm_mul_pd(x, y));
+        _mm_stream_pd(div + i, _mm_and_pd(_mm_div_pd(x, y), nonzero));
+    }
+    _mm_sfence();
+    ew_fused_scalar(a + i, b + i, add + i, sub + i, mul + i, div + i, n - i);
+}
+
+__attribute__((target("avx")))
+static inline void ew_fused_avx(const double* a, const double* b, double* add, double* sub,
+                                double* mul, double* div, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i), y = _mm256_loadu_pd(b + i);
+        __m256d nonzero = _mm256_cmp_pd(y, zero, _CMP_NEQ_UQ);
+        _mm256_stream_pd(add + i, _mm256_add_pd(x, y));
+        _mm256_stream_pd(sub + i, _mm256_sub_pd(x, y));
+        _mm256_stream_pd(mul + i, _mm256_mul_pd(x, y));
+        _mm256_stream_pd(div + i, _mm256_and_pd(_mm256_div_pd(x, y), nonzero));
+    }
+    _mm_sfence();
+    ew_fused_scalar(a + i, b + i, add + i, sub + i, mul + i, div + i, n - i);
+}
+
+#endif
+
+// Streaming stores need aligned outputs: peel scalar elements until `add`
+// is aligned and use the widest path for which all four outputs then are.
+static inline void ew_fused(const double* a, const double* b, double* add, double* sub,
+                            double* mul, double* div, size_t n) {
+#ifdef ELEMENTWISE_X86
+    static int has_avx = -1;
+    if (has_avx < 0) has_avx = __builtin_cpu_supports("avx") ? 1 : 0;
+    for (uintptr_t alignment = has_avx ? 32 : 16; alignment >= 16; alignment /= 2) {
+        size_t peel = 0;
+        while (peel < n && !ew_aligned(add + peel, alignment)) peel++;
+        if (!ew_aligned(add + peel, alignment) || !ew_aligned(sub + peel, alignment) ||
+            !ew_aligned(mul + peel, alignment) || !ew_aligned(div + peel, alignment)) {
+            continue;
+        }
+        ew_fused_scalar(a, b, add, sub, mul, div, peel);
+        a += peel; b += peel; add += peel; sub += peel; mul += peel; div += peel;
+        if (alignment == 32) {
+            ew_fused_avx(a, b, add, sub, mul, div, n - peel);
+        } else {
+            ew_fused_sse2(a, b, add, sub, mul, div, n - peel);
+        }
+        return;
+    }
+#endif
+    ew_fused_scalar(a, b, add, sub, mul, div, n);
+}
+
+static inline void ew_fused_threaded(const double* a, const double* b, double* add, double* sub,
+                                     double* mul, double* div, size_t n, int threads) {
+    if (threads <= 1) {
+        ew_fused(a, b, add, sub, mul, div, n);
+        return;
+    }
+    ew_fused(a, b, add, sub, mul, div, 0);  // resolve the dispatch before the region
+#pragma omp parallel num_threads(threads)
+    {
+        size_t begin, end;
+        thread_range(n, &begin, &end);
+        ew_fused(a + begin, b + begin, add + begin, sub + begin, mul + begin, div + begin, end - begin);
+    }
+}
+
+// DRAM bytes moved per iteration for n elements. Four separate passes read
+// a and b four times and each ordinary store also reads its line first
+// (write-allocate): 4 x (16 + 8 + 8) bytes per element. The fused pass with
+// streaming stores reads a and b once and writes four outputs: 16 + 32.
+static inline double ew_traffic_bytes(size_t n, int fused) {
+    return (double)n * (fused ? 48.0 : 128.0);
+}
+
+#endif
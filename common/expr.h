@@ -0,0 +1,314 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads.h"
+
+// Elementwise expression engine: a small runtime-compiled DSL for fused
+// array expressions such as "(a+b)*c/d" or "sqrt(a*a+b*b)-min(c,2)".
+//
+// expr_compile() parses the text into postfix bytecode for a stack machine
+// whose registers are tiles of EXPR_TILE doubles. expr_eval() walks the
+// arrays tile by tile and runs the whole program on each tile: every
+// instruction is one simple vectorizable loop over a tile that stays in L1,
+// the inputs are read in place and the last instruction writes straight
+// into the output. One pass over memory per expression, and no full-size
+// temporaries, whatever the number of operations.
+//
+// Grammar: numbers, inputs a..h (a is input 0), + - * /, unary minus,
+// parentheses and the functions sqrt(x), abs(x), min(x, y), max(x, y).
+
+#define EXPR_MAX_INPUTS 8
+#define EXPR_MAX_CODE 256
+#define EXPR_MAX_STACK 8
+#define EXPR_TILE 512  // doubles per register, 4 kB
+
+typedef enum {
+    EXPR_INPUT, EXPR_CONST, EXPR_NEG, EXPR_SQRT, EXPR_ABS,
+    EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV, EXPR_MIN, EXPR_MAX
+} ExprOpcode;
+
+typedef struct {
+    int op;
+    int input;     // EXPR_INPUT
+    double value;  // EXPR_CONST
+} ExprInstr;
+
+typedef struct {
+    ExprInstr code[EXPR_MAX_CODE];
+    int length;
+    int depth;       // stack registers the program needs
+    int num_inputs;  // highest input used + 1
+    char error[96];
+} Expr;
+
+typedef struct {
+    Expr* e;
+    const char* text;
+    const char* pos;
+    int sp;
+} ExprParser;
+
+static inline int expr_fail(ExprParser* p, const char* what) {
+    if (!p->e->error[0]) {
+        snprintf(p->e->error, sizeof(p->e->error), "%s at offset %d", what, (int)(p->pos - p->text));
+    }
+    return -1;
+}
+
+// Appends one instruction and tracks the stack depth (+1 for a push, -1
+// for a binary operation)
+static inline int expr_emit(ExprParser* p, int op, int input, double value, int push) {
+    Expr* e = p->e;
+    if (e->length == EXPR_MAX_CODE) return expr_fail(p, "Expression too long");
+    e->code[e->length++] = (ExprInstr){op, input, value};
+    p->sp += push;
+    if (p->sp > EXPR_MAX_STACK) return expr_fail(p, "Expression nested too deeply");
+    if (p->sp > e->depth) e->depth = p->sp;
+    return 0;
+}
+
+static inline void expr_skip(ExprParser* p) {
+    while (isspace((unsigned char)*p->pos)) p->pos++;
+}
+
+static inline int expr_parse_sum(ExprParser* p);
+
+static inline int expr_parse_primary(ExprParser* p) {
+    expr_skip(p);
+    const char* start = p->pos;
+    if (*p->pos == '(') {
+        p->pos++;
+        if (expr_parse_sum(p) != 0) return -1;
+        expr_skip(p);
+        if (*p->pos != ')') return expr_fail(p, "Expected ')'");
+        p->pos++;
+        return 0;
+    }
+    if (isdigit((unsigned char)*p->pos) || *p->pos == '.') {
+        char* end;
+        double value = strtod(p->pos, &end);
+        p->pos = end;
+        return expr_emit(p, EXPR_CONST, 0, value, 1);
+    }
+    if (!isalpha((unsigned char)*p->pos)) return expr_fail(p, "Expected a number, input or '('");
+    while (isalnum((unsigned char)*p->pos)) p->pos++;
+    size_t len = (size_t)(p->pos - start);
+    if (len == 1) {
+        int input = *start - 'a';
+        if (input < 0 || input >= EXPR_MAX_INPUTS) {
+            p->pos = start;
+            return expr_fail(p, "Inputs are a..h");
+        }
+        if (input + 1 > p->e->num_inputs) p->e->num_inputs = input + 1;
+        return expr_emit(p, EXPR_INPUT, input, 0.0, 1);
+    }
+    static const struct { const char* name; int op; int args; } functions[] = {
+        {"sqrt", EXPR_SQRT, 1}, {"abs", EXPR_ABS, 1}, {"min", EXPR_MIN, 2}, {"max", EXPR_MAX, 2}};
+    for (size_t f = 0; f < sizeof(functions) / sizeof(functions[0]); f++) {
+        if (strlen(functions[f].name) != len || strncmp(functions[f].name, start, len) != 0) continue;
+        expr_skip(p);
+        if (*p->pos != '(') return expr_fail(p, "Expected '(' after function name");
+        p->pos++;
+        for (int arg = 0; arg < functions[f].args; arg++) {
+            if (arg > 0) {
+                expr_skip(p);
+                if (*p->pos != ',') return expr_fail(p, "Expected ','");
+                p->pos++;
+            }
+            if (expr_parse_sum(p) != 0) return -1;
+        }
+        expr_skip(p);
+        if (*p->pos != ')') return expr_fail(p, "Expected ')'");
+        p->pos++;
+        return expr_emit(p, functions[f].op, 0, 0.0, 1 - functions[f].args);
+    }
+    p->pos = start;
+    return expr_fail(p, "Unknown name");
+}
+
+static inline int expr_parse_unary(ExprParser* p) {
+    expr_skip(p);
+    if (*p->pos == '-') {
+        p->pos++;
+        if (expr_parse_unary(p) != 0) return -1;
+        return expr_emit(p, EXPR_NEG, 0, 0.0, 0);
+    }
+    if (*p->pos == '+') p->pos++;
+    return expr_parse_primary(p);
+}
+
+static inline int expr_parse_product(ExprParser* p) {
+    if (expr_parse_unary(p) != 0) return -1;
+    for (;;) {
+        expr_skip(p);
+        char c = *p->pos;
+        if (c != '*' && c != '/') return 0;
+        p->pos++;
+        if (expr_parse_unary(p) != 0) return -1;
+        if (expr_emit(p, c == '*' ? EXPR_MUL : EXPR_DIV, 0, 0.0, -1) != 0) return -1;
+    }
+}
+
+static inline int expr_parse_sum(ExprParser* p) {
+    if (expr_parse_product(p) != 0) return -1;
+    for (;;) {
+        expr_skip(p);
+        char c = *p->pos;
+        if (c != '+' && c != '-') return 0;
+        p->pos++;
+        if (expr_parse_product(p) != 0) return -1;
+        if (expr_emit(p, c == '+' ? EXPR_ADD : EXPR_SUB, 0, 0.0, -1) != 0) return -1;
+    }
+}
+
+// 0 on success; -1 with a message in e->error
+static inline int expr_compile(Expr* e, const char* text) {
+    ExprParser p = {e, text, text, 0};
+    memset(e, 0, sizeof(*e));
+    if (expr_parse_sum(&p) != 0) return -1;
+    expr_skip(&p);
+    if (*p.pos != '\0') return expr_fail(&p, "Unexpected character");
+    return 0;
+}
+
+// Bytes one evaluation over n elements moves: every input read once and
+// the output written once
+static inline double expr_traffic_bytes(const Expr* e, size_t n) {
+    return (double)(e->num_inputs + 1) * sizeof(double) * (double)n;
+}
+
+// The same expression built from one full-array pass per operation: every
+// operation reads its operands and writes a full-size temporary
+static inline double expr_unfused_traffic_bytes(const Expr* e, size_t n) {
+    double passes = 0.0;
+    for (int k = 0; k < e->length; k++) {
+        int op = e->code[k].op;
+        if (op == EXPR_INPUT || op == EXPR_CONST) continue;
+        passes += op == EXPR_NEG || op == EXPR_SQRT || op == EXPR_ABS ? 2.0 : 3.0;
+    }
+    return passes * sizeof(double) * (double)n;
+}
+
+// One tile of `len` elements. A register is a pointer to its values (an
+// input tile, read in place, or a scratch tile) or a constant.
+static inline void expr_eval_tile(const Expr* e, const double* const* inputs, size_t offset, double* out,
+                                  size_t len, double (*scratch)[EXPR_TILE]) {
+    const double* reg[EXPR_MAX_STACK];
+    double value[EXPR_MAX_STACK];
+    int is_const[EXPR_MAX_STACK];
+    int sp = 0;
+    for (int k = 0; k < e->length; k++) {
+        const ExprInstr* in = &e->code[k];
+        if (in->op == EXPR_INPUT) {
+            reg[sp] = inputs[in->input] + offset;
+            is_const[sp++] = 0;
+            continue;
+        }
+        if (in->op == EXPR_CONST) {
+            value[sp] = in->value;
+            is_const[sp++] = 1;
+            continue;
+        }
+        int unary = in->op == EXPR_NEG || in->op == EXPR_SQRT || in->op == EXPR_ABS;
+        int dst = unary ? sp - 1 : sp - 2;
+        double* d = k == e->length - 1 ? out : scratch[dst];  // the last one writes the result
+        if (unary) {
+            if (is_const[dst]) {
+                double x = value[dst];
+                value[dst] = in->op == EXPR_NEG ? -x : in->op == EXPR_SQRT ? sqrt(x) : fabs(x);
+                continue;
+            }
+            const double* x = reg[dst];
+            if (in->op == EXPR_NEG) {
+#pragma omp simd
+                for (size_t i = 0; i < len; i++) d[i] = -x[i];
+            } else if (in->op == EXPR_SQRT) {
+#pragma omp simd
+                for (size_t i = 0; i < len; i++) d[i] = sqrt(x[i]);
+            } else {
+#pragma omp simd
+                for (size_t i = 0; i < len; i++) d[i] = fabs(x[i]);
+            }
+            reg[dst] = d;
+            continue;
+        }
+        sp--;
+        const double* x = reg[dst], * y = reg[dst + 1];
+        double vx = value[dst], vy = value[dst + 1];
+        int cx = is_const[dst], cy = is_const[dst + 1];
+        if (cx && cy) {
+            value[dst] = in->op == EXPR_ADD ? vx + vy : in->op == EXPR_SUB ? vx - vy : in->op == EXPR_MUL ? vx * vy
+                       : in->op == EXPR_DIV ? vx / vy : in->op == EXPR_MIN ? fmin(vx, vy) : fmax(vx, vy);
+            continue;
+        }
+        // Tile-by-tile, tile-by-scalar and scalar-by-tile loops of one operator
+#define EXPR_BINARY_LOOPS(combine)                                       \
+        if (cy) {                                                        \
+            _Pragma("omp simd")                                          \
+            for (size_t i = 0; i < len; i++) d[i] = combine(x[i], vy);   \
+        } else if (cx) {                                                 \
+            _Pragma("omp simd")                                          \
+            for (size_t i = 0; i < len; i++) d[i] = combine(vx, y[i]);   \
+        } else {                                                         \
+            _Pragma("omp simd")                                          \
+            for (size_t i = 0; i < len; i++) d[i] = combine(x[i], y[i]); \
+        }
+#define EXPR_ADD_OP(u, v) ((u) + (v))
+#define EXPR_SUB_OP(u, v) ((u) - (v))
+#define EXPR_MUL_OP(u, v) ((u) * (v))
+#define EXPR_DIV_OP(u, v) ((u) / (v))
+#define EXPR_MIN_OP(u, v) ((v) < (u) ? (v) : (u))
+#define EXPR_MAX_OP(u, v) ((v) > (u) ? (v) : (u))
+        switch (in->op) {
+        case EXPR_ADD: EXPR_BINARY_LOOPS(EXPR_ADD_OP) break;
+        case EXPR_SUB: EXPR_BINARY_LOOPS(EXPR_SUB_OP) break;
+        case EXPR_MUL: EXPR_BINARY_LOOPS(EXPR_MUL_OP) break;
+        case EXPR_DIV: EXPR_BINARY_LOOPS(EXPR_DIV_OP) break;
+        case EXPR_MIN: EXPR_BINARY_LOOPS(EXPR_MIN_OP) break;
+        default: EXPR_BINARY_LOOPS(EXPR_MAX_OP) break;
+        }
+#undef EXPR_BINARY_LOOPS
+        reg[dst] = d;
+        is_const[dst] = 0;
+    }
+    // A program that is a single input or constant still has to write out
+    if (e->length == 1 || (sp == 1 && is_const[0])) {
+        for (size_t i = 0; i < len; i++) out[i] = is_const[0] ? value[0] : reg[0][i];
+    } else if (reg[0] != out) {
+        memcpy(out, reg[0], len * sizeof(double));
+    }
+}
+
+// out[i] = e(inputs[0][i], inputs[1][i], ...) for i in [0, n)
+static inline void expr_eval(const Expr* e, const double* const* inputs, double* out, size_t n) {
+    double scratch[EXPR_MAX_STACK][EXPR_TILE];
+    for (size_t offset = 0; offset < n; offset += EXPR_TILE) {
+        size_t len = n - offset < EXPR_TILE ? n - offset : EXPR_TILE;
+        expr_eval_tile(e, inputs, offset, out + offset, len, scratch);
+    }
+}
+
+// Split across `threads` OpenMP threads like the other kernels
+static inline void expr_eval_threaded(const Expr* e, const double* const* inputs, double* out, size_t n,
+                                      int threads) {
+    if (threads <= 1) {
+        expr_eval(e, inputs, out, n);
+        return;
+    }
+#pragma omp parallel num_threads(threads)
+    {
+        size_t begin, end;
+        const double* shifted[EXPR_MAX_INPUTS];
+        thread_range(n, &begin, &end);
+        for (int k = 0; k < e->num_inputs; k++) shifted[k] = inputs[k] + begin;
+        expr_eval(e, shifted, out + begin, end - begin);
+    }
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef FAST_DIV_H
+#define FAST_DIV_H
+
+#include <float.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FAST_DIV_X86 1
+#endif
+
+// Masked division out[i] = b[i] != 0 ? a[i] / b[i] : 0 without a branch.
+// The exact kernels divide every lane and clear the lanes of zero divisors
+// (AVX-512 skips them with a zero-masked divide), so the result is the
+// correctly rounded quotient. The fast kernels (DIV_MODE=fast) replace the
+// divide by a reciprocal estimate (RCPPS, 12 bits, or VRCP14PD, 14 bits),
+// Newton-Raphson steps r' = r + r(1 - br) up to 45 or 28 bits, and one
+// Newton correction of the quotient q' = q + r(a - bq) with the residual
+// taken exactly by FMA. That is within DIV_FAST_MAX_ULP of the exact
+// quotient for normal results and divisors of magnitude in
+// [DIV_FAST_MIN, DIV_FAST_MAX]; vectors with any other divisor (zero,
+// tiny, huge, inf, NaN) or a non-finite quotient take the exact path.
+//
+// Environment:
+//   DIV_MODE    exact (default) or fast, read by the programs
+//   DIV_KERNEL  forces the variant: scalar, avx2 or avx512
+
+#define DIV_FAST_MAX_ULP 1
+#define DIV_FAST_MIN 0x1p-125
+#define DIV_FAST_MAX 0x1p125
+
+typedef void (*DivFn)(const double* a, const double* b, double* out, size_t n);
+
+// The division is unconditional and only the result is selected, so the
+// compiler if-converts the loop and vectorizes it; a branch around the
+// divide would not, as the divide could trap.
+static inline void div_exact_scalar(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double q = a[i] / b[i];
+        out[i] = b[i] != 0 ? q : 0;
+    }
+}
+
+#ifdef FAST_DIV_X86
+
+__attribute__((target("avx2")))
+static inline void div_exact_avx2(const double* a, const double* b, double* out, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i), y = _mm256_loadu_pd(b + i);
+        __m256d nonzero = _mm256_cmp_pd(y, zero, _CMP_NEQ_UQ);
+        _mm256_storeu_pd(out + i, _mm256_and_pd(_mm256_div_pd(x, y), nonzero));
+    }
+    div_exact_scalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static inline void div_fast_avx2(const double* a, const double* b, double* out, size_t n) {
+    const __m256d one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd();
+    const __m256d lo = _mm256_set1_pd(DIV_FAST_MIN), hi = _mm256_set1_pd(DIV_FAST_MAX);
+    const __m256d max = _mm256_set1_pd(DBL_MAX);
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i), y = _mm256_loadu_pd(b + i);
+        __m256d r = _mm256_cvtps_pd(_mm_rcp_ps(_mm256_cvtpd_ps(y)));
+        r = _mm256_fmadd_pd(r, _mm256_fnmadd_pd(y, r, one), r);
+        r = _mm256_fmadd_pd(r, _mm256_fnmadd_pd(y, r, one), r);
+        __m256d q = _mm256_mul_pd(x, r);
+        q = _mm256_fmadd_pd(r, _mm256_fnmadd_pd(y, q, x), q);
+        __m256d ay = _mm256_and_pd(y, abs_mask);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(ay, lo, _CMP_GE_OQ), _mm256_cmp_pd(ay, hi, _CMP_LE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(_mm256_and_pd(q, abs_mask), max, _CMP_LE_OQ));
+        if (_mm256_movemask_pd(ok) != 0xF) {
+            q = _mm256_and_pd(_mm256_div_pd(x, y), _mm256_cmp_pd(y, zero, _CMP_NEQ_UQ));
+        }
+        _mm256_storeu_pd(out + i, q);
+    }
+    div_exact_scalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static inline void div_exact_avx512(const double* a, const double* b, double* out, size_t n) {
+    const __m512d zero = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d x = _mm512_loadu_pd(a + i), y = _mm512_loadu_pd(b + i);
+        __mmask8 nonzero = _mm512_cmp_pd_mask(y, zero, _CMP_NEQ_UQ);
+        _mm512_storeu_pd(out + i, _mm512_maskz_div_pd(nonzero, x, y));
+    }
+    div_exact_scalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static inline void div_fast_avx512(const double* a, const double* b, double* out, size_t n) {
+    const __m512d one = _mm512_set1_pd(1.0), zero = _mm512_setzero_pd();
+    const __m512d lo = _mm512_set1_pd(DIV_FAST_MIN), hi = _mm512_set1_pd(DIV_FAST_MAX);
+    const __m512d max = _mm512_set1_pd(DBL_MAX);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d x = _mm512_loadu_pd(a + i), y = _mm512_loadu_pd(b + i);
+        __m512d r = _mm512_rcp14_pd(y);
+        r = _mm512_fmadd_pd(r, _mm512_fnmadd_pd(y, r, one), r);
+        __m512d q = _mm512_mul_pd(x, r);
+        q = _mm512_fmadd_pd(r, _mm512_fnmadd_pd(y, q, x), q);
+        __m512d ay = _mm512_abs_pd(y);
+        __mmask8 ok = _mm512_cmp_pd_mask(ay, lo, _CMP_GE_OQ) & _mm512_cmp_pd_mask(ay, hi, _CMP_LE_OQ) &
+                      _mm512_cmp_pd_mask(_mm512_abs_pd(q), max, _CMP_LE_OQ);
+        if (ok != 0xFF) q = _mm512_maskz_div_pd(_mm512_cmp_pd_mask(y, zero, _CMP_NEQ_UQ), x, y);
+        _mm512_storeu_pd(out + i, q);
+    }
+    div_exact_scalar(a + i, b + i, out + i, n - i);
+}
+
+#endif
+
+typedef struct {
+    const char* name;
+    DivFn fn;
+} DivKernel;
+
+// Widest variant of the exact or the fast kernel this CPU supports;
+// DIV_KERNEL forces one. Without AVX2 and FMA the fast mode is the exact
+// scalar kernel.
+static inline DivKernel div_kernel_select(int fast) {
+    DivKernel available[3] = {{"scalar", div_exact_scalar}};
+    int count = 1;
+#ifdef FAST_DIV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        available[count++] = (DivKernel){"avx2", fast ? div_fast_avx2 : div_exact_avx2};
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        available[count++] = (DivKernel){"avx512", fast ? div_fast_avx512 : div_exact_avx512};
+    }
+#endif
+    const char* forced = getenv("DIV_KERNEL");
+    for (int i = 0; forced && i < count; i++) {
+        if (strcmp(forced, available[i].name) == 0) return available[i];
+    }
+    return available[count - 1];
+}
+
+static inline const DivKernel* div_kernel(int fast) {
+    static DivKernel selected[2];
+    if (!selected[fast != 0].fn) selected[fast != 0] = div_kernel_select(fast);
+    return &selected[fast != 0];
+}
+
+// DIV_MODE: 0 for exact (default), 1 for fast, -1 when unknown
+static inline int div_mode_from_env(void) {
+    const char* str = getenv("DIV_MODE");
+    if (!str || strcmp(str, "exact") == 0) return 0;
+    return strcmp(str, "fast") == 0 ? 1 : -1;
+}
+
+#endif
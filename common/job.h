@@ -0,0 +1,197 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Job protocol of the resident server (server.c) and its client
+// (tools/job_client.c). One request per connection to a local Unix socket:
+// a single text line in, a single text line out.
+//
+//   sum   [size=N] [seed=S] [file=PATH | shm=NAME]
+//   stats [size=N] [seed=S] [file=PATH | shm=NAME]
+//   expr  [size=N] [seed=S] [shm=NAME] expr=TEXT
+//   ping
+//   shutdown
+//
+// Without file= or shm= every rank generates its own slice of Philox data,
+// the same values as DATA_GEN=local (seed 12345 unless given), of
+// JOB_DEFAULT_SIZE elements or the server's limit if that is smaller.
+// file= is an int32 array file (common/arrayfile.h) read slice by slice;
+// shm= is a POSIX shared-memory segment on the server's rank 0 node holding
+// `size` raw int32 elements, or for expr one float64 array of `size`
+// elements per input a, b, ... back to back. expr= takes the rest of the
+// line, so it comes last.
+//
+// Replies: "ok <key=value ...>" with the result and the server-side
+// seconds (total, distribute, compute, reduce), or "error <message>".
+
+#define JOB_DEFAULT_SOCKET "/tmp/pcs_lab3.sock"
+#define JOB_LINE_MAX 1024
+#define JOB_TEXT_MAX 256
+#define JOB_DEFAULT_SEED 12345
+#define JOB_DEFAULT_SIZE 10000000
+
+typedef enum { JOB_SUM, JOB_STATS, JOB_EXPR, JOB_PING, JOB_SHUTDOWN } JobOp;
+typedef enum { JOB_GENERATED, JOB_FILE, JOB_SHM } JobSource;
+
+static const char* job_op_names[] = {"sum", "stats", "expr", "ping", "shutdown"};
+
+// Broadcast to every rank as plain bytes
+typedef struct {
+    int op;
+    int source;
+    long long size;  // elements, 0 for the default (whole file)
+    unsigned int seed;
+    char path[JOB_TEXT_MAX];  // file path or segment name
+    char expr[JOB_TEXT_MAX];
+} Job;
+
+// SERVER_SOCKET, or the default path
+static inline const char* job_socket_path(void) {
+    const char* path = getenv("SERVER_SOCKET");
+    return path && *path ? path : JOB_DEFAULT_SOCKET;
+}
+
+// Copies `len` bytes of `value` into `out` (JOB_TEXT_MAX); -1 if too long
+static inline int job_copy_text(char* out, const char* value, size_t len) {
+    if (len == 0 || len >= JOB_TEXT_MAX) return -1;
+    memcpy(out, value, len);
+    out[len] = '\0';
+    return 0;
+}
+
+// 0 on success; -1 with a message in `error` (`error_size` bytes)
+static inline int job_parse(Job* job, const char* line, char* error, size_t error_size) {
+    const char* p = line;
+    memset(job, 0, sizeof(*job));
+    job->seed = JOB_DEFAULT_SEED;
+    while (isspace((unsigned char)*p)) p++;
+    size_t len = strcspn(p, " \t\r\n");
+    job->op = -1;
+    for (int op = 0; op <= JOB_SHUTDOWN; op++) {
+        if (strlen(job_op_names[op]) == len && strncmp(p, job_op_names[op], len) == 0) job->op = op;
+    }
+    if (job->op < 0) {
+        snprintf(error, error_size, "unknown operation '%.*s'", (int)len, p);
+        return -1;
+    }
+    p += len;
+    for (;;) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        if (strncmp(p, "expr=", 5) == 0) {
+            // The rest of the line, without the line break
+            size_t rest = strcspn(p + 5, "\r\n");
+            if (job_copy_text(job->expr, p + 5, rest) != 0) {
+                snprintf(error, error_size, "expr= is empty or longer than %d characters", JOB_TEXT_MAX - 1);
+                return -1;
+            }
+            break;
+        }
+        len = strcspn(p, " \t\r\n");
+        const char* eq = memchr(p, '=', len);
+        if (!eq) {
+            snprintf(error, error_size, "expected key=value, got '%.*s'", (int)len, p);
+            return -1;
+        }
+        const char* value = eq + 1;
+        size_t key_len = (size_t)(eq - p), value_len = len - key_len - 1;
+        char* end;
+        if (key_len == 4 && strncmp(p, "size", 4) == 0) {
+            job->size = strtoll(value, &end, 10);
+            if (end != value + value_len || job->size <= 0) {
+                snprintf(error, error_size, "invalid size");
+                return -1;
+            }
+        } else if (key_len == 4 && strncmp(p, "seed", 4) == 0) {
+            job->seed = (unsigned int)strtoul(value, &end, 10);
+            if (end != value + value_len) {
+                snprintf(error, error_size, "invalid seed");
+                return -1;
+            }
+        } else if ((key_len == 4 && strncmp(p, "file", 4) == 0) || (key_len == 3 && strncmp(p, "shm", 3) == 0)) {
+            if (job->source != JOB_GENERATED || job_copy_text(job->path, value, value_len) != 0) {
+                snprintf(error, error_size, "one file= or shm= of at most %d characters", JOB_TEXT_MAX - 1);
+                return -1;
+            }
+            job->source = key_len == 4 ? JOB_FILE : JOB_SHM;
+        } else {
+            snprintf(error, error_size, "unknown key '%.*s'", (int)key_len, p);
+            return -1;
+        }
+        p += len;
+    }
+    if (job->op == JOB_EXPR && !job->expr[0]) {
+        snprintf(error, error_size, "expr needs expr=TEXT");
+        return -1;
+    }
+    if (job->op == JOB_EXPR && job->source == JOB_FILE) {
+        snprintf(error, error_size, "expr reads generated data or shm=, not file=");
+        return -1;
+    }
+    if (job->source == JOB_SHM && (job->op == JOB_PING || job->op == JOB_SHUTDOWN)) job->source = JOB_GENERATED;
+    return 0;
+}
+
+// Reads one line (up to JOB_LINE_MAX - 1 bytes) from `fd`; -1 on error
+// (including a receive timeout, even mid-line) or an empty line at EOF
+static inline int job_read_line(int fd, char* line) {
+    size_t used = 0;
+    while (used < JOB_LINE_MAX - 1) {
+        ssize_t got = read(fd, line + used, 1);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) {
+            line[0] = '\0';
+            return -1;
+        }
+        if (got == 0) break;
+        if (line[used] == '\n') break;
+        used++;
+    }
+    line[used] = '\0';
+    return used > 0 ? 0 : -1;
+}
+
+// -1 when the peer is gone; MSG_NOSIGNAL keeps that from raising SIGPIPE,
+// which would kill the server
+static inline int job_write_all(int fd, const char* text, size_t len) {
+    while (len > 0) {
+        ssize_t put = send(fd, text, len, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return -1;
+        text += put;
+        len -= (size_t)put;
+    }
+    return 0;
+}
+
+static inline int job_socket_address(struct sockaddr_un* addr, const char* path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+// Client side: one request, one reply line; 0 on success
+static inline int job_request(const char* path, const char* request, char* reply) {
+    struct sockaddr_un addr;
+    if (job_socket_address(&addr, path) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int rc = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc == 0) rc = job_write_all(fd, request, strlen(request));
+    if (rc == 0) rc = job_write_all(fd, "\n", 1);
+    if (rc == 0) rc = job_read_line(fd, reply);
+    close(fd);
+    return rc;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef LARGE_COUNT_H
+#define LARGE_COUNT_H
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+// Collectives and point-to-point transfers with 64-bit element counts.
+// MPI 4 libraries get the large-count (_c) collectives directly. Older ones
+// use the plain int versions while every count and displacement fits in an
+// int and fall back to point-to-point transfers otherwise, where counts
+// above INT_MAX go out as one message of a contiguous LARGE_COUNT_BLOCK-
+// element type plus one for the remainder.
+
+#ifndef LARGE_COUNT_BLOCK
+#define LARGE_COUNT_BLOCK (1 << 30)
+#endif
+#define LARGE_COUNT_TAG 0x4c43
+
+static inline MPI_Aint large_count_extent(MPI_Datatype type) {
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(type, &lb, &extent);
+    return extent;
+}
+
+// Posts up to two requests for `count` elements; *nreq is advanced
+static inline int large_isend(const void* buf, long long count, MPI_Datatype type, int dest, int tag,
+                              MPI_Comm comm, MPI_Request* requests, int* nreq) {
+    long long blocks = count / LARGE_COUNT_BLOCK, rest = count % LARGE_COUNT_BLOCK;
+    int rc = MPI_SUCCESS;
+    if (blocks > 0) {
+        MPI_Datatype block;
+        MPI_Type_contiguous(LARGE_COUNT_BLOCK, type, &block);
+        MPI_Type_commit(&block);
+        rc = MPI_Isend(buf, (int)blocks, block, dest, tag, comm, &requests[(*nreq)++]);
+        MPI_Type_free(&block);  // freed once the pending send completes
+    }
+    if (rest > 0 && rc == MPI_SUCCESS) {
+        const char* tail = (const char*)buf + (size_t)(blocks * LARGE_COUNT_BLOCK) * large_count_extent(type);
+        rc = MPI_Isend(tail, (int)rest, type, dest, tag, comm, &requests[(*nreq)++]);
+    }
+    return rc;
+}
+
+static inline int large_irecv(void* buf, long long count, MPI_Datatype type, int source, int tag,
+                              MPI_Comm comm, MPI_Request* requests, int* nreq) {
+    long long blocks = count / LARGE_COUNT_BLOCK, rest = count % LARGE_COUNT_BLOCK;
+    int rc = MPI_SUCCESS;
+    if (blocks > 0) {
+        MPI_Datatype block;
+        MPI_Type_contiguous(LARGE_COUNT_BLOCK, type, &block);
+        MPI_Type_commit(&block);
+        rc = MPI_Irecv(buf, (int)blocks, block, source, tag, comm, &requests[(*nreq)++]);
+        MPI_Type_free(&block);
+    }
+    if (rest > 0 && rc == MPI_SUCCESS) {
+        char* tail = (char*)buf + (size_t)(blocks * LARGE_COUNT_BLOCK) * large_count_extent(type);
+        rc = MPI_Irecv(tail, (int)rest, type, source, tag, comm, &requests[(*nreq)++]);
+    }
+    return rc;
+}
+
+// 1 when counts[r] + displs[r] fit in an int for every rank
+static inline int large_count_fits_int(const long long* counts, const long long* displs, int num_procs) {
+    for (int r = 0; r < num_procs; r++) {
+        if (counts[r] > INT_MAX || displs[r] > INT_MAX - counts[r]) return 0;
+    }
+    return 1;
+}
+
+// Int copies of counts and displs (caller frees *int_counts, which owns both)
+static inline int large_count_to_int(const long long* counts, const long long* displs, int num_procs,
+                                     int** int_counts, int** int_displs) {
+    *int_counts = (int*)malloc(2 * (size_t)num_procs * sizeof(int));
+    if (!*int_counts) return MPI_ERR_NO_MEM;
+    *int_displs = *int_counts + num_procs;
+    for (int r = 0; r < num_procs; r++) {
+        (*int_counts)[r] = (int)counts[r];
+        (*int_displs)[r] = (int)displs[r];
+    }
+    return MPI_SUCCESS;
+}
+
+// Root to all (scatter) or all to root (gather) with point-to-point transfers
+static inline int large_count_p2p(void* rootbuf, const long long* counts, const long long* displs,
+                                  void* localbuf, long long local_count, MPI_Datatype type,
+                                  int root, MPI_Comm comm, int scatter) {
+    int rank, num_procs, nreq = 0, rc = MPI_SUCCESS;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    MPI_Aint extent = large_count_extent(type);
+    MPI_Request* requests = (MPI_Request*)malloc(2 * (size_t)num_procs * sizeof(MPI_Request));
+    if (!requests) return MPI_ERR_NO_MEM;
+    if (rank == root) {
+        for (int r = 0; r < num_procs && rc == MPI_SUCCESS; r++) {
+            char* slice = (char*)rootbuf + (size_t)displs[r] * extent;
+            if (r == root) {
+                if (scatter) {
+                    memmove(localbuf, slice, (size_t)counts[r] * extent);
+                } else {
+                    memmove(slice, localbuf, (size_t)counts[r] * extent);
+                }
+            } else if (scatter) {
+                rc = large_isend(slice, counts[r], type, r, LARGE_COUNT_TAG, comm, requests, &nreq);
+            } else {
+                rc = large_irecv(slice, counts[r], type, r, LARGE_COUNT_TAG, comm, requests, &nreq);
+            }
+        }
+    } else if (scatter) {
+        rc = large_irecv(localbuf, local_count, type, root, LARGE_COUNT_TAG, comm, requests, &nreq);
+    } else {
+        rc = large_isend(localbuf, local_count, type, root, LARGE_COUNT_TAG, comm, requests, &nreq);
+    }
+    int wait_rc = MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+    free(requests);
+    return rc != MPI_SUCCESS ? rc : wait_rc;
+}
+
+// MPI_Scatterv with 64-bit counts and displacements (same type on both sides)
+static inline int large_scatterv(const void* sendbuf, const long long* counts, const long long* displs,
+                                 MPI_Datatype type, void* recvbuf, long long recvcount, int root,
+                                 MPI_Comm comm) {
+    int rank, num_procs, rc;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+#if MPI_VERSION >= 4
+    MPI_Count* c_counts = (MPI_Count*)malloc((size_t)num_procs * sizeof(MPI_Count));
+    MPI_Aint* c_displs = (MPI_Aint*)malloc((size_t)num_procs * sizeof(MPI_Aint));
+    if (!c_counts || !c_displs) {
+        free(c_counts);
+        free(c_displs);
+        return MPI_ERR_NO_MEM;
+    }
+    for (int r = 0; r < num_procs; r++) {
+        c_counts[r] = (MPI_Count)counts[r];
+        c_displs[r] = (MPI_Aint)displs[r];
+    }
+    rc = MPI_Scatterv_c(sendbuf, c_counts, c_displs, type, recvbuf, (MPI_Count)recvcount, type, root, comm);
+    free(c_counts);
+    free(c_displs);
+    return rc;
+#else
+    // counts and displs are the same on every rank, so all take the same path
+    if (large_count_fits_int(counts, displs, num_procs)) {
+        int* int_counts, * int_displs;
+        rc = large_count_to_int(counts, displs, num_procs, &int_counts, &int_displs);
+        if (rc != MPI_SUCCESS) return rc;
+        rc = MPI_Scatterv(sendbuf, int_counts, int_displs, type, recvbuf, (int)recvcount, type, root, comm);
+        free(int_counts);
+        return rc;
+    }
+    return large_count_p2p((void*)sendbuf, counts, displs, recvbuf, recvcount, type, root, comm, 1);
+#endif
+}
+
+// MPI_Gatherv with 64-bit counts and displacements (same type on both sides)
+static inline int large_gatherv(const void* sendbuf, long long sendcount, void* recvbuf,
+                                const long long* counts, const long long* displs, MPI_Datatype type,
+                                int root, MPI_Comm comm) {
+    int rank, num_procs, rc;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+#if MPI_VERSION >= 4
+    MPI_Count* c_counts = (MPI_Count*)malloc((size_t)num_procs * sizeof(MPI_Count));
+    MPI_Aint* c_displs = (MPI_Aint*)malloc((size_t)num_procs * sizeof(MPI_Aint));
+    if (!c_counts || !c_displs) {
+        free(c_counts);
+        free(c_displs);
+        return MPI_ERR_NO_MEM;
+    }
+    for (int r = 0; r < num_procs; r++) {
+        c_counts[r] = (MPI_Count)counts[r];
+        c_displs[r] = (MPI_Aint)displs[r];
+    }
+    rc = MPI_Gatherv_c(sendbuf, (MPI_Count)sendcount, type, recvbuf, c_counts, c_displs, type, root, comm);
+    free(c_counts);
+    free(c_displs);
+    return rc;
+#else
+    if (large_count_fits_int(counts, displs, num_procs)) {
+        int* int_counts, * int_displs;
+        rc = large_count_to_int(counts, displs, num_procs, &int_counts, &int_displs);
+        if (rc != MPI_SUCCESS) return rc;
+        rc = MPI_Gatherv(sendbuf, (int)sendcount, type, recvbuf, int_counts, int_displs, type, root, comm);
+        free(int_counts);
+        return rc;
+    }
+    return large_count_p2p(recvbuf, counts, displs, (void*)sendbuf, sendcount, type, root, comm, 0);
+#endif
+}
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef NARROW_SUM_H
+#define NARROW_SUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sum_kernels.h"
+#include "threads.h"
+
+// Narrow element storage for the sum. Values known to lie in [0, 256) or
+// [0, 65536) are stored, scattered and summed as uint8 or uint16, so every
+// byte moved carries 4x or 2x more elements than int32. The kernels widen
+// to an exact 64-bit result: uint8 with PSADBW (sum of absolute differences
+// against zero adds 8 bytes into one 64-bit lane), uint16 by zero-extension
+// into 32-bit lanes that are flushed to 64 bits before they can overflow.
+//
+// Environment:
+//   ELEMENT_TYPE  auto (default: the narrowest type that holds the value
+//                 range), int32, uint16 or uint8
+//   SUM_KERNEL    forces the variant, as for sum_i32
+
+typedef enum { ELEMENT_INT32, ELEMENT_UINT16, ELEMENT_UINT8 } ElementType;
+
+// Vector iterations between flushes of the 32-bit uint16 lanes: one
+// 16-bit value per lane and iteration stays below 2^32 for 2^16 iterations
+#define SUM_U16_FLUSH (1 << 16)
+
+typedef long long (*SumU8Fn)(const uint8_t* arr, size_t n);
+typedef long long (*SumU16Fn)(const uint16_t* arr, size_t n);
+
+static inline size_t element_size(ElementType t) {
+    return t == ELEMENT_UINT8 ? 1 : t == ELEMENT_UINT16 ? 2 : 4;
+}
+
+static inline const char* element_name(ElementType t) {
+    return t == ELEMENT_UINT8 ? "uint8" : t == ELEMENT_UINT16 ? "uint16" : "int32";
+}
+
+// Only for MPI programs, which include <mpi.h> first; the kernels alone
+// build without MPI (kernel_bench.c)
+#ifdef MPI_VERSION
+static inline MPI_Datatype element_mpi_type(ElementType t) {
+    return t == ELEMENT_UINT8 ? MPI_UINT8_T : t == ELEMENT_UINT16 ? MPI_UINT16_T : MPI_INT;
+}
+#endif
+
+// Narrowest type that holds every value of [lo, hi]
+static inline ElementType element_type_for_range(long long lo, long long hi) {
+    if (lo >= 0 && hi <= UINT8_MAX) return ELEMENT_UINT8;
+    if (lo >= 0 && hi <= UINT16_MAX) return ELEMENT_UINT16;
+    return ELEMENT_INT32;
+}
+
+// ELEMENT_TYPE for values in [lo, hi]; -1 when it is unknown or too narrow
+// for the range
+static inline int element_type_from_env(long long lo, long long hi) {
+    const char* str = getenv("ELEMENT_TYPE");
+    ElementType fits = element_type_for_range(lo, hi);
+    if (!str || strcmp(str, "auto") == 0) return fits;
+    if (strcmp(str, "int32") == 0) return ELEMENT_INT32;
+    if (strcmp(str, "uint16") == 0) return fits != ELEMENT_INT32 ? ELEMENT_UINT16 : -1;
+    if (strcmp(str, "uint8") == 0) return fits == ELEMENT_UINT8 ? ELEMENT_UINT8 : -1;
+    return -1;
+}
+
+static inline long long sum_u8_scalar(const uint8_t* arr, size_t n) {
+    long long s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += arr[i];
+        s1 += arr[i + 1];
+        s2 += arr[i + 2];
+        s3 += arr[i + 3];
+    }
+    for (; i < n; i++) s0 += arr[i];
+    return s0 + s1 + s2 + s3;
+}
+
+static inline long long sum_u16_scalar(const uint16_t* arr, size_t n) {
+    long long s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += arr[i];
+        s1 += arr[i + 1];
+        s2 += arr[i + 2];
+        s3 += arr[i + 3];
+    }
+    for (; i < n; i++) s0 += arr[i];
+    return s0 + s1 + s2 + s3;
+}
+
+#ifdef SUM_KERNELS_X86
+
+__attribute__((target("sse2")))
+static inline long long sum_u8_sse2(const uint8_t* arr, size_t n) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        a0 = _mm_add_epi64(a0, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(arr + i)), zero));
+        a1 = _mm_add_epi64(a1, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(arr + i + 16)), zero));
+        a2 = _mm_add_epi64(a2, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(arr + i + 32)), zero));
+        a3 = _mm_add_epi64(a3, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(arr + i + 48)), zero));
+    }
+    __m128i acc = _mm_add_epi64(_mm_add_epi64(a0, a1), _mm_add_epi64(a2, a3));
+    long long lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1] + sum_u8_scalar(arr + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline long long sum_u8_avx2(const uint8_t* arr, size_t n) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        a0 = _mm256_add_epi64(a0, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(arr + i)), zero));
+        a1 = _mm256_add_epi64(a1, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(arr + i + 32)), zero));
+        a2 = _mm256_add_epi64(a2, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(arr + i + 64)), zero));
+        a3 = _mm256_add_epi64(a3, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(arr + i + 96)), zero));
+    }
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3));
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_u8_scalar(arr + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline long long sum_u8_avx512(const uint8_t* arr, size_t n) {
+    __m512i zero = _mm512_setzero_si512();
+    __m512i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+    size_t i = 0;
+    for (; i + 256 <= n; i += 256) {
+        a0 = _mm512_add_epi64(a0, _mm512_sad_epu8(_mm512_loadu_si512((const void*)(arr + i)), zero));
+        a1 = _mm512_add_epi64(a1, _mm512_sad_epu8(_mm512_loadu_si512((const void*)(arr + i + 64)), zero));
+        a2 = _mm512_add_epi64(a2, _mm512_sad_epu8(_mm512_loadu_si512((const void*)(arr + i + 128)), zero));
+        a3 = _mm512_add_epi64(a3, _mm512_sad_epu8(_mm512_loadu_si512((const void*)(arr + i + 192)), zero));
+    }
+    __m512i acc = _mm512_add_epi64(_mm512_add_epi64(a0, a1), _mm512_add_epi64(a2, a3));
+    return _mm512_reduce_add_epi64(acc) + sum_u8_scalar(arr + i, n - i);
+}
+
+// uint16: zero-extended into 32-bit lanes (four accumulators, one value
+// per lane and iteration), widened into the 64-bit total every
+// SUM_U16_FLUSH iterations
+
+__attribute__((target("sse2")))
+static inline long long sum_u16_sse2(const uint16_t* arr, size_t n) {
+    __m128i zero = _mm_setzero_si128(), total = zero;
+    size_t i = 0;
+    while (i + 16 <= n) {
+        size_t stop = n - i > (size_t)16 * SUM_U16_FLUSH ? i + (size_t)16 * SUM_U16_FLUSH : n;
+        __m128i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+        for (; i + 16 <= stop; i += 16) {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)(arr + i));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(arr + i + 8));
+            a0 = _mm_add_epi32(a0, _mm_unpacklo_epi16(v0, zero));
+            a1 = _mm_add_epi32(a1, _mm_unpackhi_epi16(v0, zero));
+            a2 = _mm_add_epi32(a2, _mm_unpacklo_epi16(v1, zero));
+            a3 = _mm_add_epi32(a3, _mm_unpackhi_epi16(v1, zero));
+        }
+        __m128i lanes[4] = {a0, a1, a2, a3};
+        for (int k = 0; k < 4; k++) {
+            total = _mm_add_epi64(total, _mm_unpacklo_epi32(lanes[k], zero));
+            total = _mm_add_epi64(total, _mm_unpackhi_epi32(lanes[k], zero));
+        }
+    }
+    long long out[2];
+    _mm_storeu_si128((__m128i*)out, total);
+    return out[0] + out[1] + sum_u16_scalar(arr + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline long long sum_u16_avx2(const uint16_t* arr, size_t n) {
+    __m256i zero = _mm256_setzero_si256(), total = zero;
+    size_t i = 0;
+    while (i + 32 <= n) {
+        size_t stop = n - i > (size_t)32 * SUM_U16_FLUSH ? i + (size_t)32 * SUM_U16_FLUSH : n;
+        __m256i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+        for (; i + 32 <= stop; i += 32) {
+            a0 = _mm256_add_epi32(a0, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(arr + i))));
+            a1 = _mm256_add_epi32(a1, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(arr + i + 8))));
+            a2 = _mm256_add_epi32(a2, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(arr + i + 16))));
+            a3 = _mm256_add_epi32(a3, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(arr + i + 24))));
+        }
+        __m256i lanes[4] = {a0, a1, a2, a3};
+        for (int k = 0; k < 4; k++) {
+            total = _mm256_add_epi64(total, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(lanes[k])));
+            total = _mm256_add_epi64(total, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(lanes[k], 1)));
+        }
+    }
+    long long out[4];
+    _mm256_storeu_si256((__m256i*)out, total);
+    return out[0] + out[1] + out[2] + out[3] + sum_u16_scalar(arr + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static inline long long sum_u16_avx512(const uint16_t* arr, size_t n) {
+    __m512i zero = _mm512_setzero_si512(), total = zero;
+    size_t i = 0;
+    while (i + 64 <= n) {
+        size_t stop = n - i > (size_t)64 * SUM_U16_FLUSH ? i + (size_t)64 * SUM_U16_FLUSH : n;
+        __m512i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+        for (; i + 64 <= stop; i += 64) {
+            a0 = _mm512_add_epi32(a0, _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(arr + i))));
+            a1 = _mm512_add_epi32(a1, _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(arr + i + 16))));
+            a2 = _mm512_add_epi32(a2, _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(arr + i + 32))));
+            a3 = _mm512_add_epi32(a3, _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(arr + i + 48))));
+        }
+        __m512i lanes[4] = {a0, a1, a2, a3};
+        for (int k = 0; k < 4; k++) {
+            total = _mm512_add_epi64(total, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(lanes[k])));
+            total = _mm512_add_epi64(total, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(lanes[k], 1)));
+        }
+    }
+    return _mm512_reduce_add_epi64(total) + sum_u16_scalar(arr + i, n - i);
+}
+
+#endif
+
+typedef struct {
+    const char* name;
+    SumU8Fn u8;
+    SumU16Fn u16;
+} NarrowSumKernel;
+
+// Widest variant of this CPU, or SUM_KERNEL; the uint8 AVX-512 kernel
+// needs AVX512BW on top of AVX512F
+static inline NarrowSumKernel narrow_sum_kernel_select(void) {
+    NarrowSumKernel available[4] = {{"scalar", sum_u8_scalar, sum_u16_scalar}};
+    int count = 1;
+#ifdef SUM_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) available[count++] = (NarrowSumKernel){"sse2", sum_u8_sse2, sum_u16_sse2};
+    if (__builtin_cpu_supports("avx2")) available[count++] = (NarrowSumKernel){"avx2", sum_u8_avx2, sum_u16_avx2};
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        available[count++] = (NarrowSumKernel){"avx512", sum_u8_avx512, sum_u16_avx512};
+    }
+#endif
+    const char* forced = getenv("SUM_KERNEL");
+    for (int i = 0; forced && i < count; i++) {
+        if (strcmp(forced, available[i].name) == 0) return available[i];
+    }
+    return available[count - 1];
+}
+
+static inline const NarrowSumKernel* narrow_sum_kernel(void) {
+    static NarrowSumKernel selected;
+    if (!selected.u8) selected = narrow_sum_kernel_select();
+    return &selected;
+}
+
+// Name of the kernel variant that sums elements of type `t`
+static inline const char* element_sum_kernel(ElementType t) {
+    return t == ELEMENT_INT32 ? sum_kernel()->name : narrow_sum_kernel()->name;
+}
+
+static inline long long sum_elements(const void* arr, size_t n, ElementType t) {
+    if (t == ELEMENT_UINT8) return narrow_sum_kernel()->u8((const uint8_t*)arr, n);
+    if (t == ELEMENT_UINT16) return narrow_sum_kernel()->u16((const uint16_t*)arr, n);
+    return sum_i32((const int*)arr, n);
+}
+
+static inline long long sum_elements_threaded(const void* arr, size_t n, ElementType t, int threads) {
+    if (t == ELEMENT_INT32) return sum_i32_threaded((const int*)arr, n, threads);
+    if (threads <= 1) return sum_elements(arr, n, t);
+    long long total = 0;
+    narrow_sum_kernel();  // resolve the dispatch once, outside the parallel region
+#pragma omp parallel num_threads(threads) reduction(+:total)
+    {
+        size_t begin, end;
+        thread_range(n, &begin, &end);
+        total += sum_elements((const char*)arr + begin * element_size(t), end - begin, t);
+    }
+    return total;
+}
+
+// Achieved read bandwidth of a sum over n elements of type `t`
+static inline double element_sum_gbs(size_t n, ElementType t, double seconds) {
+    return seconds > 0 ? (double)n * element_size(t) / seconds / 1e9 : 0.0;
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef NUMA_ALLOC_H
+#define NUMA_ALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "threads.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#define NUMA_ALLOC_LINUX 1
+#endif
+
+// NUMA-aware placement for the big buffers. numa_setup() pins every rank
+// to its own block of CPUs (compact, by node-local rank) and each of its
+// OpenMP threads to one CPU of the block. numa_alloc() returns 2 MB aligned
+// anonymous memory with transparent huge pages requested, bound (mbind) to
+// the rank's NUMA node and first touched by the same static thread split
+// the kernels use, so every page starts out next to the thread that streams
+// it. numa_report() prints the binding of every rank.
+//
+// Environment:
+//   NUMA_ALLOC  0 falls back to plain malloc (for A/B comparisons)
+//   PIN         auto (default): pin unless the launcher already restricted
+//               the rank to fewer CPUs than the node has (then only the
+//               threads are spread inside that set); none: no pinning
+//   HUGEPAGES   thp (default, madvise MADV_HUGEPAGE), hugetlb (MAP_HUGETLB
+//               from the reserved pool, THP if it is empty) or off
+
+#define NUMA_PAGE_SIZE ((size_t)2 << 20)
+#define NUMA_MAX_CPUS 1024
+#define NUMA_MAX_NODES 64
+#define NUMA_MASK_BITS (8 * sizeof(unsigned long))
+#define NUMA_MASK_WORDS (NUMA_MAX_CPUS / NUMA_MASK_BITS)
+
+typedef enum { NUMA_HUGE_OFF, NUMA_HUGE_THP, NUMA_HUGE_TLB } NumaHugePages;
+
+typedef struct {
+    int enabled;
+    int pinned;
+    int hugepages;
+    int node;         // NUMA node of the rank's CPUs, -1 unknown
+    int num_nodes;
+    int hugetlb_failed;
+    unsigned long cpus[NUMA_MASK_WORDS];  // CPUs the rank's threads are pinned to
+} NumaState;
+
+static NumaState numa_state = {0, 0, NUMA_HUGE_THP, -1, 1, 0, {0}};
+
+static inline int numa_count_nodes(void) {
+    int nodes = 0;
+#ifdef NUMA_ALLOC_LINUX
+    DIR* dir = opendir("/sys/devices/system/node");
+    struct dirent* entry;
+    while (dir && (entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            nodes++;
+        }
+    }
+    if (dir) closedir(dir);
+#endif
+    return nodes > 0 ? nodes : 1;
+}
+
+// Collective over `comm`: reads the environment and pins the calling rank
+// and its `threads` OpenMP threads
+static inline void numa_setup(int threads, MPI_Comm comm) {
+    const char* alloc_str = getenv("NUMA_ALLOC");
+    const char* pin_str = getenv("PIN");
+    const char* huge_str = getenv("HUGEPAGES");
+    NumaState* st = &numa_state;
+    st->enabled = !(alloc_str && atoi(alloc_str) == 0);
+    st->hugepages = !huge_str || strcmp(huge_str, "thp") == 0 ? NUMA_HUGE_THP
+                  : strcmp(huge_str, "hugetlb") == 0 ? NUMA_HUGE_TLB : NUMA_HUGE_OFF;
+    st->num_nodes = numa_count_nodes();
+    st->node = -1;
+#ifdef NUMA_ALLOC_LINUX
+    MPI_Comm node_comm;
+    int local_rank;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &local_rank);
+    MPI_Comm_free(&node_comm);
+
+    // CPUs this rank may use, in order (raw affinity syscalls: the glibc
+    // wrappers need _GNU_SOURCE before the first include)
+    int cpus[NUMA_MAX_CPUS], num_allowed = 0;
+    unsigned long allowed[NUMA_MASK_WORDS] = {0};
+    if (syscall(SYS_sched_getaffinity, 0, sizeof(allowed), allowed) > 0) {
+        for (int c = 0; c < NUMA_MAX_CPUS; c++) {
+            if (allowed[c / NUMA_MASK_BITS] & (1ul << (c % NUMA_MASK_BITS))) cpus[num_allowed++] = c;
+        }
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int launcher_bound = num_allowed > 0 && num_allowed < online;
+    st->pinned = num_allowed > 0 && !(pin_str && strcmp(pin_str, "none") == 0);
+    memset(st->cpus, 0, sizeof(st->cpus));
+    if (st->pinned) {
+        // Without a launcher binding every rank takes the next block of
+        // `threads` CPUs; otherwise the launcher's set is the rank's block.
+        // Blocks are runs of the allowed list, which need not be contiguous.
+        int first = 0, count = num_allowed;
+        if (!launcher_bound) {
+            count = threads < num_allowed ? threads : num_allowed;
+            first = (local_rank * count) % num_allowed;
+            if (first + count > num_allowed) first = num_allowed - count;
+        }
+        for (int t = 0; t < threads && t < count; t++) {
+            int cpu = cpus[first + t];
+            st->cpus[cpu / NUMA_MASK_BITS] |= 1ul << (cpu % NUMA_MASK_BITS);
+        }
+#pragma omp parallel num_threads(threads)
+        {
+#ifdef _OPENMP
+            int t = omp_get_thread_num();
+#else
+            int t = 0;
+#endif
+            unsigned long set[NUMA_MASK_WORDS] = {0};
+            int cpu = cpus[first + t % count];
+            set[cpu / NUMA_MASK_BITS] = 1ul << (cpu % NUMA_MASK_BITS);
+            syscall(SYS_sched_setaffinity, 0, sizeof(set), set);  // thread 0 is the main thread
+        }
+    }
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) st->node = (int)node;
+#else
+    (void)threads;
+    (void)comm;
+    (void)pin_str;
+#endif
+}
+
+// Zeroes [p, p + bytes) with the static thread split of the kernels
+static inline void numa_first_touch(void* p, size_t bytes, int threads) {
+    char* base = (char*)p;
+#pragma omp parallel num_threads(threads) if (threads > 1)
+    {
+        size_t begin, end;
+        thread_range(bytes, &begin, &end);
+        memset(base + begin, 0, end - begin);
+    }
+}
+
+static inline size_t numa_round_up(size_t bytes) {
+    return (bytes + NUMA_PAGE_SIZE - 1) / NUMA_PAGE_SIZE * NUMA_PAGE_SIZE;
+}
+
+// `bytes` of zeroed memory placed for `threads` threads of this rank; NULL
+// on failure. Free with numa_free and the same size.
+static inline void* numa_alloc(size_t bytes, int threads) {
+    NumaState* st = &numa_state;
+    if (bytes == 0) bytes = 1;
+    if (!st->enabled) return calloc(1, bytes);
+#ifdef NUMA_ALLOC_LINUX
+    size_t length = numa_round_up(bytes);
+    char* p = MAP_FAILED;
+    if (st->hugepages == NUMA_HUGE_TLB && !st->hugetlb_failed) {
+        p = (char*)mmap(NULL, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) st->hugetlb_failed = 1;  // pool empty: THP from now on
+    }
+    if (p == MAP_FAILED) {
+        // Over-map by one huge page and trim to a 2 MB boundary
+        char* raw = (char*)mmap(NULL, length + NUMA_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return NULL;
+        p = (char*)(((size_t)raw + NUMA_PAGE_SIZE - 1) / NUMA_PAGE_SIZE * NUMA_PAGE_SIZE);
+        if (p > raw) munmap(raw, (size_t)(p - raw));
+        munmap(p + length, (size_t)(raw + NUMA_PAGE_SIZE - p));
+        if (st->hugepages != NUMA_HUGE_OFF) madvise(p, length, MADV_HUGEPAGE);
+    }
+    if (st->node >= 0 && st->node < NUMA_MAX_NODES && st->num_nodes > 1) {
+        // Before the first touch, so every page is allocated on the node
+        unsigned long mask = 1ul << st->node;
+        syscall(SYS_mbind, p, length, MPOL_BIND, &mask, (unsigned long)NUMA_MAX_NODES + 1, 0);
+    }
+    numa_first_touch(p, length, threads);
+    return p;
+#else
+    (void)threads;
+    return calloc(1, bytes);
+#endif
+}
+
+static inline void numa_free(void* p, size_t bytes) {
+    if (!p) return;
+#ifdef NUMA_ALLOC_LINUX
+    if (numa_state.enabled) {
+        munmap(p, numa_round_up(bytes ? bytes : 1));
+        return;
+    }
+#endif
+    (void)bytes;
+    free(p);
+}
+
+// Anonymous memory of this process in transparent huge pages, in kB
+static inline long numa_thp_kb(void) {
+    long kb = 0;
+#ifdef NUMA_ALLOC_LINUX
+    char line[256];
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    while (f && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+    }
+    if (f) fclose(f);
+#endif
+    return kb;
+}
+
+static inline int numa_cpu_in(const unsigned long* mask, int cpu) {
+    return cpu < NUMA_MAX_CPUS && (mask[cpu / NUMA_MASK_BITS] >> (cpu % NUMA_MASK_BITS) & 1);
+}
+
+// CPU list of a mask, e.g. "0-3,8,10-11"
+static inline void numa_format_cpus(const unsigned long* mask, char* out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+    for (int c = 0; c < NUMA_MAX_CPUS && len < size; c++) {
+        if (!numa_cpu_in(mask, c)) continue;
+        int last = c;
+        while (numa_cpu_in(mask, last + 1)) last++;
+        int written = last > c ? snprintf(out + len, size - len, "%s%d-%d", len ? "," : "", c, last)
+                               : snprintf(out + len, size - len, "%s%d", len ? "," : "", c);
+        len += written > 0 ? (size_t)written : 0;
+        c = last;
+    }
+}
+
+// Collective over `comm`: rank 0 prints each rank's CPUs, node and THP use
+static inline void numa_report(MPI_Comm comm) {
+    int rank, num_procs;
+    const NumaState* st = &numa_state;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    // pinned, node, THP kB, hugetlb fallback, then the CPU mask
+    enum { FIELDS = 4 + NUMA_MASK_WORDS };
+    unsigned long mine[FIELDS] = {(unsigned long)st->pinned, (unsigned long)st->node,
+                                  (unsigned long)numa_thp_kb(), (unsigned long)st->hugetlb_failed};
+    memcpy(mine + 4, st->cpus, sizeof(st->cpus));
+    unsigned long* all = rank == 0 ? (unsigned long*)malloc(FIELDS * (size_t)num_procs * sizeof(long)) : NULL;
+    MPI_Gather(mine, FIELDS, MPI_UNSIGNED_LONG, all, FIELDS, MPI_UNSIGNED_LONG, 0, comm);
+    if (!all) return;
+    printf("\nPlacement (%s, %d NUMA node%s, huge pages: %s):\n",
+           !st->enabled ? "malloc" : st->num_nodes > 1 ? "first-touch, mbind to local node" : "first-touch",
+           st->num_nodes,
+           st->num_nodes > 1 ? "s" : "",
+           st->hugepages == NUMA_HUGE_TLB ? "hugetlb" : st->hugepages == NUMA_HUGE_THP ? "THP" : "off");
+    for (int r = 0; r < num_procs; r++) {
+        const unsigned long* f = all + FIELDS * (size_t)r;
+        char list[256];
+        numa_format_cpus(f + 4, list, sizeof(list));
+        printf("  rank %d: ", r);
+        if (f[0]) {
+            printf("cpus %s", list);
+        } else {
+            printf("not pinned");
+        }
+        printf(", node %ld, %ld MB in huge pages%s\n", (long)f[1], (long)f[2] / 1024,
+               f[3] ? " (hugetlb pool empty, used THP)" : "");
+    }
+    free(all);
+}
+
+#endif
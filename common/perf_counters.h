@@ -0,0 +1,254 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define PERF_COUNTERS_LINUX 1
+#endif
+
+// Hardware counter instrumentation (Linux perf_event_open) with a roofline
+// report. Every instrumented kernel accumulates cycles, instructions, LLC
+// misses and dTLB misses of its calling thread and the OpenMP threads it
+// starts. The report derives IPC, DRAM bytes per element (LLC misses x 64)
+// and GB/s, and compares GB/s with a STREAM triad run concurrently on all
+// ranks, so each kernel shows what fraction of its memory roof it reaches
+// on its rank. Counters the kernel or the hardware does not give us
+// (perf_event_paranoid, VMs without a PMU) are reported as n/a; timing and
+// roofline still work.
+//
+// perf_counters_open() must run before the first OpenMP region: the events
+// are inherited only by threads created after them, and the runtime keeps
+// its threads for the later regions.
+//
+// Environment:
+//   PERF_COUNTERS     1 enables the instrumentation
+//   PERF_STREAM_SIZE  doubles per STREAM array (default 4M, 3 arrays)
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NUM_EVENTS
+} PerfEventId;
+
+typedef struct {
+    int fd[PERF_NUM_EVENTS];  // -1 where the event is unavailable
+} PerfCounters;
+
+typedef struct {
+    const char* name;
+    const PerfCounters* pc;    // NULL: instrumentation off
+    double bytes_per_element;  // nominal traffic, STREAM convention
+    long long runs;
+    double elements;
+    double seconds;
+    double counts[PERF_NUM_EVENTS];
+    double start_counts[PERF_NUM_EVENTS];
+    double start_time;
+} PerfKernel;
+
+static inline int perf_counters_requested(void) {
+    const char* str = getenv("PERF_COUNTERS");
+    return str && atoi(str) != 0;
+}
+
+static inline void perf_counters_open(PerfCounters* pc) {
+#ifdef PERF_COUNTERS_LINUX
+    static const struct { unsigned type; unsigned long long config; } events[PERF_NUM_EVENTS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[e].type;
+        attr.config = events[e].config;
+        attr.exclude_kernel = 1;  // allowed up to perf_event_paranoid = 2
+        attr.exclude_hv = 1;
+        attr.inherit = 1;         // OpenMP threads started later are counted too
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        pc->fd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#else
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) pc->fd[e] = -1;
+#endif
+}
+
+static inline int perf_counters_available(const PerfCounters* pc) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (pc->fd[e] >= 0) return 1;
+    }
+    return 0;
+}
+
+// Current counter values, scaled up if the event was multiplexed; NAN when
+// an event is unavailable
+static inline void perf_counters_read(const PerfCounters* pc, double* values) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        unsigned long long data[3];  // value, time enabled, time running
+        values[e] = NAN;
+        if (pc->fd[e] < 0 || read(pc->fd[e], data, sizeof(data)) != (ssize_t)sizeof(data)) continue;
+        values[e] = data[2] > 0 ? (double)data[0] * ((double)data[1] / (double)data[2]) : 0.0;
+    }
+}
+
+static inline void perf_counters_close(PerfCounters* pc) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (pc->fd[e] >= 0) close(pc->fd[e]);
+        pc->fd[e] = -1;
+    }
+}
+
+static inline void perf_kernel_init(PerfKernel* k, const char* name, const PerfCounters* pc,
+                                    double bytes_per_element) {
+    memset(k, 0, sizeof(*k));
+    k->name = name;
+    k->pc = pc;
+    k->bytes_per_element = bytes_per_element;
+}
+
+// Drops what was collected so far (e.g. during warm-up)
+static inline void perf_kernel_reset(PerfKernel* k) {
+    k->runs = 0;
+    k->elements = k->seconds = 0.0;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) k->counts[e] = 0.0;
+}
+
+// begin/end bracket one run of the kernel; no-ops when `k` is NULL or off
+static inline void perf_kernel_begin(PerfKernel* k) {
+    if (!k || !k->pc) return;
+    perf_counters_read(k->pc, k->start_counts);
+    k->start_time = MPI_Wtime();
+}
+
+static inline void perf_kernel_end(PerfKernel* k, size_t elements) {
+    double now[PERF_NUM_EVENTS];
+    if (!k || !k->pc) return;
+    double end_time = MPI_Wtime();
+    perf_counters_read(k->pc, now);
+    k->seconds += end_time - k->start_time;
+    k->elements += (double)elements;
+    k->runs++;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) k->counts[e] += now[e] - k->start_counts[e];
+}
+
+// STREAM triad a = b + s * c (24 bytes per element), best of `reps`. All
+// ranks of `comm` run it at the same time, so the result is this rank's
+// share of the node bandwidth: the memory roof of its kernels.
+static inline double perf_stream_triad_gbs(size_t n, int threads, int reps, MPI_Comm comm) {
+    double* a = (double*)malloc(3 * n * sizeof(double));
+    double best = 0.0;
+    if (!a) return 0.0;
+    double* b = a + n, * c = b + n;
+#pragma omp parallel for num_threads(threads) if (threads > 1) schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+    for (int rep = 0; rep < reps; rep++) {
+        MPI_Barrier(comm);
+        double start = MPI_Wtime();
+#pragma omp parallel for num_threads(threads) if (threads > 1) schedule(static)
+        for (size_t i = 0; i < n; i++) a[i] = b[i] + 3.0 * c[i];
+        double elapsed = MPI_Wtime() - start;
+        if (rep == 0 || elapsed < best) best = elapsed;
+    }
+    double check = a[n / 2];
+    free(a);
+    return best > 0 && check == 7.0 ? 24.0 * (double)n / best / 1e9 : 0.0;
+}
+
+static inline size_t perf_stream_size(void) {
+    const char* str = getenv("PERF_STREAM_SIZE");
+    long long n = str ? atoll(str) : 0;
+    return n > 0 ? (size_t)n : (size_t)1 << 22;
+}
+
+// Per-kernel fields exchanged for the report
+enum { PERF_F_RUNS, PERF_F_ELEMENTS, PERF_F_SECONDS, PERF_F_BYTES, PERF_F_ROOF,
+       PERF_F_COUNTS, PERF_NUM_FIELDS = PERF_F_COUNTS + PERF_NUM_EVENTS };
+
+static inline void perf_print_value(double value, const char* fmt, int width) {
+    if (isnan(value)) {
+        printf(" %*s", width, "n/a");
+    } else {
+        printf(" ");
+        printf(fmt, width, value);
+    }
+}
+
+// Collective over `comm`: rank 0 prints one row per rank and kernel that ran
+// there. `stream_gbs` is this rank's triad bandwidth.
+static inline void perf_report(const PerfKernel* kernels, int num_kernels, double stream_gbs,
+                               MPI_Comm comm) {
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    size_t per_rank = (size_t)num_kernels * PERF_NUM_FIELDS;
+    double* mine = (double*)malloc(per_rank * sizeof(double));
+    double* all = rank == 0 ? (double*)malloc(per_rank * num_procs * sizeof(double)) : NULL;
+    int ok = mine && (rank != 0 || all);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!ok) {
+        if (rank == 0) printf("Warning: not enough memory for the counter report\n");
+        free(mine);
+        free(all);
+        return;
+    }
+    for (int k = 0; k < num_kernels; k++) {
+        double* f = mine + (size_t)k * PERF_NUM_FIELDS;
+        f[PERF_F_RUNS] = (double)kernels[k].runs;
+        f[PERF_F_ELEMENTS] = kernels[k].elements;
+        f[PERF_F_SECONDS] = kernels[k].seconds;
+        f[PERF_F_BYTES] = kernels[k].bytes_per_element;
+        f[PERF_F_ROOF] = stream_gbs;
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) f[PERF_F_COUNTS + e] = kernels[k].counts[e];
+    }
+    MPI_Gather(mine, (int)per_rank, MPI_DOUBLE, all, (int)per_rank, MPI_DOUBLE, 0, comm);
+
+    if (rank == 0) {
+        printf("\nHardware counters and roofline (per rank; roof = concurrent STREAM triad):\n");
+        if (num_kernels > 0 && kernels[0].pc && !perf_counters_available(kernels[0].pc)) {
+            printf("  perf_event_open unavailable on rank 0 (no PMU or perf_event_paranoid), counters n/a\n");
+        }
+        printf("  %4s %-16s %6s %10s %10s %10s %8s %8s %8s %6s  %s\n", "rank", "kernel", "IPC",
+               "LLC/elem", "dTLB/elem", "DRAM B/el", "B/elem", "GB/s", "roof", "roof%", "bound");
+        for (int r = 0; r < num_procs; r++) {
+            for (int k = 0; k < num_kernels; k++) {
+                const double* f = all + (size_t)r * per_rank + (size_t)k * PERF_NUM_FIELDS;
+                if (f[PERF_F_RUNS] == 0 || f[PERF_F_ELEMENTS] == 0) continue;
+                const double* c = f + PERF_F_COUNTS;
+                double n = f[PERF_F_ELEMENTS];
+                double gbs = f[PERF_F_SECONDS] > 0 ? n * f[PERF_F_BYTES] / f[PERF_F_SECONDS] / 1e9 : 0.0;
+                double fraction = f[PERF_F_ROOF] > 0 ? gbs / f[PERF_F_ROOF] : 0.0;
+                printf("  %4d %-16s", r, kernels[k].name);
+                perf_print_value(c[PERF_CYCLES] > 0 ? c[PERF_INSTRUCTIONS] / c[PERF_CYCLES] : NAN, "%*.2f", 6);
+                perf_print_value(c[PERF_LLC_MISSES] / n, "%*.4f", 10);
+                perf_print_value(c[PERF_DTLB_MISSES] / n, "%*.5f", 10);
+                perf_print_value(64.0 * c[PERF_LLC_MISSES] / n, "%*.2f", 10);
+                printf(" %8.1f %8.2f %8.2f %5.0f%%  %s\n", f[PERF_F_BYTES], gbs, f[PERF_F_ROOF],
+                       100.0 * fraction,
+                       fraction > 1.1 ? "cache (above DRAM roof)" : fraction >= 0.5 ? "memory" : "core/latency");
+            }
+        }
+    }
+    free(mine);
+    free(all);
+}
+
+#endif
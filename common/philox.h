@@ -0,0 +1,105 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", SC'11). Every element is a pure function of
+// (seed, stream, global index), so any rank can generate any slice of an
+// array on its own and the data is identical for every process count.
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+typedef struct {
+    uint32_t v[4];
+} PhiloxBlock;
+
+static inline void philox_round(uint32_t* c, uint32_t k0, uint32_t k1) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c[0];
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c[2];
+    uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+    uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+    uint32_t c0 = hi1 ^ c[1] ^ k0;
+    uint32_t c2 = hi0 ^ c[3] ^ k1;
+    c[0] = c0;
+    c[1] = lo1;
+    c[2] = c2;
+    c[3] = lo0;
+}
+
+// Returns the 4 random words for counter `block` of `stream` under `seed`.
+static inline PhiloxBlock philox4x32_10(uint64_t block, uint32_t stream, uint64_t seed) {
+    PhiloxBlock r = {{(uint32_t)block, (uint32_t)(block >> 32), stream, 0}};
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        philox_round(r.v, k0, k1);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return r;
+}
+
+// Maps a 32-bit word onto [0, bound) with a multiply-shift (no division).
+static inline uint32_t philox_bounded(uint32_t word, uint32_t bound) {
+    return (uint32_t)(((uint64_t)word * bound) >> 32);
+}
+
+// Fills out[0..count) with values in [0, bound) for global indices
+// first, first + 1, ... of the given stream.
+static inline void philox_fill_int(int* out, size_t first, size_t count,
+                                   uint64_t seed, uint32_t stream, uint32_t bound) {
+    size_t i = 0;
+    while (i < count) {
+        size_t global = first + i;
+        PhiloxBlock r = philox4x32_10(global / 4, stream, seed);
+        for (size_t lane = global % 4; lane < 4 && i < count; lane++, i++) {
+            out[i] = (int)philox_bounded(r.v[lane], bound);
+        }
+    }
+}
+
+// Same as philox_fill_int for narrow storage: `bound` is at most 256
+// (uint8) or 65536 (uint16), the values are the same as philox_fill_int's.
+static inline void philox_fill_u8(uint8_t* out, size_t first, size_t count,
+                                  uint64_t seed, uint32_t stream, uint32_t bound) {
+    size_t i = 0;
+    while (i < count) {
+        size_t global = first + i;
+        PhiloxBlock r = philox4x32_10(global / 4, stream, seed);
+        for (size_t lane = global % 4; lane < 4 && i < count; lane++, i++) {
+            out[i] = (uint8_t)philox_bounded(r.v[lane], bound);
+        }
+    }
+}
+
+static inline void philox_fill_u16(uint16_t* out, size_t first, size_t count,
+                                   uint64_t seed, uint32_t stream, uint32_t bound) {
+    size_t i = 0;
+    while (i < count) {
+        size_t global = first + i;
+        PhiloxBlock r = philox4x32_10(global / 4, stream, seed);
+        for (size_t lane = global % 4; lane < 4 && i < count; lane++, i++) {
+            out[i] = (uint16_t)philox_bounded(r.v[lane], bound);
+        }
+    }
+}
+
+// Same as philox_fill_int, but stores lo + [0, bound) as doubles.
+static inline void philox_fill_double(double* out, size_t first, size_t count,
+                                      uint64_t seed, uint32_t stream,
+                                      uint32_t lo, uint32_t bound) {
+    size_t i = 0;
+    while (i < count) {
+        size_t global = first + i;
+        PhiloxBlock r = philox4x32_10(global / 4, stream, seed);
+        for (size_t lane = global % 4; lane < 4 && i < count; lane++, i++) {
+            out[i] = (double)(lo + philox_bounded(r.v[lane], bound));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <limits.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+// Pipelined, chunked scatter. Each rank's slice (counts[r] elements at
+// displs[r] in the root's send buffers) is cut into chunks of `chunk`
+// elements that are distributed with MPI_Iscatterv into `depth` rotating
+// receive buffers. A rank consumes chunk k while chunks k+1 .. k+depth-1
+// are still in flight. Several arrays ("streams", e.g. a and b) share one
+// pipeline so the consumer sees matching chunks of all of them. The chunk
+// displacements of MPI_Iscatterv are ints, so the arrays are limited to
+// INT_MAX elements (pipeline_init fails with MPI_ERR_COUNT beyond that).
+
+typedef void (*PipelineConsumer)(void* const* chunks, int count, int offset, void* ctx);
+
+typedef struct {
+    MPI_Comm comm;
+    MPI_Datatype type;
+    int root, rank, num_procs;
+    int streams, chunk, depth, num_chunks;
+    size_t chunk_bytes;
+    const long long* counts;
+    const long long* displs;
+    char* buffers;          // depth x streams x chunk elements
+    int* chunk_counts;      // depth x num_procs, kept alive until completion
+    int* chunk_displs;
+    MPI_Request* requests;  // depth x streams
+    double wait_time;       // time blocked in MPI_Waitall (exposed communication)
+    double compute_time;    // time spent in the consumer
+} ScatterPipeline;
+
+// CHUNK_SIZE (elements) and PIPELINE_DEPTH (buffers in flight) from the
+// environment, with defaults of 1M elements and double buffering.
+static inline void pipeline_params_from_env(int* chunk, int* depth) {
+    char* chunk_str = getenv("CHUNK_SIZE");
+    char* depth_str = getenv("PIPELINE_DEPTH");
+    *chunk = chunk_str ? atoi(chunk_str) : 1 << 20;
+    *depth = depth_str ? atoi(depth_str) : 2;
+    if (*chunk <= 0) *chunk = 1 << 20;
+    if (*depth < 1) *depth = 2;
+}
+
+static inline int pipeline_init(ScatterPipeline* p, int streams, MPI_Datatype type,
+                                const long long* counts, const long long* displs, int chunk, int depth,
+                                int root, MPI_Comm comm) {
+    int type_size;
+    long long max_count = 0;
+    MPI_Comm_rank(comm, &p->rank);
+    MPI_Comm_size(comm, &p->num_procs);
+    MPI_Type_size(type, &type_size);
+    for (int r = 0; r < p->num_procs; r++) {
+        if (counts[r] > max_count) max_count = counts[r];
+        if (displs[r] + counts[r] > INT_MAX) return MPI_ERR_COUNT;
+    }
+    p->comm = comm;
+    p->type = type;
+    p->root = root;
+    p->streams = streams;
+    p->chunk = chunk;
+    p->depth = depth;
+    p->num_chunks = (int)((max_count + chunk - 1) / chunk);  // same on every rank
+    p->chunk_bytes = (size_t)chunk * type_size;
+    p->counts = counts;
+    p->displs = displs;
+    p->buffers = (char*)malloc((size_t)depth * streams * p->chunk_bytes);
+    p->chunk_counts = (int*)malloc((size_t)depth * p->num_procs * sizeof(int));
+    p->chunk_displs = (int*)malloc((size_t)depth * p->num_procs * sizeof(int));
+    p->requests = (MPI_Request*)malloc((size_t)depth * streams * sizeof(MPI_Request));
+    p->wait_time = 0.0;
+    p->compute_time = 0.0;
+    return p->buffers && p->chunk_counts && p->chunk_displs && p->requests ? 0 : -1;
+}
+
+static inline void pipeline_free(ScatterPipeline* p) {
+    free(p->buffers);
+    free(p->chunk_counts);
+    free(p->chunk_displs);
+    free(p->requests);
+}
+
+static inline int pipeline_chunk_count(const ScatterPipeline* p, int r, int k) {
+    long long remaining = p->counts[r] - (long long)k * p->chunk;
+    return remaining <= 0 ? 0 : remaining < p->chunk ? (int)remaining : p->chunk;
+}
+
+static inline char* pipeline_buffer(const ScatterPipeline* p, int slot, int stream) {
+    return p->buffers + ((size_t)slot * p->streams + stream) * p->chunk_bytes;
+}
+
+static inline int pipeline_post(ScatterPipeline* p, const void* const* sendbufs, int k) {
+    int slot = k % p->depth;
+    int* counts = p->chunk_counts + (size_t)slot * p->num_procs;
+    int* displs = p->chunk_displs + (size_t)slot * p->num_procs;
+    for (int r = 0; r < p->num_procs; r++) {
+        counts[r] = pipeline_chunk_count(p, r, k);
+        displs[r] = (int)(p->displs[r] + (long long)k * p->chunk);
+    }
+    for (int s = 0; s < p->streams; s++) {
+        int rc = MPI_Iscatterv(p->rank == p->root ? sendbufs[s] : NULL, counts, displs, p->type,
+                               pipeline_buffer(p, slot, s), counts[p->rank], p->type,
+                               p->root, p->comm, &p->requests[slot * p->streams + s]);
+        if (rc != MPI_SUCCESS) return rc;
+    }
+    return MPI_SUCCESS;
+}
+
+// Runs one full distribution; `sendbufs` (one per stream) matter on the root only.
+static inline int pipeline_run(ScatterPipeline* p, const void* const* sendbufs,
+                               PipelineConsumer consume, void* ctx) {
+    void* chunks[8];
+    int rc = MPI_SUCCESS;
+    if (p->streams > 8) return MPI_ERR_ARG;
+    for (int k = 0; k < p->depth && k < p->num_chunks && rc == MPI_SUCCESS; k++) {
+        rc = pipeline_post(p, sendbufs, k);
+    }
+    for (int k = 0; k < p->num_chunks && rc == MPI_SUCCESS; k++) {
+        int slot = k % p->depth;
+        double start = MPI_Wtime();
+        rc = MPI_Waitall(p->streams, &p->requests[slot * p->streams], MPI_STATUSES_IGNORE);
+        double waited = MPI_Wtime();
+        p->wait_time += waited - start;
+        if (rc != MPI_SUCCESS) break;
+
+        int count = pipeline_chunk_count(p, p->rank, k);
+        for (int s = 0; s < p->streams; s++) chunks[s] = pipeline_buffer(p, slot, s);
+        if (count > 0) consume(chunks, count, k * p->chunk, ctx);
+        p->compute_time += MPI_Wtime() - waited;
+
+        // Refill the slot that was just consumed
+        if (k + p->depth < p->num_chunks) rc = pipeline_post(p, sendbufs, k + p->depth);
+    }
+    return rc;
+}
+
+// Share of the blocking scatter time hidden behind computation, given the
+// exposed wait of the pipeline and the time of an equivalent blocking scatter.
+static inline double pipeline_overlap(double wait_time, double blocking_time) {
+    if (blocking_time <= 0) return 0.0;
+    double hidden = 1.0 - wait_time / blocking_time;
+    return hidden < 0 ? 0.0 : hidden > 1 ? 1.0 : hidden;
+}
+
+#endif
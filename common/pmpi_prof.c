@@ -0,0 +1,436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+// PMPI interposition profiler. Linked into any of the programs it wraps the
+// collectives (and the point-to-point calls behind SCATTER=shared) and
+// records, per rank, calls, time and payload bytes of every MPI function,
+// separately from the compute regions that programs report through
+// prof_region() (common/prof_regions.h). At MPI_Finalize rank 0 prints a
+// summary with min/avg/max over ranks to stderr and, with PMPI_TRACE set,
+// writes a Chrome-trace JSON timeline (chrome://tracing, ui.perfetto.dev)
+// with one track per rank, so load imbalance and wait time are visible.
+//
+//   mpicc -O2 Task1.c common/pmpi_prof.c -o task1_prof -lm
+//   or: mpicc -O2 -shared -fPIC common/pmpi_prof.c -o libpmpi_prof.so
+//       LD_PRELOAD=./libpmpi_prof.so mpirun -np 4 ./task1
+//
+// Environment:
+//   PMPI_TRACE       write the timeline to this file
+//   PMPI_MAX_EVENTS  events kept per rank for the timeline (default 1M)
+//
+// Timestamps are taken relative to a barrier in MPI_Init, so tracks of
+// different nodes line up to within the barrier skew.
+
+#define PROF_CALLS(X) \
+    X(Scatter) X(Scatterv) X(Iscatterv) X(Gather) X(Gatherv) X(Reduce) X(Allreduce) X(Exscan) \
+    X(Bcast) X(Barrier) X(Allgather) X(Isend) X(Irecv) X(Start) X(Wait) X(Waitall)
+
+#define PROF_ID(name) PROF_##name,
+enum { PROF_CALLS(PROF_ID) PROF_NUM_CALLS };
+#undef PROF_ID
+
+#define PROF_NAME(name) "MPI_" #name,
+static const char* prof_call_names[] = { PROF_CALLS(PROF_NAME) };
+#undef PROF_NAME
+
+#define PROF_MAX_REGIONS 32
+#define PROF_NAME_LEN 32
+
+typedef struct {
+    long long calls;
+    long long bytes;
+    double time;
+} ProfStat;
+
+typedef struct {
+    char name[PROF_NAME_LEN];
+    ProfStat stat;
+} ProfRegion;
+
+// id < PROF_NUM_CALLS: MPI call, otherwise region id - PROF_NUM_CALLS
+typedef struct {
+    int id;
+    double start, duration;
+    long long bytes;
+} ProfEvent;
+
+// Per-rank record sent to rank 0 at MPI_Finalize, followed by the regions
+// and events
+typedef struct {
+    ProfStat calls[PROF_NUM_CALLS];
+    double wall;
+    int num_regions;
+    int num_events;
+} ProfHeader;
+
+static ProfHeader prof;
+static ProfRegion prof_regions[PROF_MAX_REGIONS];
+static ProfEvent* prof_events;
+static int prof_event_capacity, prof_max_events, prof_dropped;
+static double prof_t0;
+static int prof_active;
+
+static void prof_record(int id, double start, double end, long long bytes) {
+    ProfStat* stat = id < PROF_NUM_CALLS ? &prof.calls[id] : &prof_regions[id - PROF_NUM_CALLS].stat;
+    stat->calls++;
+    stat->bytes += bytes;
+    stat->time += end - start;
+    if (!prof_active) return;
+    if (prof.num_events == prof_event_capacity) {
+        int grown = prof_event_capacity ? 2 * prof_event_capacity : 4096;
+        if (grown > prof_max_events) grown = prof_max_events;
+        ProfEvent* events = grown > prof_event_capacity
+            ? (ProfEvent*)realloc(prof_events, (size_t)grown * sizeof(ProfEvent)) : NULL;
+        if (!events) {
+            prof_dropped++;
+            return;
+        }
+        prof_events = events;
+        prof_event_capacity = grown;
+    }
+    ProfEvent* ev = &prof_events[prof.num_events++];
+    ev->id = id;
+    ev->start = start - prof_t0;
+    ev->duration = end - start;
+    ev->bytes = bytes;
+}
+
+static long long prof_bytes(long long count, MPI_Datatype type) {
+    int size = 0;
+    if (type != MPI_DATATYPE_NULL) PMPI_Type_size(type, &size);
+    return count * size;
+}
+
+static long long prof_sum_counts(const int* counts, MPI_Comm comm) {
+    int size;
+    long long total = 0;
+    PMPI_Comm_size(comm, &size);
+    for (int r = 0; r < size; r++) total += counts[r];
+    return total;
+}
+
+static int prof_is_root(int root, MPI_Comm comm) {
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    return rank == root;
+}
+
+static int prof_comm_size(MPI_Comm comm) {
+    int size;
+    PMPI_Comm_size(comm, &size);
+    return size;
+}
+
+static void prof_start(void) {
+    const char* max_str = getenv("PMPI_MAX_EVENTS");
+    prof_max_events = max_str ? atoi(max_str) : 1 << 20;
+    if (prof_max_events < 0) prof_max_events = 0;
+    PMPI_Barrier(MPI_COMM_WORLD);
+    prof_t0 = PMPI_Wtime();
+    prof_active = 1;
+}
+
+// Compute region reported by a program (weak reference in prof_regions.h)
+void pmpi_prof_region(const char* name, double start, double end) {
+    int r = 0;
+    while (r < prof.num_regions && strncmp(prof_regions[r].name, name, PROF_NAME_LEN - 1) != 0) r++;
+    if (r == prof.num_regions) {
+        if (r == PROF_MAX_REGIONS) return;
+        snprintf(prof_regions[r].name, PROF_NAME_LEN, "%s", name);
+        prof.num_regions++;
+    }
+    prof_record(PROF_NUM_CALLS + r, start, end, 0);
+}
+
+int MPI_Init(int* argc, char*** argv) {
+    int rc = PMPI_Init(argc, argv);
+    if (rc == MPI_SUCCESS) prof_start();
+    return rc;
+}
+
+int MPI_Init_thread(int* argc, char*** argv, int required, int* provided) {
+    int rc = PMPI_Init_thread(argc, argv, required, provided);
+    if (rc == MPI_SUCCESS) prof_start();
+    return rc;
+}
+
+#define PROF_WRAP(id, bytes, call)                     \
+    do {                                               \
+        double prof_begin = PMPI_Wtime();              \
+        int prof_rc = call;                            \
+        prof_record(id, prof_begin, PMPI_Wtime(), bytes); \
+        return prof_rc;                                \
+    } while (0)
+
+int MPI_Scatter(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    long long bytes = prof_is_root(root, comm)
+        ? prof_bytes((long long)sendcount * prof_comm_size(comm), sendtype)
+        : prof_bytes(recvcount, recvtype);
+    PROF_WRAP(PROF_Scatter, bytes, PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount,
+                                                recvtype, root, comm));
+}
+
+int MPI_Scatterv(const void* sendbuf, const int sendcounts[], const int displs[],
+                 MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype,
+                 int root, MPI_Comm comm) {
+    long long bytes = prof_is_root(root, comm)
+        ? prof_bytes(prof_sum_counts(sendcounts, comm), sendtype)
+        : prof_bytes(recvcount, recvtype);
+    PROF_WRAP(PROF_Scatterv, bytes, PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf,
+                                                  recvcount, recvtype, root, comm));
+}
+
+int MPI_Iscatterv(const void* sendbuf, const int sendcounts[], const int displs[],
+                  MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype,
+                  int root, MPI_Comm comm, MPI_Request* request) {
+    long long bytes = prof_is_root(root, comm)
+        ? prof_bytes(prof_sum_counts(sendcounts, comm), sendtype)
+        : prof_bytes(recvcount, recvtype);
+    PROF_WRAP(PROF_Iscatterv, bytes, PMPI_Iscatterv(sendbuf, sendcounts, displs, sendtype, recvbuf,
+                                                    recvcount, recvtype, root, comm, request));
+}
+
+int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+               int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    long long bytes = prof_is_root(root, comm)
+        ? prof_bytes((long long)recvcount * prof_comm_size(comm), recvtype)
+        : prof_bytes(sendcount, sendtype);
+    PROF_WRAP(PROF_Gather, bytes, PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount,
+                                              recvtype, root, comm));
+}
+
+int MPI_Gatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                const int recvcounts[], const int displs[], MPI_Datatype recvtype, int root,
+                MPI_Comm comm) {
+    long long bytes = prof_is_root(root, comm)
+        ? prof_bytes(prof_sum_counts(recvcounts, comm), recvtype)
+        : prof_bytes(sendcount, sendtype);
+    PROF_WRAP(PROF_Gatherv, bytes, PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts,
+                                                displs, recvtype, root, comm));
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+               int root, MPI_Comm comm) {
+    PROF_WRAP(PROF_Reduce, prof_bytes(count, datatype),
+              PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm));
+}
+
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                  MPI_Comm comm) {
+    PROF_WRAP(PROF_Allreduce, prof_bytes(count, datatype),
+              PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm));
+}
+
+// Offsets of the distributed scan (Task1.c OPERATION=scan, sweep.c)
+int MPI_Exscan(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+               MPI_Comm comm) {
+    PROF_WRAP(PROF_Exscan, prof_bytes(count, datatype),
+              PMPI_Exscan(sendbuf, recvbuf, count, datatype, op, comm));
+}
+
+int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+    PROF_WRAP(PROF_Bcast, prof_bytes(count, datatype),
+              PMPI_Bcast(buffer, count, datatype, root, comm));
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    PROF_WRAP(PROF_Barrier, 0, PMPI_Barrier(comm));
+}
+
+int MPI_Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                  int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+    PROF_WRAP(PROF_Allgather, prof_bytes((long long)recvcount * prof_comm_size(comm), recvtype),
+              PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm));
+}
+
+int MPI_Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request* request) {
+    PROF_WRAP(PROF_Isend, prof_bytes(count, datatype),
+              PMPI_Isend(buf, count, datatype, dest, tag, comm, request));
+}
+
+int MPI_Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request* request) {
+    PROF_WRAP(PROF_Irecv, prof_bytes(count, datatype),
+              PMPI_Irecv(buf, count, datatype, source, tag, comm, request));
+}
+
+// Restart of a persistent collective (common/comm_plan.h); its transfer
+// time shows up in MPI_Wait
+int MPI_Start(MPI_Request* request) {
+    PROF_WRAP(PROF_Start, 0, PMPI_Start(request));
+}
+
+int MPI_Wait(MPI_Request* request, MPI_Status* status) {
+    PROF_WRAP(PROF_Wait, 0, PMPI_Wait(request, status));
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]) {
+    PROF_WRAP(PROF_Waitall, 0, PMPI_Waitall(count, array_of_requests, array_of_statuses));
+}
+
+// Record of rank `r` inside the gathered buffer
+static const ProfHeader* prof_rank_header(const char* all, const int* displs, int r) {
+    return (const ProfHeader*)(all + displs[r]);
+}
+
+static const ProfRegion* prof_rank_regions(const ProfHeader* h) {
+    return (const ProfRegion*)(h + 1);
+}
+
+static const ProfEvent* prof_rank_events(const ProfHeader* h) {
+    return (const ProfEvent*)(prof_rank_regions(h) + h->num_regions);
+}
+
+// Min/avg/max over ranks of one row; `region` names a compute region,
+// NULL selects MPI call `id`
+static void prof_print_row(FILE* out, const char* all, const int* displs, int num_procs,
+                           const char* name, int id, const char* region) {
+    long long calls = 0, bytes = 0;
+    double min = 0, max = 0, sum = 0;
+    for (int r = 0; r < num_procs; r++) {
+        const ProfHeader* h = prof_rank_header(all, displs, r);
+        ProfStat stat = {0, 0, 0.0};
+        if (region) {
+            const ProfRegion* regions = prof_rank_regions(h);
+            for (int k = 0; k < h->num_regions; k++) {
+                if (strcmp(regions[k].name, region) == 0) stat = regions[k].stat;
+            }
+        } else {
+            stat = h->calls[id];
+        }
+        calls += stat.calls;
+        bytes += stat.bytes;
+        sum += stat.time;
+        if (r == 0 || stat.time < min) min = stat.time;
+        if (r == 0 || stat.time > max) max = stat.time;
+    }
+    if (calls == 0) return;
+    double avg = sum / num_procs;
+    fprintf(out, "  %-16s %10lld %14.1f %10.6f %10.6f %10.6f %9.2f\n", name, calls, bytes / 1e6,
+            min, avg, max, avg > 0 ? max / avg : 0.0);
+}
+
+static void prof_print_summary(const char* all, const int* displs, int num_procs) {
+    double wall = 0, mpi_time = 0, region_time = 0;
+    for (int r = 0; r < num_procs; r++) {
+        const ProfHeader* h = prof_rank_header(all, displs, r);
+        const ProfRegion* regions = prof_rank_regions(h);
+        wall += h->wall;
+        for (int id = 0; id < PROF_NUM_CALLS; id++) mpi_time += h->calls[id].time;
+        for (int k = 0; k < h->num_regions; k++) region_time += regions[k].stat.time;
+    }
+    fprintf(stderr, "\n=== PMPI profile (%d ranks, seconds; min/avg/max over ranks) ===\n", num_procs);
+    fprintf(stderr, "  %-16s %10s %14s %10s %10s %10s %9s\n",
+            "call", "calls", "MB (total)", "min", "avg", "max", "max/avg");
+    for (int id = 0; id < PROF_NUM_CALLS; id++) {
+        prof_print_row(stderr, all, displs, num_procs, prof_call_names[id], id, NULL);
+    }
+    // Regions in the order rank 0 first saw them, then any only other ranks have
+    const ProfRegion* root_regions = prof_rank_regions(prof_rank_header(all, displs, 0));
+    int root_count = prof_rank_header(all, displs, 0)->num_regions;
+    for (int k = 0; k < root_count; k++) {
+        prof_print_row(stderr, all, displs, num_procs, root_regions[k].name, 0, root_regions[k].name);
+    }
+    fprintf(stderr, "  Average per rank: wall %.6f s, MPI %.6f s (%.1f%%), compute regions %.6f s (%.1f%%)\n",
+            wall / num_procs, mpi_time / num_procs, wall > 0 ? 100.0 * mpi_time / wall : 0.0,
+            region_time / num_procs, wall > 0 ? 100.0 * region_time / wall : 0.0);
+}
+
+static void prof_write_trace(const char* path, const char* all, const int* displs, int num_procs) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Warning: cannot write PMPI trace to %s\n", path);
+        return;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int r = 0; r < num_procs; r++) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+                "\"args\":{\"name\":\"rank %d\"}}", r ? ",\n" : "", r, r);
+    }
+    for (int r = 0; r < num_procs; r++) {
+        const ProfHeader* h = prof_rank_header(all, displs, r);
+        const ProfRegion* regions = prof_rank_regions(h);
+        const ProfEvent* events = prof_rank_events(h);
+        for (int e = 0; e < h->num_events; e++) {
+            const ProfEvent* ev = &events[e];
+            int mpi = ev->id < PROF_NUM_CALLS;
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%lld}}",
+                    mpi ? prof_call_names[ev->id] : regions[ev->id - PROF_NUM_CALLS].name,
+                    mpi ? "mpi" : "compute", r, ev->start * 1e6, ev->duration * 1e6, ev->bytes);
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+int MPI_Finalize(void) {
+    int rank, num_procs, size;
+    int* sizes = NULL, * displs = NULL;
+    char* all = NULL;
+
+    prof.wall = PMPI_Wtime() - prof_t0;
+    prof_active = 0;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    // Pack header, regions and events into one record per rank
+    size_t record_size = sizeof(ProfHeader) + (size_t)prof.num_regions * sizeof(ProfRegion) +
+                         (size_t)prof.num_events * sizeof(ProfEvent);
+    char* record = (char*)malloc(record_size);
+    if (record) {
+        memcpy(record, &prof, sizeof(ProfHeader));
+        memcpy(record + sizeof(ProfHeader), prof_regions, (size_t)prof.num_regions * sizeof(ProfRegion));
+        memcpy(record + sizeof(ProfHeader) + (size_t)prof.num_regions * sizeof(ProfRegion), prof_events,
+               (size_t)prof.num_events * sizeof(ProfEvent));
+    } else {
+        // Summary only: drop the events
+        record = (char*)&prof;
+        record_size = sizeof(ProfHeader);
+        prof.num_regions = prof.num_events = 0;
+    }
+    size = (int)record_size;
+
+    if (rank == 0) {
+        sizes = (int*)malloc(num_procs * sizeof(int));
+        displs = (int*)malloc(num_procs * sizeof(int));
+    }
+    PMPI_Gather(&size, 1, MPI_INT, sizes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        long long total = 0;
+        for (int r = 0; r < num_procs; r++) {
+            displs[r] = (int)total;
+            total += sizes[r];
+        }
+        all = total <= 2147483647LL ? (char*)malloc((size_t)total) : NULL;
+        if (!all) fprintf(stderr, "Warning: PMPI profile too large to collect\n");
+    }
+    int ok = rank != 0 || all != NULL;
+    PMPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (ok) {
+        PMPI_Gatherv(record, size, MPI_BYTE, all, sizes, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+    }
+
+    if (rank == 0 && ok) {
+        const char* trace_path = getenv("PMPI_TRACE");
+        prof_print_summary(all, displs, num_procs);
+        if (trace_path) {
+            prof_write_trace(trace_path, all, displs, num_procs);
+            fprintf(stderr, "  Timeline written to %s\n", trace_path);
+        }
+    }
+    if (prof_dropped > 0) {
+        fprintf(stderr, "Warning: rank %d dropped %d trace events (PMPI_MAX_EVENTS)\n", rank, prof_dropped);
+    }
+
+    if (record != (char*)&prof) free(record);
+    free(prof_events);
+    free(sizes);
+    free(displs);
+    free(all);
+    return PMPI_Finalize();
+}
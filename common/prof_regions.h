@@ -0,0 +1,15 @@
+#ifndef PROF_REGIONS_H
+#define PROF_REGIONS_H
+
+// Compute regions for the PMPI profiler (common/pmpi_prof.c). The profiler
+// is optional: without it linked in (or LD_PRELOADed) the weak reference
+// stays null and prof_region() does nothing.
+
+void pmpi_prof_region(const char* name, double start, double end) __attribute__((weak));
+
+// Reports [start, end) (MPI_Wtime seconds) as time spent in region `name`
+static inline void prof_region(const char* name, double start, double end) {
+    if (pmpi_prof_region) pmpi_prof_region(name, start, end);
+}
+
+#endif
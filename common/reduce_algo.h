@@ -0,0 +1,234 @@
+#ifndef REDUCE_ALGO_H
+#define REDUCE_ALGO_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+// Selectable algorithms for the final reduction, a few bytes (the sum, the
+// packed Stats) from every rank, where the cost is latency alone:
+//
+//   library             MPI_Reduce, whatever the MPI library picks
+//   binomial            binomial tree to the root, log2(P) rounds
+//   recursive_doubling  allreduce by pairwise exchanges, log2(P) rounds
+//                       (ranks beyond the largest power of two fold in first)
+//   two_level           node mates drop their values into a node-shared
+//                       window, the node leader combines them, and only the
+//                       leaders reduce across nodes (binomial)
+//   iallreduce          MPI_Iallreduce + MPI_Wait
+//
+// The hand-written trees combine with MPI_Reduce_local, so any commutative
+// operation works, user-defined ones included. recvbuf must be valid on
+// every rank: the allreduce variants fill it everywhere, the others only on
+// the root. reduce_select() times every algorithm on the job's own ranks
+// and returns the fastest, the same one on every rank.
+
+#define REDUCE_TAG 0x5244
+
+typedef enum {
+    REDUCE_LIBRARY, REDUCE_BINOMIAL, REDUCE_RECURSIVE_DOUBLING, REDUCE_TWO_LEVEL, REDUCE_IALLREDUCE,
+    REDUCE_NUM_ALGOS
+} ReduceAlgo;
+
+static const char* reduce_algo_names[] = {"library", "binomial", "recursive_doubling", "two_level", "iallreduce"};
+
+typedef struct {
+    MPI_Comm comm;
+    MPI_Comm node_comm;
+    MPI_Comm leader_comm;  // node leaders only, MPI_COMM_NULL elsewhere
+    int rank, num_procs, node_rank, node_size;
+    int* leader_of;     // world rank of each rank's node leader
+    int* leader_index;  // rank in leader_comm of each rank's node leader
+    size_t max_bytes;   // largest payload the hand-written algorithms take
+    char* acc;          // running result of this rank
+    char* tmp;          // incoming partial result
+    char* node_acc;     // node result on the leader
+    MPI_Win win;
+    char* slots;        // 2 x node_size payloads, alternating between calls
+    unsigned long calls;
+} ReduceContext;
+
+// REDUCE_ALGO from the environment: an algorithm, -1 for auto, -2 when the
+// name is unknown; `fallback` when unset
+static inline int reduce_algo_from_env(int fallback) {
+    char* str = getenv("REDUCE_ALGO");
+    if (!str) return fallback;
+    if (strcmp(str, "auto") == 0) return -1;
+    for (int a = 0; a < REDUCE_NUM_ALGOS; a++) {
+        if (strcmp(str, reduce_algo_names[a]) == 0) return a;
+    }
+    return -2;
+}
+
+// Collective over `comm`; payloads up to `max_bytes`
+static inline int reduce_context_init(ReduceContext* ctx, MPI_Comm comm, size_t max_bytes) {
+    MPI_Aint slot_size;
+    int disp_unit;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->comm = comm;
+    ctx->max_bytes = max_bytes > 0 ? max_bytes : 1;
+    MPI_Comm_rank(comm, &ctx->rank);
+    MPI_Comm_size(comm, &ctx->num_procs);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, ctx->rank, MPI_INFO_NULL, &ctx->node_comm);
+    MPI_Comm_rank(ctx->node_comm, &ctx->node_rank);
+    MPI_Comm_size(ctx->node_comm, &ctx->node_size);
+    MPI_Comm_split(comm, ctx->node_rank == 0 ? 0 : MPI_UNDEFINED, ctx->rank, &ctx->leader_comm);
+
+    // Who leads which node, and where that leader sits among the leaders
+    int leader = ctx->rank, index = 0;
+    if (ctx->leader_comm != MPI_COMM_NULL) MPI_Comm_rank(ctx->leader_comm, &index);
+    MPI_Bcast(&leader, 1, MPI_INT, 0, ctx->node_comm);
+    MPI_Bcast(&index, 1, MPI_INT, 0, ctx->node_comm);
+    ctx->leader_of = (int*)malloc(2 * (size_t)ctx->num_procs * sizeof(int));
+    ctx->acc = (char*)malloc(3 * ctx->max_bytes);
+    if (!ctx->leader_of || !ctx->acc) return MPI_ERR_NO_MEM;
+    ctx->leader_index = ctx->leader_of + ctx->num_procs;
+    ctx->tmp = ctx->acc + ctx->max_bytes;
+    ctx->node_acc = ctx->tmp + ctx->max_bytes;
+    MPI_Allgather(&leader, 1, MPI_INT, ctx->leader_of, 1, MPI_INT, comm);
+    MPI_Allgather(&index, 1, MPI_INT, ctx->leader_index, 1, MPI_INT, comm);
+
+    int rc = MPI_Win_allocate_shared(ctx->node_rank == 0 ? (MPI_Aint)(2 * ctx->node_size * ctx->max_bytes) : 0, 1,
+                                     MPI_INFO_NULL, ctx->node_comm, &ctx->slots, &ctx->win);
+    if (rc != MPI_SUCCESS) return rc;
+    MPI_Win_shared_query(ctx->win, 0, &slot_size, &disp_unit, &ctx->slots);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, ctx->win);
+    return MPI_SUCCESS;
+}
+
+static inline void reduce_context_free(ReduceContext* ctx) {
+    MPI_Win_unlock_all(ctx->win);
+    MPI_Win_free(&ctx->win);
+    if (ctx->leader_comm != MPI_COMM_NULL) MPI_Comm_free(&ctx->leader_comm);
+    MPI_Comm_free(&ctx->node_comm);
+    free(ctx->leader_of);
+    free(ctx->acc);
+}
+
+// Binomial tree on `comm`: the value `sendbuf` of every rank combined into
+// recvbuf on `root`
+static inline int reduce_binomial_on(ReduceContext* ctx, const void* sendbuf, void* recvbuf, int count,
+                                     MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm, size_t bytes) {
+    int rank, size, rc = MPI_SUCCESS;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    char* acc = rank == root ? (char*)recvbuf : ctx->acc;
+    if (acc != sendbuf) memcpy(acc, sendbuf, bytes);
+    int vrank = (rank - root + size) % size;
+    for (int mask = 1; mask < size && rc == MPI_SUCCESS; mask <<= 1) {
+        if (vrank & mask) {
+            return MPI_Send(acc, count, type, (vrank - mask + root) % size, REDUCE_TAG, comm);
+        }
+        if (vrank + mask < size) {
+            rc = MPI_Recv(ctx->tmp, count, type, (vrank + mask + root) % size, REDUCE_TAG, comm, MPI_STATUS_IGNORE);
+            if (rc == MPI_SUCCESS) rc = MPI_Reduce_local(ctx->tmp, acc, count, type, op);
+        }
+    }
+    return rc;
+}
+
+// Recursive doubling: every rank ends with the combined value in recvbuf
+static inline int reduce_recursive_doubling(ReduceContext* ctx, const void* sendbuf, void* recvbuf, int count,
+                                            MPI_Datatype type, MPI_Op op, size_t bytes) {
+    int rank = ctx->rank, size = ctx->num_procs, pof2 = 1, rc = MPI_SUCCESS;
+    while (pof2 * 2 <= size) pof2 *= 2;
+    memcpy(recvbuf, sendbuf, bytes);
+    // Ranks pof2.. hand their value to rank - pof2 and wait for the result
+    if (rank >= pof2) {
+        rc = MPI_Send(recvbuf, count, type, rank - pof2, REDUCE_TAG, ctx->comm);
+        if (rc != MPI_SUCCESS) return rc;
+        return MPI_Recv(recvbuf, count, type, rank - pof2, REDUCE_TAG, ctx->comm, MPI_STATUS_IGNORE);
+    }
+    if (rank + pof2 < size) {
+        rc = MPI_Recv(ctx->tmp, count, type, rank + pof2, REDUCE_TAG, ctx->comm, MPI_STATUS_IGNORE);
+        if (rc == MPI_SUCCESS) rc = MPI_Reduce_local(ctx->tmp, recvbuf, count, type, op);
+    }
+    for (int mask = 1; mask < pof2 && rc == MPI_SUCCESS; mask <<= 1) {
+        int partner = rank ^ mask;
+        rc = MPI_Sendrecv(recvbuf, count, type, partner, REDUCE_TAG, ctx->tmp, count, type, partner, REDUCE_TAG,
+                          ctx->comm, MPI_STATUS_IGNORE);
+        if (rc == MPI_SUCCESS) rc = MPI_Reduce_local(ctx->tmp, recvbuf, count, type, op);
+    }
+    if (rc == MPI_SUCCESS && rank + pof2 < size) {
+        rc = MPI_Send(recvbuf, count, type, rank + pof2, REDUCE_TAG, ctx->comm);
+    }
+    return rc;
+}
+
+// Node-shared window within the node, binomial tree across the leaders
+static inline int reduce_two_level(ReduceContext* ctx, const void* sendbuf, void* recvbuf, int count,
+                                   MPI_Datatype type, MPI_Op op, int root, size_t bytes) {
+    int rc = MPI_SUCCESS;
+    // Slots alternate between calls: a rank can only overwrite this parity
+    // after the next call's barrier, which the leader reaches after reading
+    char* slots = ctx->slots + (size_t)(ctx->calls++ & 1) * ctx->node_size * ctx->max_bytes;
+    memcpy(slots + (size_t)ctx->node_rank * ctx->max_bytes, sendbuf, bytes);
+    MPI_Win_sync(ctx->win);
+    MPI_Barrier(ctx->node_comm);
+    MPI_Win_sync(ctx->win);
+    if (ctx->node_rank != 0) {
+        // Only the root, when it is not its node's leader, gets a result
+        if (ctx->rank == root) {
+            return MPI_Recv(recvbuf, count, type, ctx->leader_of[root], REDUCE_TAG, ctx->comm, MPI_STATUS_IGNORE);
+        }
+        return MPI_SUCCESS;
+    }
+    memcpy(ctx->node_acc, slots, bytes);
+    for (int m = 1; m < ctx->node_size && rc == MPI_SUCCESS; m++) {
+        rc = MPI_Reduce_local(slots + (size_t)m * ctx->max_bytes, ctx->node_acc, count, type, op);
+    }
+    if (rc != MPI_SUCCESS) return rc;
+    int root_leader = ctx->leader_of[root];
+    char* result = ctx->rank == root ? (char*)recvbuf : ctx->acc;
+    rc = reduce_binomial_on(ctx, ctx->node_acc, ctx->rank == root_leader ? result : NULL, count, type, op,
+                            ctx->leader_index[root], ctx->leader_comm, bytes);
+    if (rc == MPI_SUCCESS && ctx->rank == root_leader && root != root_leader) {
+        rc = MPI_Send(result, count, type, root, REDUCE_TAG, ctx->comm);
+    }
+    return rc;
+}
+
+// One reduction of `count` elements of `type` to `root`
+static inline int reduce_run(ReduceContext* ctx, ReduceAlgo algo, const void* sendbuf, void* recvbuf, int count,
+                             MPI_Datatype type, MPI_Op op, int root) {
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(type, &lb, &extent);
+    size_t bytes = (size_t)count * (size_t)extent;
+    if (algo == REDUCE_LIBRARY) return MPI_Reduce(sendbuf, recvbuf, count, type, op, root, ctx->comm);
+    if (algo == REDUCE_IALLREDUCE) {
+        MPI_Request request;
+        int rc = MPI_Iallreduce(sendbuf, recvbuf, count, type, op, ctx->comm, &request);
+        return rc == MPI_SUCCESS ? MPI_Wait(&request, MPI_STATUS_IGNORE) : rc;
+    }
+    if (bytes > ctx->max_bytes) return MPI_ERR_COUNT;
+    if (algo == REDUCE_BINOMIAL) {
+        return reduce_binomial_on(ctx, sendbuf, recvbuf, count, type, op, root, ctx->comm, bytes);
+    }
+    if (algo == REDUCE_RECURSIVE_DOUBLING) {
+        return reduce_recursive_doubling(ctx, sendbuf, recvbuf, count, type, op, bytes);
+    }
+    return reduce_two_level(ctx, sendbuf, recvbuf, count, type, op, root, bytes);
+}
+
+// Times `reps` back-to-back runs of every algorithm (slowest rank, after two
+// untimed ones) into times[REDUCE_NUM_ALGOS] and returns the fastest. The
+// times come from an MPI_Allreduce, so every rank picks the same one.
+static inline ReduceAlgo reduce_select(ReduceContext* ctx, const void* sendbuf, void* recvbuf, int count,
+                                       MPI_Datatype type, MPI_Op op, int root, int reps, double* times) {
+    double local[REDUCE_NUM_ALGOS];
+    ReduceAlgo best = REDUCE_LIBRARY;
+    for (int a = 0; a < REDUCE_NUM_ALGOS; a++) {
+        for (int r = 0; r < 2; r++) reduce_run(ctx, (ReduceAlgo)a, sendbuf, recvbuf, count, type, op, root);
+        MPI_Barrier(ctx->comm);
+        double start = MPI_Wtime();
+        for (int r = 0; r < reps; r++) reduce_run(ctx, (ReduceAlgo)a, sendbuf, recvbuf, count, type, op, root);
+        local[a] = (MPI_Wtime() - start) / (reps > 0 ? reps : 1);
+    }
+    MPI_Allreduce(local, times, REDUCE_NUM_ALGOS, MPI_DOUBLE, MPI_MAX, ctx->comm);
+    for (int a = 1; a < REDUCE_NUM_ALGOS; a++) {
+        if (times[a] < times[best]) best = (ReduceAlgo)a;
+    }
+    return best;
+}
+
+#endif
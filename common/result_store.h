@@ -0,0 +1,98 @@
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "distribution.h"
+#include "large_count.h"
+#include "arrayfile.h"
+
+// Distributed result arrays. Every rank keeps its slice of a result (as laid
+// out by a Distribution) and exposes it in an MPI window, so any rank can
+// fetch an arbitrary index range with one-sided MPI_Get without the owners
+// taking part, and no rank ever holds the whole array. Together with
+// arrayfile_checksum_all() (verification) and array_output_write() (one
+// array file written in parallel) this replaces gathering to rank 0.
+//
+// Environment (read by result_mode_from_env):
+//   RESULT_MODE    distributed (default): results stay on their ranks;
+//                  gather: collected on rank 0 (needs the full arrays there);
+//                  file: written with MPI-IO as RESULT_PREFIX_<name>.arr
+//   RESULT_PREFIX  path prefix of the result files (default "result")
+//   RESULT_RANGE   first:count of the elements to fetch and print
+//                  (default 0:5)
+
+typedef enum { RESULT_DISTRIBUTED, RESULT_GATHER, RESULT_FILE } ResultMode;
+
+typedef struct {
+    MPI_Win win;
+    const Distribution* dist;
+    MPI_Datatype type;
+    size_t elem_size;
+} ResultArray;
+
+// -1 for an unknown RESULT_MODE
+static inline int result_mode_from_env(void) {
+    const char* str = getenv("RESULT_MODE");
+    if (!str || strcmp(str, "distributed") == 0) return RESULT_DISTRIBUTED;
+    if (strcmp(str, "gather") == 0) return RESULT_GATHER;
+    if (strcmp(str, "file") == 0) return RESULT_FILE;
+    return -1;
+}
+
+static inline const char* result_mode_name(int mode) {
+    return mode == RESULT_GATHER ? "gather" : mode == RESULT_FILE ? "file" : "distributed";
+}
+
+// RESULT_RANGE clipped to [0, total)
+static inline void result_range_from_env(long long total, long long* first, long long* count) {
+    const char* str = getenv("RESULT_RANGE");
+    long long f = 0, n = 5;
+    if (str && sscanf(str, "%lld:%lld", &f, &n) < 1) f = 0;
+    if (f < 0) f = 0;
+    if (f > total) f = total;
+    if (n < 0) n = 0;
+    if (n > total - f) n = total - f;
+    *first = f;
+    *count = n;
+}
+
+// Collective over `comm`: exposes this rank's slice `local` of `dist`
+static inline int result_array_init(ResultArray* r, void* local, const Distribution* dist, MPI_Datatype type,
+                                    MPI_Comm comm) {
+    r->dist = dist;
+    r->type = type;
+    r->elem_size = (size_t)large_count_extent(type);
+    return MPI_Win_create(local, (MPI_Aint)((size_t)dist->local_count * r->elem_size), (int)r->elem_size,
+                          MPI_INFO_NULL, comm, &r->win);
+}
+
+// Elements [first, first + count) into `out` from whichever ranks own them.
+// Not collective: passive target, one shared lock per owner, at most
+// LARGE_COUNT_BLOCK elements per MPI_Get.
+static inline int result_array_get(const ResultArray* r, long long first, long long count, void* out) {
+    const Distribution* d = r->dist;
+    int rc = MPI_SUCCESS;
+    for (int owner = 0; owner < d->num_procs && rc == MPI_SUCCESS; owner++) {
+        long long begin = first > d->displs[owner] ? first : d->displs[owner];
+        long long end = first + count < d->displs[owner] + d->counts[owner] ? first + count
+                                                                            : d->displs[owner] + d->counts[owner];
+        if (begin >= end) continue;
+        MPI_Win_lock(MPI_LOCK_SHARED, owner, 0, r->win);
+        for (long long at = begin; at < end && rc == MPI_SUCCESS; at += LARGE_COUNT_BLOCK) {
+            long long n = end - at < LARGE_COUNT_BLOCK ? end - at : LARGE_COUNT_BLOCK;
+            rc = MPI_Get((char*)out + (size_t)(at - first) * r->elem_size, (int)n, r->type, owner,
+                         (MPI_Aint)(at - d->displs[owner]), (int)n, r->type, r->win);
+        }
+        MPI_Win_unlock(owner, r->win);
+    }
+    return rc;
+}
+
+// Collective over the window's communicator
+static inline void result_array_free(ResultArray* r) {
+    MPI_Win_free(&r->win);
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+#include "narrow_sum.h"
+#include "threads.h"
+
+// Inclusive prefix sum (scan) of int32, uint16 or uint8 elements into
+// int64 running totals. It runs in two passes so it splits across threads
+// and ranks: pass 1 scans every piece from zero and returns its total, the
+// totals of the pieces before are combined (MPI_Exscan across ranks, a
+// loop across threads), and pass 2 adds that offset to the whole piece.
+// The SIMD kernels widen 4 (AVX2) or 8 (AVX-512) elements to int64 lanes,
+// scan them in the register with log2(lanes) shift-and-add steps and carry
+// the last lane into the next vector.
+//
+// Environment:
+//   SCAN_KERNEL  forces the variant: scalar, avx2 or avx512
+
+typedef long long (*ScanFn)(const void* in, ElementType t, long long* out, size_t n, long long carry);
+typedef void (*ScanAddFn)(long long* out, size_t n, long long offset);
+
+// Running totals of n elements starting from `carry`; returns the last one
+static inline long long scan_scalar(const void* in, ElementType t, long long* out, size_t n, long long carry) {
+    if (t == ELEMENT_UINT8) {
+        const uint8_t* v = (const uint8_t*)in;
+        for (size_t i = 0; i < n; i++) out[i] = carry += v[i];
+    } else if (t == ELEMENT_UINT16) {
+        const uint16_t* v = (const uint16_t*)in;
+        for (size_t i = 0; i < n; i++) out[i] = carry += v[i];
+    } else {
+        const int* v = (const int*)in;
+        for (size_t i = 0; i < n; i++) out[i] = carry += v[i];
+    }
+    return carry;
+}
+
+static inline void scan_add_scalar(long long* out, size_t n, long long offset) {
+    for (size_t i = 0; i < n; i++) out[i] += offset;
+}
+
+#ifdef SCAN_X86
+
+// Scans the four lanes of x, adds the carry (broadcast) and stores them;
+// returns the last lane broadcast as the next carry
+__attribute__((target("avx2")))
+static inline __m256i scan_step_avx2(__m256i x, __m256i carry, long long* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x90), zero, 0x03));
+    x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x40), zero, 0x0F));
+    x = _mm256_add_epi64(x, carry);
+    _mm256_storeu_si256((__m256i*)out, x);
+    return _mm256_permute4x64_epi64(x, 0xFF);
+}
+
+__attribute__((target("avx2")))
+static inline long long scan_avx2(const void* in, ElementType t, long long* out, size_t n, long long carry) {
+    __m256i c = _mm256_set1_epi64x(carry);
+    size_t i = 0;
+    if (t == ELEMENT_UINT8) {
+        const uint8_t* v = (const uint8_t*)in;
+        for (; i + 4 <= n; i += 4) {
+            int bytes;
+            memcpy(&bytes, v + i, sizeof(bytes));
+            c = scan_step_avx2(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes)), c, out + i);
+        }
+    } else if (t == ELEMENT_UINT16) {
+        const uint16_t* v = (const uint16_t*)in;
+        for (; i + 4 <= n; i += 4) {
+            c = scan_step_avx2(_mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i*)(v + i))), c, out + i);
+        }
+    } else {
+        const int* v = (const int*)in;
+        for (; i + 4 <= n; i += 4) {
+            c = scan_step_avx2(_mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(v + i))), c, out + i);
+        }
+    }
+    carry = _mm_cvtsi128_si64(_mm256_castsi256_si128(c));
+    return scan_scalar((const char*)in + i * element_size(t), t, out + i, n - i, carry);
+}
+
+__attribute__((target("avx2")))
+static inline void scan_add_avx2(long long* out, size_t n, long long offset) {
+    const __m256i add = _mm256_set1_epi64x(offset);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i* p = (__m256i*)(out + i);
+        _mm256_storeu_si256(p, _mm256_add_epi64(_mm256_loadu_si256(p), add));
+    }
+    scan_add_scalar(out + i, n - i, offset);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i scan_step_avx512(__m512i x, __m512i carry, long long* out) {
+    const __m512i zero = _mm512_setzero_si512();
+    x = _mm512_add_epi64(x, _mm512_alignr_epi64(x, zero, 7));
+    x = _mm512_add_epi64(x, _mm512_alignr_epi64(x, zero, 6));
+    x = _mm512_add_epi64(x, _mm512_alignr_epi64(x, zero, 4));
+    x = _mm512_add_epi64(x, carry);
+    _mm512_storeu_si512(out, x);
+    return _mm512_permutexvar_epi64(_mm512_set1_epi64(7), x);
+}
+
+__attribute__((target("avx512f")))
+static inline long long scan_avx512(const void* in, ElementType t, long long* out, size_t n, long long carry) {
+    __m512i c = _mm512_set1_epi64(carry);
+    size_t i = 0;
+    if (t == ELEMENT_UINT8) {
+        const uint8_t* v = (const uint8_t*)in;
+        for (; i + 8 <= n; i += 8) {
+            c = scan_step_avx512(_mm512_cvtepu8_epi64(_mm_loadl_epi64((const __m128i*)(v + i))), c, out + i);
+        }
+    } else if (t == ELEMENT_UINT16) {
+        const uint16_t* v = (const uint16_t*)in;
+        for (; i + 8 <= n; i += 8) {
+            c = scan_step_avx512(_mm512_cvtepu16_epi64(_mm_loadu_si128((const __m128i*)(v + i))), c, out + i);
+        }
+    } else {
+        const int* v = (const int*)in;
+        for (; i + 8 <= n; i += 8) {
+            c = scan_step_avx512(_mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(v + i))), c, out + i);
+        }
+    }
+    carry = _mm_cvtsi128_si64(_mm512_castsi512_si128(c));
+    return scan_scalar((const char*)in + i * element_size(t), t, out + i, n - i, carry);
+}
+
+__attribute__((target("avx512f")))
+static inline void scan_add_avx512(long long* out, size_t n, long long offset) {
+    const __m512i add = _mm512_set1_epi64(offset);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_si512(out + i, _mm512_add_epi64(_mm512_loadu_si512(out + i), add));
+    }
+    scan_add_scalar(out + i, n - i, offset);
+}
+
+#endif
+
+typedef struct {
+    const char* name;
+    ScanFn scan;
+    ScanAddFn add;
+} ScanKernel;
+
+// Widest variant this CPU supports, or SCAN_KERNEL
+static inline ScanKernel scan_kernel_select(void) {
+    ScanKernel available[3] = {{"scalar", scan_scalar, scan_add_scalar}};
+    int count = 1;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) available[count++] = (ScanKernel){"avx2", scan_avx2, scan_add_avx2};
+    if (__builtin_cpu_supports("avx512f")) {
+        available[count++] = (ScanKernel){"avx512", scan_avx512, scan_add_avx512};
+    }
+#endif
+    const char* forced = getenv("SCAN_KERNEL");
+    for (int i = 0; forced && i < count; i++) {
+        if (strcmp(forced, available[i].name) == 0) return available[i];
+    }
+    return available[count - 1];
+}
+
+static inline const ScanKernel* scan_kernel(void) {
+    static ScanKernel selected;
+    if (!selected.scan) selected = scan_kernel_select();
+    return &selected;
+}
+
+// Single pass over the whole array: the sequential baseline
+static inline long long scan_elements(const void* in, ElementType t, long long* out, size_t n) {
+    return scan_kernel()->scan(in, t, out, n, 0);
+}
+
+// Per-thread totals of pass 1, needed again by pass 2
+typedef struct {
+    int threads;
+    long long* totals;
+} ScanState;
+
+static inline int scan_state_init(ScanState* s, int threads) {
+    s->threads = threads > 1 ? threads : 1;
+    s->totals = (long long*)calloc((size_t)s->threads, sizeof(long long));
+    return s->totals ? 0 : -1;
+}
+
+static inline void scan_state_free(ScanState* s) {
+    free(s->totals);
+    s->totals = NULL;
+}
+
+static inline int scan_thread_num(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// Pass 1: every thread scans its static range of the n elements from
+// zero; returns the total of all n
+static inline long long scan_local(ScanState* s, const void* in, ElementType t, long long* out, size_t n) {
+    const ScanKernel* k = scan_kernel();  // resolve the dispatch before the region
+    long long total = 0;
+    memset(s->totals, 0, (size_t)s->threads * sizeof(long long));
+    if (s->threads == 1) return s->totals[0] = k->scan(in, t, out, n, 0);
+#pragma omp parallel num_threads(s->threads)
+    {
+        size_t begin, end;
+        thread_range(n, &begin, &end);
+        s->totals[scan_thread_num()] = k->scan((const char*)in + begin * element_size(t), t, out + begin,
+                                               end - begin, 0);
+    }
+    for (int i = 0; i < s->threads; i++) total += s->totals[i];
+    return total;
+}
+
+// Pass 2: adds `offset` (the total of everything before these n elements)
+// and the totals of the threads before each range. Same split as pass 1.
+static inline void scan_add_offset(const ScanState* s, long long* out, size_t n, long long offset) {
+    const ScanKernel* k = scan_kernel();
+    if (s->threads == 1) {
+        if (offset != 0) k->add(out, n, offset);
+        return;
+    }
+#pragma omp parallel num_threads(s->threads)
+    {
+        size_t begin, end;
+        long long range_offset = offset;
+        thread_range(n, &begin, &end);
+        for (int i = 0; i < scan_thread_num(); i++) range_offset += s->totals[i];
+        if (range_offset != 0) k->add(out + begin, end - begin, range_offset);
+    }
+}
+
+// Bytes read and written per second by a scan of n elements of type `t`
+static inline double scan_gbs(size_t n, ElementType t, double seconds) {
+    return seconds > 0 ? (double)n * (element_size(t) + sizeof(long long)) / seconds / 1e9 : 0.0;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef SHARED_ARRAY_H
+#define SHARED_ARRAY_H
+
+#include <stdlib.h>
+#include <mpi.h>
+#include "large_count.h"
+
+// Zero-copy intra-node distribution. The ranks of a node (MPI_Comm_split_type
+// SHARED) share one segment from MPI_Win_allocate_shared owned by the node
+// leader, and every rank reads its slice in place instead of receiving a copy.
+// The root's node holds the whole array, so the root fills it directly and its
+// node mates need no communication at all. Every other node's segment holds
+// only its members' slices; the root sends those once to the node leader, so
+// inter-node traffic goes through one rank per node.
+
+typedef struct {
+    MPI_Comm comm;
+    MPI_Comm node_comm;
+    MPI_Datatype type;
+    MPI_Win win;
+    int rank, num_procs, node_rank, node_size, on_root_node;
+    int type_size;
+    const long long* counts;  // per world rank, as for MPI_Scatterv
+    const long long* displs;
+    int* leader_of;         // world rank of each rank's node leader
+    int* members;           // world ranks of this node, in node order
+    size_t* member_offset;  // element offset of each member's slice in the segment
+    char* base;             // node segment
+    void* local;            // this rank's slice
+    MPI_Request* requests;    // two per rank (large_isend/large_irecv)
+} SharedArray;
+
+// Collective over `comm`; `root` is rank 0 of `comm`.
+static inline int shared_array_create(SharedArray* sa, long long total_count, const long long* counts,
+                                      const long long* displs, MPI_Datatype type, MPI_Comm comm) {
+    MPI_Aint segment_size;
+    int disp_unit;
+    size_t segment_count = 0;
+
+    sa->comm = comm;
+    sa->type = type;
+    sa->counts = counts;
+    sa->displs = displs;
+    MPI_Comm_rank(comm, &sa->rank);
+    MPI_Comm_size(comm, &sa->num_procs);
+    MPI_Type_size(type, &sa->type_size);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, sa->rank, MPI_INFO_NULL, &sa->node_comm);
+    MPI_Comm_rank(sa->node_comm, &sa->node_rank);
+    MPI_Comm_size(sa->node_comm, &sa->node_size);
+
+    // Who leads which node, and who lives on mine
+    int leader = sa->rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, sa->node_comm);
+    sa->leader_of = (int*)malloc(sa->num_procs * sizeof(int));
+    sa->members = (int*)malloc(sa->node_size * sizeof(int));
+    sa->member_offset = (size_t*)malloc(sa->node_size * sizeof(size_t));
+    sa->requests = (MPI_Request*)malloc(2 * sa->num_procs * sizeof(MPI_Request));
+    if (!sa->leader_of || !sa->members || !sa->member_offset || !sa->requests) return -1;
+    MPI_Allgather(&leader, 1, MPI_INT, sa->leader_of, 1, MPI_INT, comm);
+    MPI_Allgather(&sa->rank, 1, MPI_INT, sa->members, 1, MPI_INT, sa->node_comm);
+    sa->on_root_node = sa->leader_of[0] == leader;
+
+    // Segment layout: the full array on the root's node, packed slices elsewhere
+    for (int m = 0; m < sa->node_size; m++) {
+        int member = sa->members[m];
+        sa->member_offset[m] = sa->on_root_node ? (size_t)displs[member] : segment_count;
+        segment_count += (size_t)counts[member];
+    }
+    if (sa->on_root_node) segment_count = (size_t)total_count;
+
+    int rc = MPI_Win_allocate_shared(sa->node_rank == 0 ? (MPI_Aint)(segment_count * sa->type_size) : 0,
+                                     sa->type_size, MPI_INFO_NULL, sa->node_comm, &sa->base, &sa->win);
+    if (rc != MPI_SUCCESS) return rc;
+    MPI_Win_shared_query(sa->win, 0, &segment_size, &disp_unit, &sa->base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, sa->win);
+    sa->local = sa->base + sa->member_offset[sa->node_rank] * sa->type_size;
+    return MPI_SUCCESS;
+}
+
+// Full array on the root (the root's node segment), NULL elsewhere.
+static inline void* shared_array_full(const SharedArray* sa) {
+    return sa->rank == 0 ? sa->base : NULL;
+}
+
+static inline void* shared_array_local(const SharedArray* sa) {
+    return sa->local;
+}
+
+// Makes the root's current contents visible to every rank. Only slices owned
+// by other nodes cross the network; everything else is a memory fence.
+static inline int shared_array_distribute(SharedArray* sa) {
+    int nreq = 0;
+    if (sa->rank == 0) {
+        for (int r = 0; r < sa->num_procs; r++) {
+            if (sa->leader_of[r] == sa->leader_of[0] || sa->counts[r] == 0) continue;
+            large_isend(sa->base + (size_t)sa->displs[r] * sa->type_size, sa->counts[r], sa->type,
+                        sa->leader_of[r], r, sa->comm, sa->requests, &nreq);
+        }
+    } else if (sa->node_rank == 0 && !sa->on_root_node) {
+        for (int m = 0; m < sa->node_size; m++) {
+            int member = sa->members[m];
+            if (sa->counts[member] == 0) continue;
+            large_irecv(sa->base + sa->member_offset[m] * sa->type_size, sa->counts[member], sa->type,
+                        0, member, sa->comm, sa->requests, &nreq);
+        }
+    }
+    int rc = MPI_Waitall(nreq, sa->requests, MPI_STATUSES_IGNORE);
+    MPI_Win_sync(sa->win);
+    MPI_Barrier(sa->node_comm);
+    MPI_Win_sync(sa->win);
+    return rc;
+}
+
+static inline void shared_array_free(SharedArray* sa) {
+    MPI_Win_unlock_all(sa->win);
+    MPI_Win_free(&sa->win);
+    MPI_Comm_free(&sa->node_comm);
+    free(sa->leader_of);
+    free(sa->members);
+    free(sa->member_offset);
+    free(sa->requests);
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "narrow_sum.h"
+
+// Fused statistics: count, min, max, argmax (first index of the maximum),
+// mean and variance of an array in one pass over memory, combined across
+// threads and ranks with Chan et al.'s pairwise update, so the ranks need
+// a single MPI_Reduce with a user-defined MPI_Op on the packed struct.
+//
+// STATS_DEFINE(name, type, acc, lo, hi) stamps out the kernel for one
+// element type (a C stand-in for a template specialized on the type),
+// with `lo` and `hi` the identities of min and max: the array is walked in
+// L1-sized blocks; the first loop over a block gathers the sum (exact in
+// `acc` for integers, __int128 for int64 where the compiler has it), min
+// and max, the second one the squared deviations from the block mean while
+// the block is still in cache, and the block is merged into the running
+// result. The deviations are taken in double, so int64 variances past 2^53
+// are approximate.
+//
+// NaN elements are skipped, as by numpy's nan* functions: they are not
+// counted and leave min, max, argmax, mean and variance alone. An array of
+// only NaN has count 0.
+
+#define STATS_BLOCK 2048  // elements per block, 16 kB of doubles
+
+typedef struct {
+    long long count;
+    long long argmax;  // global index, -1 when empty
+    double min, max;
+    double mean;
+    double m2;  // sum of squared deviations from the mean
+} Stats;
+
+static inline void stats_init(Stats* s) {
+    s->count = 0;
+    s->argmax = -1;
+    s->min = DBL_MAX;
+    s->max = -DBL_MAX;
+    s->mean = 0.0;
+    s->m2 = 0.0;
+}
+
+// a = a + b; the first index of the maximum wins a tie
+static inline void stats_merge(Stats* a, const Stats* b) {
+    if (b->count == 0) return;
+    if (a->count == 0) {
+        *a = *b;
+        return;
+    }
+    double n = (double)(a->count + b->count), delta = b->mean - a->mean;
+    a->mean += delta * (double)b->count / n;
+    a->m2 += b->m2 + delta * delta * (double)a->count * (double)b->count / n;
+    a->count += b->count;
+    if (b->min < a->min) a->min = b->min;
+    if (b->max > a->max || (b->max == a->max && b->argmax < a->argmax)) {
+        a->max = b->max;
+        a->argmax = b->argmax;
+    }
+}
+
+// Population variance
+static inline double stats_variance(const Stats* s) {
+    return s->count > 0 ? s->m2 / (double)s->count : 0.0;
+}
+
+// v[i] == v[i] is false only for NaN, and always true (folded away) for
+// the integer types
+#define STATS_DEFINE(name, type, acc, type_lo, type_hi)                                   \
+    static inline void stats_##name(const type* x, size_t n, long long first, Stats* s) { \
+        for (size_t b = 0; b < n; b += STATS_BLOCK) {                                     \
+            size_t len = n - b < STATS_BLOCK ? n - b : STATS_BLOCK;                       \
+            const type* v = x + b;                                                        \
+            acc sum = 0;                                                                  \
+            long long count = 0;                                                          \
+            type lo = type_lo, hi = type_hi;                                              \
+            _Pragma("omp simd reduction(+:sum,count) reduction(min:lo) reduction(max:hi)") \
+            for (size_t i = 0; i < len; i++) {                                            \
+                int valid = v[i] == v[i];                                                 \
+                sum += valid ? (acc)v[i] : 0;                                             \
+                count += valid;                                                           \
+                lo = v[i] < lo ? v[i] : lo;                                               \
+                hi = v[i] > hi ? v[i] : hi;                                               \
+            }                                                                             \
+            if (count == 0) continue;                                                     \
+            Stats block;                                                                  \
+            block.count = count;                                                          \
+            block.mean = (double)sum / (double)count;                                     \
+            block.min = (double)lo;                                                       \
+            block.max = (double)hi;                                                       \
+            double m2 = 0.0, mean = block.mean;                                           \
+            _Pragma("omp simd reduction(+:m2)")                                           \
+            for (size_t i = 0; i < len; i++) {                                            \
+                double d = v[i] == v[i] ? (double)v[i] - mean : 0.0;                      \
+                m2 += d * d;                                                              \
+            }                                                                             \
+            block.m2 = m2;                                                                \
+            /* Only a block that can hold the first maximum is searched */              \
+            block.argmax = LLONG_MAX;                                                     \
+            if (s->count == 0 || block.max > s->max) {                                    \
+                size_t i = 0;                                                             \
+                while (i < len && v[i] != hi) i++;                                        \
+                block.argmax = first + (long long)(b + i);                                \
+            }                                                                             \
+            stats_merge(s, &block);                                                       \
+        }                                                                                 \
+    }
+
+#ifdef __SIZEOF_INT128__
+#define STATS_I64_ACC __int128
+#else
+#define STATS_I64_ACC long double
+#endif
+
+STATS_DEFINE(u8, uint8_t, long long, UINT8_MAX, 0)
+STATS_DEFINE(u16, uint16_t, long long, UINT16_MAX, 0)
+STATS_DEFINE(i32, int32_t, long long, INT32_MAX, INT32_MIN)
+STATS_DEFINE(i64, int64_t, STATS_I64_ACC, INT64_MAX, INT64_MIN)
+STATS_DEFINE(f32, float, double, INFINITY, -INFINITY)
+STATS_DEFINE(f64, double, double, INFINITY, -INFINITY)
+
+// Every type with a kernel. The programs only hold the ElementType ones;
+// kernel_bench.c checks the others.
+typedef enum { STATS_U8, STATS_U16, STATS_I32, STATS_I64, STATS_F32, STATS_F64 } StatsType;
+
+static inline size_t stats_type_size(StatsType t) {
+    static const size_t sizes[] = {1, 2, 4, 8, 4, 8};
+    return sizes[t];
+}
+
+static inline StatsType stats_type_of(ElementType t) {
+    return t == ELEMENT_UINT8 ? STATS_U8 : t == ELEMENT_UINT16 ? STATS_U16 : STATS_I32;
+}
+
+// Stats of n elements of type `t`; `first` is the global index of x[0]
+static inline void stats_typed(const void* x, size_t n, StatsType t, long long first, Stats* s) {
+    switch (t) {
+    case STATS_U8: stats_u8((const uint8_t*)x, n, first, s); break;
+    case STATS_U16: stats_u16((const uint16_t*)x, n, first, s); break;
+    case STATS_I32: stats_i32((const int32_t*)x, n, first, s); break;
+    case STATS_I64: stats_i64((const int64_t*)x, n, first, s); break;
+    case STATS_F32: stats_f32((const float*)x, n, first, s); break;
+    case STATS_F64: stats_f64((const double*)x, n, first, s); break;
+    }
+}
+
+// Stats of the elements of type `t` (see narrow_sum.h)
+static inline void stats_elements(const void* x, size_t n, ElementType t, long long first, Stats* s) {
+    stats_typed(x, n, stats_type_of(t), first, s);
+}
+
+// The static thread split of the sums; the partial results are merged in
+// thread order
+static inline void stats_elements_threaded(const void* x, size_t n, ElementType t, long long first, int threads,
+                                           Stats* s) {
+    if (threads <= 1) {
+        stats_elements(x, n, t, first, s);
+        return;
+    }
+    Stats* parts = (Stats*)malloc((size_t)threads * sizeof(Stats));
+    if (!parts) {
+        stats_elements(x, n, t, first, s);
+        return;
+    }
+#pragma omp parallel num_threads(threads)
+    {
+        size_t begin, end;
+        int id = 0;
+#ifdef _OPENMP
+        id = omp_get_thread_num();
+#endif
+        thread_range(n, &begin, &end);
+        stats_init(&parts[id]);
+        stats_elements((const char*)x + begin * element_size(t), end - begin, t, first + (long long)begin,
+                       &parts[id]);
+    }
+    for (int i = 0; i < threads; i++) stats_merge(s, &parts[i]);
+    free(parts);
+}
+
+// Only for MPI programs, which include <mpi.h> first (see narrow_sum.h)
+#ifdef MPI_VERSION
+
+// MPI datatype of Stats and the MPI_Op that merges it
+typedef struct {
+    MPI_Datatype type;
+    MPI_Op op;
+} StatsMpi;
+
+static void stats_mpi_merge(void* in, void* inout, int* len, MPI_Datatype* type) {
+    (void)type;
+    for (int i = 0; i < *len; i++) stats_merge((Stats*)inout + i, (const Stats*)in + i);
+}
+
+static inline void stats_mpi_init(StatsMpi* m) {
+    int lengths[2] = {2, 4};
+    MPI_Aint displs[2] = {offsetof(Stats, count), offsetof(Stats, min)};
+    MPI_Datatype types[2] = {MPI_LONG_LONG, MPI_DOUBLE}, packed;
+    MPI_Type_create_struct(2, lengths, displs, types, &packed);
+    MPI_Type_create_resized(packed, 0, sizeof(Stats), &m->type);
+    MPI_Type_free(&packed);
+    MPI_Type_commit(&m->type);
+    MPI_Op_create(stats_mpi_merge, 1, &m->op);
+}
+
+static inline void stats_mpi_free(StatsMpi* m) {
+    MPI_Op_free(&m->op);
+    MPI_Type_free(&m->type);
+}
+
+#endif
+
+// 1 when two results agree: count, min, max and argmax exactly, mean and
+// variance to a relative `tolerance` (the merge order differs)
+static inline int stats_match(const Stats* a, const Stats* b, double tolerance) {
+    double scale_mean = fabs(a->mean) > 1.0 ? fabs(a->mean) : 1.0;
+    double var_a = stats_variance(a), var_b = stats_variance(b);
+    double scale_var = var_a > 1.0 ? var_a : 1.0;
+    return a->count == b->count && a->min == b->min && a->max == b->max && a->argmax == b->argmax &&
+           fabs(a->mean - b->mean) <= tolerance * scale_mean && fabs(var_a - var_b) <= tolerance * scale_var;
+}
+
+#endif
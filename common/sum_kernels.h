@@ -0,0 +1,139 @@
+#ifndef SUM_KERNELS_H
+#define SUM_KERNELS_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUM_KERNELS_X86 1
+#endif
+
+// Widening int32 -> int64 sum kernels. Each SIMD variant keeps four
+// independent accumulators so the adds are not serialized on one register.
+// sum_i32() picks the widest variant the CPU supports on first use.
+
+typedef long long (*SumI32Fn)(const int* arr, size_t n);
+
+static inline long long sum_i32_scalar(const int* arr, size_t n) {
+    long long s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += arr[i];
+        s1 += arr[i + 1];
+        s2 += arr[i + 2];
+        s3 += arr[i + 3];
+    }
+    for (; i < n; i++) s0 += arr[i];
+    return s0 + s1 + s2 + s3;
+}
+
+#ifdef SUM_KERNELS_X86
+
+// SSE2 has no pmovsxdq, so the sign is extended by interleaving each
+// value with its own sign mask.
+__attribute__((target("sse2")))
+static inline __m128i sum_widen_add_sse2(__m128i acc_lo, __m128i* acc_hi, __m128i v) {
+    __m128i sign = _mm_srai_epi32(v, 31);
+    *acc_hi = _mm_add_epi64(*acc_hi, _mm_unpackhi_epi32(v, sign));
+    return _mm_add_epi64(acc_lo, _mm_unpacklo_epi32(v, sign));
+}
+
+__attribute__((target("sse2")))
+static inline long long sum_i32_sse2(const int* arr, size_t n) {
+    __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+    __m128i a2 = _mm_setzero_si128(), a3 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(arr + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(arr + i + 4));
+        a0 = sum_widen_add_sse2(a0, &a1, v0);
+        a2 = sum_widen_add_sse2(a2, &a3, v1);
+    }
+    __m128i acc = _mm_add_epi64(_mm_add_epi64(a0, a1), _mm_add_epi64(a2, a3));
+    long long lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1] + sum_i32_scalar(arr + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline long long sum_i32_avx2(const int* arr, size_t n) {
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        a0 = _mm256_add_epi64(a0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(arr + i))));
+        a1 = _mm256_add_epi64(a1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(arr + i + 4))));
+        a2 = _mm256_add_epi64(a2, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(arr + i + 8))));
+        a3 = _mm256_add_epi64(a3, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(arr + i + 12))));
+    }
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3));
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_i32_scalar(arr + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static inline long long sum_i32_avx512(const int* arr, size_t n) {
+    __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+    __m512i a2 = _mm512_setzero_si512(), a3 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a0 = _mm512_add_epi64(a0, _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(arr + i))));
+        a1 = _mm512_add_epi64(a1, _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(arr + i + 8))));
+        a2 = _mm512_add_epi64(a2, _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(arr + i + 16))));
+        a3 = _mm512_add_epi64(a3, _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(arr + i + 24))));
+    }
+    __m512i acc = _mm512_add_epi64(_mm512_add_epi64(a0, a1), _mm512_add_epi64(a2, a3));
+    return _mm512_reduce_add_epi64(acc) + sum_i32_scalar(arr + i, n - i);
+}
+
+#endif
+
+typedef struct {
+    const char* name;
+    SumI32Fn fn;
+} SumKernel;
+
+// Picks the widest kernel supported by this CPU (CPUID via
+// __builtin_cpu_supports, which also checks OS support for the state).
+// SUM_KERNEL=scalar|sse2|avx2|avx512 forces a variant for comparisons.
+static inline SumKernel sum_kernel_select(void) {
+    SumKernel available[4] = {{"scalar", sum_i32_scalar}};
+    int count = 1;
+#ifdef SUM_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) available[count++] = (SumKernel){"sse2", sum_i32_sse2};
+    if (__builtin_cpu_supports("avx2")) available[count++] = (SumKernel){"avx2", sum_i32_avx2};
+    if (__builtin_cpu_supports("avx512f")) available[count++] = (SumKernel){"avx512", sum_i32_avx512};
+#endif
+    const char* forced = getenv("SUM_KERNEL");
+    for (int i = 0; forced && i < count; i++) {
+        if (strcmp(forced, available[i].name) == 0) return available[i];
+    }
+    return available[count - 1];
+}
+
+static inline const SumKernel* sum_kernel(void) {
+    static SumKernel selected;
+    if (!selected.fn) selected = sum_kernel_select();
+    return &selected;
+}
+
+static inline long long sum_i32(const int* arr, size_t n) {
+    return sum_kernel()->fn(arr, n);
+}
+
+// Node memory bandwidth in GB/s from NODE_MEM_BW, or 0 if unknown.
+static inline double node_mem_bw_gbs(void) {
+    const char* bw = getenv("NODE_MEM_BW");
+    return bw ? atof(bw) : 0.0;
+}
+
+// Achieved read bandwidth of a sum over n ints that took `seconds`.
+static inline double sum_i32_gbs(size_t n, double seconds) {
+    return seconds > 0 ? (double)n * sizeof(int) / seconds / 1e9 : 0.0;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "sum_kernels.h"
+
+// Threads inside one MPI rank (hybrid MPI + OpenMP mode). The rank x thread
+// layout is chosen at launch time: mpirun -np R with THREADS_PER_RANK=T.
+// Without OpenMP support in the build every rank runs single-threaded.
+
+static inline int threads_per_rank(void) {
+#ifdef _OPENMP
+    const char* str = getenv("THREADS_PER_RANK");
+    int threads = str ? atoi(str) : 1;
+    if (threads < 1) threads = 1;
+    if (threads > omp_get_thread_limit()) threads = omp_get_thread_limit();
+    return threads;
+#else
+    return 1;
+#endif
+}
+
+// Contiguous static split of [0, n) for the calling thread, matching
+// schedule(static) so a buffer is always touched by the same thread.
+static inline void thread_range(size_t n, size_t* begin, size_t* end) {
+#ifdef _OPENMP
+    size_t t = (size_t)omp_get_thread_num(), nt = (size_t)omp_get_num_threads();
+#else
+    size_t t = 0, nt = 1;
+#endif
+    size_t chunk = n / nt, extra = n % nt;
+    *begin = t * chunk + (t < extra ? t : extra);
+    *end = *begin + chunk + (t < extra ? 1 : 0);
+}
+
+static inline long long sum_i32_threaded(const int* arr, size_t n, int threads) {
+    if (threads <= 1) return sum_i32(arr, n);
+    long long total = 0;
+    sum_kernel();  // resolve the dispatch once, outside the parallel region
+#pragma omp parallel num_threads(threads) reduction(+:total)
+    {
+        size_t begin, end;
+        thread_range(n, &begin, &end);
+        total += sum_i32(arr + begin, end - begin);
+    }
+    return total;
+}
+
+#endif
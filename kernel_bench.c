@@ -0,0 +1,499 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "common/narrow_sum.h"
+#include "common/elementwise.h"
+#include "common/fast_div.h"
+#include "common/scan.h"
+#include "common/stats.h"
+#include "common/threads.h"
+#include "common/bench.h"
+
+// Micro-benchmark of the compute kernels on their own, without MPI: the sums
+// behind sequential_sum (Task1.c, every element type), calculate_sum
+// (task1 (super)) and sequential_scan (Task1.c, OPERATION=scan), the
+// fused statistics of OPERATION=stats (common/stats.h, also for the int64,
+// float and double kernels no program reads yet, and with NaN elements,
+// which they skip), the four separate passes
+// of array_operations_timed (Task 3.c, THREADS_PER_RANK threads) and
+// array_ops_timed (task3(super)), and the fused pass, each over working sets that double from 4 KiB up to
+// KERNEL_MAX_SIZE. The throughput steps at the L1, L2, L3 and DRAM
+// boundaries show up as one table per kernel.
+//
+// Division on its own (common/fast_div.h): the branchy loop of
+// task3(super), the masked exact kernel and the reciprocal kernel of
+// DIV_MODE=fast, with the largest distance in ULP from the exact quotient,
+// so speed and accuracy can be weighed per workload. Divisors span a wide
+// range and include zeros.
+//
+// In the style of Google Benchmark every point repeats the kernel until a
+// batch lasts at least KERNEL_MIN_TIME and reports the median of
+// ITERATIONS batches, per call. Every kernel is checked against a plain
+// loop (the fast division against DIV_FAST_MAX_ULP); the exit status is 1
+// on a mismatch, so ctest runs it as a test.
+//
+// Environment:
+//   KERNEL_FILTER    run only the kernels whose name contains this text
+//   KERNEL_MAX_SIZE  largest working set in bytes, with an optional K, M or
+//                    G suffix (default 256M, well past any L3)
+//   KERNEL_MIN_TIME  seconds per batch (default 0.05)
+//   ITERATIONS       batches per point (default 5)
+//   BENCH_FORMAT     text (default), csv or json
+
+#define DEFAULT_ITERATIONS 5
+#define DEFAULT_MAX_SIZE (256LL << 20)
+#define MIN_SIZE (4LL << 10)
+#define EW_ARRAYS 6   // a, b and the four results
+#define DIV_ARRAYS 3  // a, b and the quotient
+
+// sum_elements() of one element type, sum_i32(), the int32 scan, the
+// statistics of one type (with NaN elements mixed in or not), the four
+// separate passes, the fused pass, or one division
+typedef enum {
+    KERNEL_SUM, KERNEL_SUM_I32, KERNEL_SCAN, KERNEL_STATS, KERNEL_STATS_NAN, KERNEL_TIMED, KERNEL_FUSED,
+    KERNEL_DIV_BRANCH, KERNEL_DIV_EXACT, KERNEL_DIV_FAST
+} KernelKind;
+
+typedef struct {
+    const char* name;
+    KernelKind kind;
+    ElementType type;  // sums only
+    int threads;       // KERNEL_TIMED only
+    StatsType stats;   // KERNEL_STATS and KERNEL_STATS_NAN only
+} Kernel;
+
+typedef struct {
+    const Kernel* kernel;
+    long long bytes;  // working set
+    size_t elements;
+    const char* level;
+    double seconds;  // median per call
+    double gbs;      // bytes loaded and stored per call / seconds
+    long long max_ulp;  // division: largest distance from the exact quotient, -1 otherwise
+} KernelPoint;
+
+typedef struct {
+    long long l1, l2, l3;
+} CacheSizes;
+
+// Data cache sizes from sysconf (glibc), 0 where unknown
+CacheSizes cache_sizes(void) {
+    CacheSizes c = {0, 0, 0};
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    c.l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    c.l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    c.l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    if (c.l1 < 0) c.l1 = 0;
+    if (c.l2 < 0) c.l2 = 0;
+    if (c.l3 < 0) c.l3 = 0;
+    return c;
+}
+
+// Smallest level the working set fits in
+const char* cache_level(const CacheSizes* c, long long bytes) {
+    if (!c->l1) return "-";
+    if (bytes <= c->l1) return "L1";
+    if (c->l2 && bytes <= c->l2) return "L2";
+    if (c->l3 && bytes <= c->l3) return "L3";
+    return "DRAM";
+}
+
+// Byte count with an optional K, M or G suffix; 0 if invalid
+long long parse_bytes(const char* str) {
+    char* end;
+    long long value = strtoll(str, &end, 10);
+    if (*end == 'K' || *end == 'k') value <<= 10, end++;
+    else if (*end == 'M' || *end == 'm') value <<= 20, end++;
+    else if (*end == 'G' || *end == 'g') value <<= 30, end++;
+    return *end == '\0' && value > 0 ? value : 0;
+}
+
+void format_bytes(long long bytes, char* out, size_t size) {
+    if (bytes >= (1LL << 30) && bytes % (1LL << 30) == 0) snprintf(out, size, "%lldGiB", bytes >> 30);
+    else if (bytes >= (1LL << 20) && bytes % (1LL << 20) == 0) snprintf(out, size, "%lldMiB", bytes >> 20);
+    else if (bytes >= (1LL << 10) && bytes % (1LL << 10) == 0) snprintf(out, size, "%lldKiB", bytes >> 10);
+    else snprintf(out, size, "%lldB", bytes);
+}
+
+int kernel_is_sum(const Kernel* k) {
+    return k->kind == KERNEL_SUM || k->kind == KERNEL_SUM_I32;
+}
+
+int kernel_is_stats(const Kernel* k) {
+    return k->kind == KERNEL_STATS || k->kind == KERNEL_STATS_NAN;
+}
+
+int kernel_is_div(const Kernel* k) {
+    return k->kind == KERNEL_DIV_BRANCH || k->kind == KERNEL_DIV_EXACT || k->kind == KERNEL_DIV_FAST;
+}
+
+size_t kernel_element_bytes(const Kernel* k) {
+    if (kernel_is_sum(k)) return element_size(k->type);
+    if (k->kind == KERNEL_SCAN) return sizeof(int) + sizeof(long long);
+    if (kernel_is_stats(k)) return stats_type_size(k->stats);
+    return (kernel_is_div(k) ? DIV_ARRAYS : EW_ARRAYS) * sizeof(double);
+}
+
+// Bytes loaded and stored by one call: the four separate passes each read
+// a and b and write one result, the fused pass reads a and b once
+double kernel_traffic_bytes(const Kernel* k, size_t n) {
+    if (kernel_is_sum(k) || kernel_is_div(k) || k->kind == KERNEL_SCAN || kernel_is_stats(k)) {
+        return (double)n * kernel_element_bytes(k);
+    }
+    return (double)n * (k->kind == KERNEL_TIMED ? 4 * 3 : EW_ARRAYS) * sizeof(double);
+}
+
+// The six elementwise arrays, back to back in one buffer
+typedef struct {
+    double *a, *b, *add, *sub, *mul, *div;
+} EwArrays;
+
+EwArrays ew_arrays(void* buffer, size_t n) {
+    double* p = (double*)buffer;
+    EwArrays e = {p, p + n, p + 2 * n, p + 3 * n, p + 4 * n, p + 5 * n};
+    return e;
+}
+
+// Uniform mantissa scaled by 2^-20 .. 2^20
+double wide_random(void) {
+    return ((double)rand() + 1.0) / RAND_MAX * ldexp(1.0, rand() % 41 - 20);
+}
+
+// The int64 totals of the scan follow its n inputs, 8-byte aligned (a
+// power-of-two size is never a multiple of 12, so the padding fits)
+long long* scan_output(void* buffer, size_t n) {
+    return (long long*)buffer + (n + 1) / 2;
+}
+
+// Element i of a stats input, as a double
+double stats_value(const void* buffer, StatsType t, size_t i) {
+    switch (t) {
+    case STATS_U8: return ((const uint8_t*)buffer)[i];
+    case STATS_U16: return ((const uint16_t*)buffer)[i];
+    case STATS_I32: return ((const int32_t*)buffer)[i];
+    case STATS_I64: return (double)((const int64_t*)buffer)[i];
+    case STATS_F32: return ((const float*)buffer)[i];
+    case STATS_F64: return ((const double*)buffer)[i];
+    }
+    return 0.0;
+}
+
+void fill_inputs(const Kernel* k, void* buffer, size_t n) {
+    srand(42);
+    if (kernel_is_stats(k)) {
+        // Signed values: int64 as +-2^60 plus a small part, which a double
+        // sum would lose, and floats over a wide range. The NaN variant
+        // starts with NaN, has one in every 7 elements and a whole block of
+        // them.
+        for (size_t i = 0; i < n; i++) {
+            double x = rand() % 2 ? wide_random() : -wide_random();
+            int nan = k->kind == KERNEL_STATS_NAN &&
+                      (i % 7 == 0 || (i >= STATS_BLOCK && i < 2 * STATS_BLOCK));
+            if (nan) x = NAN;
+            if (k->stats == STATS_I64) ((int64_t*)buffer)[i] = (i % 2 ? -(1LL << 60) : 1LL << 60) + rand() % 1000;
+            else if (k->stats == STATS_F32) ((float*)buffer)[i] = (float)x;
+            else if (k->stats == STATS_F64) ((double*)buffer)[i] = x;
+            else if (k->stats == STATS_I32) ((int32_t*)buffer)[i] = rand() % 2001 - 1000;
+            else if (k->stats == STATS_U16) ((uint16_t*)buffer)[i] = (uint16_t)(rand() % 65536);
+            else ((uint8_t*)buffer)[i] = (uint8_t)(rand() % 256);
+        }
+        return;
+    }
+    if (kernel_is_div(k)) {
+        EwArrays e = ew_arrays(buffer, n);
+        for (size_t i = 0; i < n; i++) {
+            e.a[i] = rand() % 2 ? wide_random() : -wide_random();
+            e.b[i] = rand() % 1000 == 0 ? 0.0 : wide_random();
+        }
+        return;
+    }
+    if (!kernel_is_sum(k) && k->kind != KERNEL_SCAN) {
+        EwArrays e = ew_arrays(buffer, n);
+        for (size_t i = 0; i < n; i++) {
+            e.a[i] = (double)(rand() % 100 + 1);
+            e.b[i] = (double)(rand() % 101);  // zeros exercise the masked division
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int value = rand() % 100;
+        if (k->type == ELEMENT_UINT8) ((uint8_t*)buffer)[i] = (uint8_t)value;
+        else if (k->type == ELEMENT_UINT16) ((uint16_t*)buffer)[i] = (uint16_t)value;
+        else ((int*)buffer)[i] = value;
+    }
+}
+
+// Division as task3(super) wrote it, the divide behind the branch
+void div_branch(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = b[i] != 0 ? a[i] / b[i] : 0;
+}
+
+// Result of the last statistics call
+Stats stats_result;
+
+// One call of the kernel; the sum for the sums, the argmax for the
+// statistics, 0 otherwise
+long long run_kernel(const Kernel* k, void* buffer, size_t n) {
+    if (k->kind == KERNEL_SUM) return sum_elements(buffer, n, k->type);
+    if (k->kind == KERNEL_SUM_I32) return sum_i32((const int*)buffer, n);
+    if (k->kind == KERNEL_SCAN) return scan_elements(buffer, ELEMENT_INT32, scan_output(buffer, n), n);
+    if (kernel_is_stats(k)) {
+        stats_init(&stats_result);
+        stats_typed(buffer, n, k->stats, 0, &stats_result);
+        return stats_result.argmax;
+    }
+    EwArrays e = ew_arrays(buffer, n);
+    if (k->kind == KERNEL_DIV_BRANCH) {
+        div_branch(e.a, e.b, e.add, n);
+    } else if (kernel_is_div(k)) {
+        div_kernel(k->kind == KERNEL_DIV_FAST)->fn(e.a, e.b, e.add, n);
+    } else if (k->kind == KERNEL_FUSED) {
+        ew_fused(e.a, e.b, e.add, e.sub, e.mul, e.div, n);
+    } else {
+        ew_op(EW_ADD, e.a, e.b, e.add, n, k->threads);
+        ew_op(EW_SUB, e.a, e.b, e.sub, n, k->threads);
+        ew_op(EW_MUL, e.a, e.b, e.mul, n, k->threads);
+        ew_op(EW_DIV, e.a, e.b, e.div, n, k->threads);
+    }
+    return 0;
+}
+
+// Distance in units in the last place between two doubles, counted through
+// their bit patterns
+long long ulp_distance(double x, double y) {
+    int64_t ix, iy;
+    if (x == y) return 0;
+    memcpy(&ix, &x, sizeof(ix));
+    memcpy(&iy, &y, sizeof(iy));
+    if ((ix < 0) != (iy < 0)) return INT64_MAX;
+    return ix > iy ? ix - iy : iy - ix;
+}
+
+// Compares the last call's results with a plain loop; 0 when they match.
+// For the divisions *max_ulp is the largest distance from the exact
+// quotient, which for the fast one may be up to DIV_FAST_MAX_ULP.
+int check_kernel(const Kernel* k, void* buffer, size_t n, long long result, long long* max_ulp) {
+    *max_ulp = -1;
+    if (k->kind == KERNEL_SCAN) {
+        const int* in = (const int*)buffer;
+        const long long* out = scan_output(buffer, n);
+        long long running = 0, mismatches = 0;
+        for (size_t i = 0; i < n; i++) {
+            running += in[i];
+            mismatches += out[i] != running;
+        }
+        return mismatches > 0 || result != running;
+    }
+    if (kernel_is_stats(k)) {
+        // Two passes: sum, min, max and the first maximum, then the
+        // squared deviations; NaN skipped. int64 is compared and summed
+        // exactly, as the doubles of nearby values are equal.
+        Stats expected;
+        double sum = 0.0, m2 = 0.0;
+        stats_init(&expected);
+        expected.count = 0;
+        if (k->stats == STATS_I64) {
+            const int64_t* v = (const int64_t*)buffer;
+            __int128 exact = 0;
+            int64_t hi = INT64_MIN, lo = INT64_MAX;
+            for (size_t i = 0; i < n; i++) {
+                exact += v[i];
+                if (v[i] < lo) lo = v[i];
+                if (v[i] > hi) {
+                    hi = v[i];
+                    expected.argmax = (long long)i;
+                }
+            }
+            expected.count = (long long)n;
+            sum = (double)exact;
+            expected.min = (double)lo;
+            expected.max = (double)hi;
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                double x = stats_value(buffer, k->stats, i);
+                if (isnan(x)) continue;
+                expected.count++;
+                sum += x;
+                if (x < expected.min) expected.min = x;
+                if (x > expected.max) {
+                    expected.max = x;
+                    expected.argmax = (long long)i;
+                }
+            }
+        }
+        expected.mean = expected.count > 0 ? sum / (double)expected.count : 0.0;
+        for (size_t i = 0; i < n; i++) {
+            double x = stats_value(buffer, k->stats, i);
+            if (!isnan(x)) m2 += (x - expected.mean) * (x - expected.mean);
+        }
+        expected.m2 = m2;
+        return result != expected.argmax || !stats_match(&stats_result, &expected, 1e-9);
+    }
+    if (kernel_is_div(k)) {
+        EwArrays e = ew_arrays(buffer, n);
+        *max_ulp = 0;
+        for (size_t i = 0; i < n; i++) {
+            long long d = ulp_distance(e.add[i], e.b[i] != 0 ? e.a[i] / e.b[i] : 0);
+            if (d > *max_ulp) *max_ulp = d;
+        }
+        return *max_ulp > (k->kind == KERNEL_DIV_FAST ? DIV_FAST_MAX_ULP : 0);
+    }
+    if (kernel_is_sum(k)) {
+        long long expected = 0;
+        for (size_t i = 0; i < n; i++) {
+            expected += k->type == ELEMENT_UINT8 ? ((const uint8_t*)buffer)[i]
+                      : k->type == ELEMENT_UINT16 ? ((const uint16_t*)buffer)[i]
+                                                  : ((const int*)buffer)[i];
+        }
+        return result != expected;
+    }
+    EwArrays e = ew_arrays(buffer, n);
+    for (size_t i = 0; i < n; i++) {
+        double x = e.a[i], y = e.b[i];
+        if (e.add[i] != x + y || e.sub[i] != x - y || e.mul[i] != x * y ||
+            e.div[i] != (y != 0 ? x / y : 0)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Median seconds per call: repetitions are doubled until a batch lasts
+// min_time, then `iterations` batches of that many calls are measured
+double measure(const Kernel* k, void* buffer, size_t n, double min_time, const BenchConfig* bench,
+               long long* result) {
+    static volatile long long sink;
+    long long reps = 1;
+    for (;;) {
+        double start = bench_now();
+        for (long long r = 0; r < reps; r++) sink = run_kernel(k, buffer, n);
+        if (bench_now() - start >= min_time || reps >= (1LL << 40)) break;
+        reps *= 2;
+    }
+    BenchSeries series;
+    BenchStats stats;
+    if (bench_series_init(&series, k->name, bench->iterations) != 0) {
+        printf("Error: Memory allocation failed for benchmark samples\n");
+        exit(1);
+    }
+    for (int i = 0; i < bench->iterations; i++) {
+        double start = bench_now();
+        for (long long r = 0; r < reps; r++) sink = run_kernel(k, buffer, n);
+        bench_series_add(&series, (bench_now() - start) / (double)reps);
+    }
+    *result = sink;
+    bench_stats(&series, bench, &stats);
+    bench_series_free(&series);
+    return stats.median;
+}
+
+void print_point(const KernelPoint* p, const BenchConfig* bench, int first) {
+    char size[32], label[96];
+    format_bytes(p->bytes, size, sizeof(size));
+    if (bench->format == BENCH_CSV) {
+        if (first) printf("kernel,bytes,level,elements,seconds,gbs,max_ulp\n");
+        printf("%s,%lld,%s,%zu,%.9e,%.3f,", p->kernel->name, p->bytes, p->level, p->elements, p->seconds,
+               p->gbs);
+        if (p->max_ulp >= 0) printf("%lld", p->max_ulp);
+        printf("\n");
+    } else if (bench->format == BENCH_JSON) {
+        printf("%s{\"kernel\":\"%s\",\"bytes\":%lld,\"level\":\"%s\",\"elements\":%zu,\"seconds\":%.9e,"
+               "\"gbs\":%.3f",
+               first ? "[" : ",", p->kernel->name, p->bytes, p->level, p->elements, p->seconds, p->gbs);
+        if (p->max_ulp >= 0) printf(",\"max_ulp\":%lld", p->max_ulp);
+        printf("}");
+    } else {
+        snprintf(label, sizeof(label), "%s/%s", p->kernel->name, size);
+        printf("%-40s %6s %14.1f ns %10.2f %12.1f", label, p->level, 1e9 * p->seconds, p->gbs,
+               (double)p->elements / p->seconds / 1e6);
+        if (p->max_ulp >= 0) printf(" %8lld", p->max_ulp);
+        printf("\n");
+    }
+}
+
+int main(void) {
+    BenchConfig bench;
+    bench_config_from_env(&bench, DEFAULT_ITERATIONS);
+    const char* filter = getenv("KERNEL_FILTER");
+    const char* str = getenv("KERNEL_MAX_SIZE");
+    long long max_size = str ? parse_bytes(str) : DEFAULT_MAX_SIZE;
+    double min_time = (str = getenv("KERNEL_MIN_TIME")) ? atof(str) : 0.05;
+    int threads = threads_per_rank();
+    if (max_size < MIN_SIZE) {
+        printf("Error: KERNEL_MAX_SIZE must be at least %lld bytes\n", MIN_SIZE);
+        return 1;
+    }
+
+    const Kernel kernels[] = {
+        {"sequential_sum/int32", KERNEL_SUM, ELEMENT_INT32, 1, STATS_I32},
+        {"sequential_sum/uint16", KERNEL_SUM, ELEMENT_UINT16, 1, STATS_I32},
+        {"sequential_sum/uint8", KERNEL_SUM, ELEMENT_UINT8, 1, STATS_I32},
+        {"calculate_sum", KERNEL_SUM_I32, ELEMENT_INT32, 1, STATS_I32},
+        {"sequential_scan", KERNEL_SCAN, ELEMENT_INT32, 1, STATS_I32},
+        {"stats/uint8", KERNEL_STATS, ELEMENT_INT32, 1, STATS_U8},
+        {"stats/uint16", KERNEL_STATS, ELEMENT_INT32, 1, STATS_U16},
+        {"stats/int32", KERNEL_STATS, ELEMENT_INT32, 1, STATS_I32},
+        {"stats/int64", KERNEL_STATS, ELEMENT_INT32, 1, STATS_I64},
+        {"stats/float", KERNEL_STATS, ELEMENT_INT32, 1, STATS_F32},
+        {"stats/double", KERNEL_STATS, ELEMENT_INT32, 1, STATS_F64},
+        {"stats/float+nan", KERNEL_STATS_NAN, ELEMENT_INT32, 1, STATS_F32},
+        {"stats/double+nan", KERNEL_STATS_NAN, ELEMENT_INT32, 1, STATS_F64},
+        {"array_operations_timed", KERNEL_TIMED, ELEMENT_INT32, threads, STATS_I32},
+        {"array_ops_timed", KERNEL_TIMED, ELEMENT_INT32, 1, STATS_I32},
+        {"array_ops_fused", KERNEL_FUSED, ELEMENT_INT32, 1, STATS_I32},
+        {"div_branch", KERNEL_DIV_BRANCH, ELEMENT_INT32, 1, STATS_I32},
+        {"div_exact", KERNEL_DIV_EXACT, ELEMENT_INT32, 1, STATS_I32},
+        {"div_fast", KERNEL_DIV_FAST, ELEMENT_INT32, 1, STATS_I32},
+    };
+    int num_kernels = (int)(sizeof(kernels) / sizeof(kernels[0]));
+
+    void* buffer = aligned_alloc(64, (size_t)max_size);
+    if (!buffer) {
+        printf("Error: Memory allocation failed for %lld bytes\n", max_size);
+        return 1;
+    }
+    CacheSizes caches = cache_sizes();
+
+    if (bench.format == BENCH_TEXT) {
+        char l1[32], l2[32], l3[32];
+        format_bytes(caches.l1, l1, sizeof(l1));
+        format_bytes(caches.l2, l2, sizeof(l2));
+        format_bytes(caches.l3, l3, sizeof(l3));
+        printf("=== Kernel micro-benchmarks ===\n");
+        printf("Caches: L1d %s, L2 %s, L3 %s\n", l1, l2, l3);
+        printf("Sum kernel: %s (narrow: %s), scan kernel: %s, threads for array_operations_timed: %d\n",
+               sum_kernel()->name, narrow_sum_kernel()->name, scan_kernel()->name, threads);
+        printf("Division: exact %s, fast %s (at most %d ULP)\n", div_kernel(0)->name, div_kernel(1)->name,
+               DIV_FAST_MAX_ULP);
+        printf("Median of %d batches of at least %.3f s, per call\n\n", bench.iterations, min_time);
+        printf("%-40s %6s %17s %10s %12s %8s\n", "Benchmark", "Level", "Time", "GB/s", "Melem/s", "Max ULP");
+    }
+
+    int errors = 0, points = 0;
+    for (int k = 0; k < num_kernels; k++) {
+        const Kernel* kernel = &kernels[k];
+        if (filter && !strstr(kernel->name, filter)) continue;
+        for (long long bytes = MIN_SIZE; bytes <= max_size; bytes *= 2) {
+            KernelPoint p = {kernel, bytes, (size_t)bytes / kernel_element_bytes(kernel),
+                             cache_level(&caches, bytes), 0.0, 0.0, -1};
+            long long result;
+            fill_inputs(kernel, buffer, p.elements);
+            p.seconds = measure(kernel, buffer, p.elements, min_time, &bench, &result);
+            p.gbs = p.seconds > 0 ? kernel_traffic_bytes(kernel, p.elements) / p.seconds / 1e9 : 0.0;
+            if (check_kernel(kernel, buffer, p.elements, result, &p.max_ulp) != 0) {
+                printf("Error: %s gave a wrong result at %lld bytes\n", kernel->name, bytes);
+                errors++;
+            }
+            print_point(&p, &bench, points++ == 0);
+        }
+        if (bench.format == BENCH_TEXT) printf("\n");
+    }
+    if (bench.format == BENCH_JSON) printf("%s]\n", points ? "" : "[");
+
+    free(buffer);
+    return errors > 0;
+}
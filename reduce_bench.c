@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "common/bench.h"
+#include "common/reduce_algo.h"
+
+// Micro-benchmark of the final reduction of Task1.c: every algorithm of
+// common/reduce_algo.h (MPI_Reduce, binomial tree, recursive doubling,
+// node-aware two-level, MPI_Iallreduce) on the first p world ranks for each
+// p of the grid, so one `mpirun -np P` shows how they scale with the rank
+// count on this topology and which one REDUCE_ALGO=auto would pick.
+//
+// Environment:
+//   REDUCE_PROCS  rank counts, comma separated (default 2, 4, ... and P)
+//   REDUCE_COUNT  long longs per reduction (default 1, the sum of Task1)
+//   ITERATIONS    measured calls per point (default 1000), after warm-up
+
+#define DEFAULT_ITERATIONS 1000
+#define MAX_POINTS 64
+
+typedef struct {
+    int procs;
+    int nodes;
+    double time[REDUCE_NUM_ALGOS];  // median seconds per call, slowest rank
+    int best;
+} ReducePoint;
+
+// Comma separated list of positive integers; returns how many were parsed
+int parse_list(const char* str, long long* out, int max) {
+    int n = 0;
+    char* end;
+    while (str && *str && n < max) {
+        long long value = strtoll(str, &end, 10);
+        if (end == str) break;
+        if (value > 0) out[n++] = value;
+        str = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// Default grid: powers of two from 2 below the world size, then the world size
+int default_procs(int world_size, long long* out) {
+    int n = 0;
+    for (int p = 2; p < world_size && n < MAX_POINTS - 1; p *= 2) out[n++] = p;
+    out[n++] = world_size;
+    return n;
+}
+
+// Median time of one algorithm on ctx->comm (meaningful on its rank 0);
+// every call is checked against the known total on the ranks that get it
+double measure(ReduceContext* ctx, ReduceAlgo algo, long long* send, long long* recv, int count,
+               const BenchConfig* bench, int* errors) {
+    int warming = bench->max_warmup > 0;
+    BenchSeries series;
+    BenchWarmup warmup = {{0}, 0};
+    BenchStats stats;
+    long long expected = (long long)ctx->num_procs * (ctx->num_procs + 1) / 2;
+    int gets_result = algo == REDUCE_RECURSIVE_DOUBLING || algo == REDUCE_IALLREDUCE || ctx->rank == 0;
+
+    if (bench_series_init(&series, reduce_algo_names[algo], bench->iterations) != 0) {
+        printf("Error: Memory allocation failed for benchmark samples\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int measured = 0; measured < bench->iterations;) {
+        double elapsed, slowest = 0.0;
+        recv[0] = 0;
+        MPI_Barrier(ctx->comm);
+        double start = MPI_Wtime();
+        reduce_run(ctx, algo, send, recv, count, MPI_LONG_LONG, MPI_SUM, 0);
+        elapsed = MPI_Wtime() - start;
+        if (gets_result && recv[0] != expected) (*errors)++;
+        MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, ctx->comm);
+        if (warming) {
+            int done = 0;
+            if (ctx->rank == 0) done = bench_warmup_done(&warmup, bench, slowest);
+            MPI_Bcast(&done, 1, MPI_INT, 0, ctx->comm);
+            warming = !done;
+        } else {
+            if (ctx->rank == 0) bench_series_add(&series, slowest);
+            measured++;
+        }
+    }
+    bench_stats(&series, bench, &stats);
+    bench_series_free(&series);
+    return stats.median;
+}
+
+void print_points(const ReducePoint* points, int count, int elements, const BenchConfig* bench) {
+    if (bench->format == BENCH_CSV) {
+        printf("procs,nodes,count");
+        for (int a = 0; a < REDUCE_NUM_ALGOS; a++) printf(",%s", reduce_algo_names[a]);
+        printf(",best\n");
+        for (int i = 0; i < count; i++) {
+            printf("%d,%d,%d", points[i].procs, points[i].nodes, elements);
+            for (int a = 0; a < REDUCE_NUM_ALGOS; a++) printf(",%.9f", points[i].time[a]);
+            printf(",%s\n", reduce_algo_names[points[i].best]);
+        }
+        return;
+    }
+    if (bench->format == BENCH_JSON) {
+        printf("[");
+        for (int i = 0; i < count; i++) {
+            printf("%s{\"procs\":%d,\"nodes\":%d,\"count\":%d", i ? "," : "", points[i].procs, points[i].nodes,
+                   elements);
+            for (int a = 0; a < REDUCE_NUM_ALGOS; a++) {
+                printf(",\"%s\":%.9f", reduce_algo_names[a], points[i].time[a]);
+            }
+            printf(",\"best\":\"%s\"}", reduce_algo_names[points[i].best]);
+        }
+        printf("]\n");
+        return;
+    }
+
+    printf("%6s %6s", "procs", "nodes");
+    for (int a = 0; a < REDUCE_NUM_ALGOS; a++) printf(" %19s", reduce_algo_names[a]);
+    printf("  best\n");
+    for (int i = 0; i < count; i++) {
+        printf("%6d %6d", points[i].procs, points[i].nodes);
+        for (int a = 0; a < REDUCE_NUM_ALGOS; a++) printf(" %16.2f us", 1e6 * points[i].time[a]);
+        printf("  %s\n", reduce_algo_names[points[i].best]);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int rank, world_size, num_procs, elements, errors = 0, total_errors = 0;
+    long long procs[MAX_POINTS];
+    ReducePoint points[MAX_POINTS];
+    BenchConfig bench;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    bench_config_from_env(&bench, DEFAULT_ITERATIONS);
+
+    num_procs = parse_list(getenv("REDUCE_PROCS"), procs, MAX_POINTS);
+    if (num_procs == 0) num_procs = default_procs(world_size, procs);
+    char* count_str = getenv("REDUCE_COUNT");
+    elements = count_str ? atoi(count_str) : 1;
+    if (elements < 1) elements = 1;
+    for (int i = 0; i < num_procs; i++) {
+        if (procs[i] > world_size) {
+            if (rank == 0) {
+                printf("Error: REDUCE_PROCS asks for %lld processes, job has %d\n", procs[i], world_size);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // Every rank contributes rank + 1 in each element
+    long long* send = (long long*)malloc(2 * (size_t)elements * sizeof(long long));
+    if (!send) {
+        printf("Error: Memory allocation failed for %d elements\n", elements);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    long long* recv = send + elements;
+    for (int k = 0; k < elements; k++) send[k] = rank + 1;
+
+    if (rank == 0 && bench_human_output(&bench)) {
+        printf("=== Reduction algorithms ===\n");
+        printf("World size: %d, %d long long%s per reduction, iterations per point: %d\n",
+               world_size, elements, elements > 1 ? "s" : "", bench.iterations);
+        printf("Median per call, slowest rank\n\n");
+    }
+
+    // Each point on the first p ranks; rank 0 of each sub-communicator is world rank 0
+    for (int i = 0; i < num_procs; i++) {
+        int p = (int)procs[i];
+        MPI_Comm sub;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &sub);
+        if (sub == MPI_COMM_NULL) continue;
+        ReduceContext ctx;
+        if (reduce_context_init(&ctx, sub, (size_t)elements * sizeof(long long)) != MPI_SUCCESS) {
+            printf("Error: Setting up the reduction failed in process %d\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        ReducePoint pt = {p, 0, {0}, REDUCE_LIBRARY};
+        int leader = ctx.leader_comm != MPI_COMM_NULL;
+        MPI_Reduce(&leader, &pt.nodes, 1, MPI_INT, MPI_SUM, 0, sub);
+        for (int a = 0; a < REDUCE_NUM_ALGOS; a++) {
+            pt.time[a] = measure(&ctx, (ReduceAlgo)a, send, recv, elements, &bench, &errors);
+            if (pt.time[a] < pt.time[pt.best]) pt.best = a;
+        }
+        reduce_context_free(&ctx);
+        MPI_Comm_free(&sub);
+        if (rank == 0) points[i] = pt;
+    }
+
+    MPI_Reduce(&errors, &total_errors, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        print_points(points, num_procs, elements, &bench);
+        if (total_errors > 0) printf("Error: %d reductions gave a wrong result\n", total_errors);
+    }
+    free(send);
+    MPI_Finalize();
+    return total_errors > 0;
+}
@@ -0,0 +1,409 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "common/philox.h"
+#include "common/threads.h"
+#include "common/narrow_sum.h"
+#include "common/stats.h"
+#include "common/expr.h"
+#include "common/distribution.h"
+#include "common/large_count.h"
+#include "common/arrayfile.h"
+#include "common/arena.h"
+#include "common/comm_plan.h"
+#include "common/job.h"
+
+// Resident server: the MPI world is launched once and stays up, with its
+// buffers allocated, placed and first-touched up front, and serves jobs
+// (common/job.h) from a local Unix socket, so many small jobs stop paying
+// for mpirun, MPI_Init, allocation and warm-up each time. Rank 0 accepts a
+// request, checks it and broadcasts it; all ranks fetch their slices
+// (generated, read from an array file, or scattered from a shared-memory
+// segment on rank 0's node), run the kernel of Task1.c (sum, stats) or the
+// expression engine of Task 3.c (expr), and rank 0 returns the result with
+// the server-side timings. tools/job_client.c sends requests and reports
+// the latency per request.
+//
+//   mpirun -np 4 ./server &
+//   ./job_client sum size=1000000
+//   ./job_client shutdown
+//
+// Environment:
+//   SERVER_SOCKET      socket path (default /tmp/pcs_lab3.sock)
+//   SERVER_MAX_SIZE    largest job in elements, sizes the buffers (default 30M)
+//   SERVER_MAX_INPUTS  inputs an expression may use (default 4)
+//   SERVER_TIMEOUT     seconds a client has to send its request (default 5);
+//                      slower clients are dropped so they cannot stall jobs
+//   THREADS_PER_RANK   OpenMP threads per rank, as in the other programs
+//
+// Idle ranks wait in MPI_Bcast for the next job; with most MPI libraries
+// that wait polls a core.
+
+#define DEFAULT_MAX_SIZE 30000000
+#define DEFAULT_MAX_INPUTS 4
+#define DEFAULT_TIMEOUT 5
+#define VALUE_BOUND 100
+
+typedef struct {
+    int rank, num_procs, threads;
+    long long max_size, max_local;
+    int max_inputs;
+    Arena arena;
+    double* local[EXPR_MAX_INPUTS];  // input slices; sum and stats use local[0] as int32
+    double* out;
+    long long local_sum, total_sum;
+    Stats local_stats, total_stats;
+    StatsMpi stats_mpi;
+    CommPlan sum_plan, stats_plan;
+} Server;
+
+typedef struct {
+    int ok;
+    char error[384];
+    long long size;
+    long long sum;
+    Stats stats;
+    uint64_t checksum;
+    double phases[3];  // distribute, compute, reduce; slowest rank
+    double total;      // slowest rank, so no phase exceeds it
+} JobResult;
+
+// Rank 0's mapping of a shm= segment
+typedef struct {
+    void* data;
+    size_t bytes;
+} Segment;
+
+// Listening socket on rank 0; -1 on failure
+int server_listen(const char* path) {
+    struct sockaddr_un addr;
+    if (job_socket_address(&addr, path) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(path);
+    // Owner only: a request can shut the server down or name any file.
+    // Nobody can connect before listen(), so there is no window.
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || chmod(path, 0600) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Next client, with a receive timeout of `timeout` seconds; -1 on failure
+int server_accept(int listen_fd, int timeout) {
+    int client = accept(listen_fd, NULL, NULL);
+    if (client < 0) return -1;
+    struct timeval tv = {timeout, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return client;
+}
+
+// Sends the reply and closes the connection; a client that is gone counts
+// as dropped
+void server_reply(int client, const char* reply, long long* dropped) {
+    if (job_write_all(client, reply, strlen(reply)) != 0) (*dropped)++;
+    close(client);
+}
+
+// Rank 0, before the broadcast: limits, the expression and the segment.
+// 0 when the job can run, -1 with a message in result->error.
+int server_check(const Server* srv, Job* job, Segment* seg, JobResult* result) {
+    seg->data = NULL;
+    seg->bytes = 0;
+    if (job->op == JOB_PING || job->op == JOB_SHUTDOWN) return 0;
+    int inputs = 1;
+    if (job->op == JOB_EXPR) {
+        Expr expr;
+        if (expr_compile(&expr, job->expr) != 0) {
+            snprintf(result->error, sizeof(result->error), "expr: %s", expr.error);
+            return -1;
+        }
+        if (expr.num_inputs > srv->max_inputs) {
+            snprintf(result->error, sizeof(result->error), "expr uses %d inputs, SERVER_MAX_INPUTS is %d",
+                     expr.num_inputs, srv->max_inputs);
+            return -1;
+        }
+        inputs = expr.num_inputs;
+    }
+    if (job->source != JOB_FILE && job->size == 0) {
+        job->size = JOB_DEFAULT_SIZE < srv->max_size ? JOB_DEFAULT_SIZE : srv->max_size;
+    }
+    if (job->source != JOB_FILE && job->size > srv->max_size) {
+        snprintf(result->error, sizeof(result->error), "size %lld above SERVER_MAX_SIZE %lld", job->size,
+                 srv->max_size);
+        return -1;
+    }
+    if (job->source == JOB_SHM) {
+        struct stat st;
+        size_t need = (size_t)job->size * (job->op == JOB_EXPR ? (size_t)inputs * sizeof(double) : sizeof(int));
+        int fd = shm_open(job->path, O_RDONLY, 0);
+        if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < need) {
+            if (fd >= 0) close(fd);
+            snprintf(result->error, sizeof(result->error), "segment %s missing or smaller than %zu bytes",
+                     job->path, need);
+            return -1;
+        }
+        seg->bytes = need > 0 ? need : 1;
+        seg->data = mmap(NULL, seg->bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (seg->data == MAP_FAILED) {
+            seg->data = NULL;
+            snprintf(result->error, sizeof(result->error), "cannot map segment %s", job->path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Collective: one job on every rank. `seg` is rank 0's segment for shm=.
+void server_run(Server* srv, const Job* job, const Segment* seg, JobResult* result) {
+    MPI_Comm comm = MPI_COMM_WORLD;
+    ArrayInput input;
+    Distribution dist;
+    Expr expr;
+    double times[4] = {0.0, 0.0, 0.0, 0.0};  // the three phases and the total
+    long long size = job->size;
+    int inputs = 1;
+
+    result->ok = 0;
+    double start = MPI_Wtime();
+    if (job->source == JOB_FILE) {
+        if (array_input_open(&input, job->path, ARRAYFILE_INT32, 0, comm) != 0) {
+            snprintf(result->error, sizeof(result->error), "%s is not an int32 array file", job->path);
+            return;
+        }
+        long long count = array_input_count(&input);
+        if (size == 0 || size > count) size = count;
+        if (size > srv->max_size) {
+            snprintf(result->error, sizeof(result->error), "file has %lld elements, SERVER_MAX_SIZE is %lld",
+                     count, srv->max_size);
+            array_input_close(&input);
+            return;
+        }
+    }
+    if (job->op == JOB_EXPR) {
+        expr_compile(&expr, job->expr);  // checked on rank 0
+        inputs = expr.num_inputs;
+    }
+    if (distribution_init(&dist, size, NULL, comm) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for distribution in process %d\n", srv->rank);
+        MPI_Abort(comm, 1);
+    }
+    long long n = dist.local_count, first = dist.local_first;
+    int* local_int = (int*)srv->local[0];
+
+    // Distribute: every rank fills or receives its slices
+    double t0 = MPI_Wtime();
+    int rc = MPI_SUCCESS;
+    for (int k = 0; k < inputs; k++) {
+        if (job->source == JOB_FILE) {
+            rc = array_input_read(&input, first, n, local_int, comm);
+        } else if (job->source == JOB_SHM) {
+            const char* base = seg->data;
+            rc = job->op == JOB_EXPR
+                ? large_scatterv(base ? base + (size_t)k * size * sizeof(double) : NULL, dist.counts, dist.displs,
+                                 MPI_DOUBLE, srv->local[k], n, 0, comm)
+                : large_scatterv(base, dist.counts, dist.displs, MPI_INT, local_int, n, 0, comm);
+        } else if (job->op == JOB_EXPR) {
+            philox_fill_double(srv->local[k], (size_t)first, (size_t)n, job->seed, (uint32_t)k, 1, 100);
+        } else {
+            philox_fill_int(local_int, (size_t)first, (size_t)n, job->seed, 0, VALUE_BOUND);
+        }
+    }
+    double t1 = MPI_Wtime();
+
+    // Compute and reduce
+    if (job->op == JOB_EXPR) {
+        expr_eval_threaded(&expr, (const double* const*)srv->local, srv->out, (size_t)n, srv->threads);
+    } else if (job->op == JOB_STATS) {
+        stats_init(&srv->local_stats);
+        stats_elements_threaded(local_int, (size_t)n, ELEMENT_INT32, first, srv->threads, &srv->local_stats);
+    } else {
+        srv->local_sum = sum_elements_threaded(local_int, (size_t)n, ELEMENT_INT32, srv->threads);
+    }
+    double t2 = MPI_Wtime();
+    if (job->op == JOB_EXPR) {
+        result->checksum = arrayfile_checksum_all(srv->out, ARRAYFILE_FLOAT64, first, n, comm);
+    } else if (job->op == JOB_STATS) {
+        comm_plan_run(&srv->stats_plan);
+        result->stats = srv->total_stats;
+    } else {
+        comm_plan_run(&srv->sum_plan);
+        result->sum = srv->total_sum;
+    }
+    double end = MPI_Wtime();
+
+    times[0] = t1 - t0;
+    times[1] = t2 - t1;
+    times[2] = end - t2;
+    times[3] = end - start;
+    double slowest[4] = {0.0, 0.0, 0.0, 0.0};
+    MPI_Reduce(times, slowest, 4, MPI_DOUBLE, MPI_MAX, 0, comm);
+    memcpy(result->phases, slowest, sizeof(result->phases));
+    result->total = slowest[3];
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MAX, comm);
+    if (rc != MPI_SUCCESS) {
+        snprintf(result->error, sizeof(result->error), "reading or scattering the input failed");
+    } else {
+        result->ok = 1;
+        result->size = size;
+    }
+    distribution_free(&dist);
+    if (job->source == JOB_FILE) array_input_close(&input);
+}
+
+void server_format(const Job* job, const JobResult* result, char* reply, size_t reply_size) {
+    char value[160];
+    if (!result->ok) {
+        snprintf(reply, reply_size, "error %s\n", result->error);
+        return;
+    }
+    if (job->op == JOB_EXPR) {
+        snprintf(value, sizeof(value), "checksum=%016llx", (unsigned long long)result->checksum);
+    } else if (job->op == JOB_STATS) {
+        snprintf(value, sizeof(value), "count=%lld min=%.0f max=%.0f argmax=%lld mean=%.9f variance=%.9f",
+                 result->stats.count, result->stats.min, result->stats.max, result->stats.argmax,
+                 result->stats.mean, stats_variance(&result->stats));
+    } else {
+        snprintf(value, sizeof(value), "result=%lld", result->sum);
+    }
+    snprintf(reply, reply_size, "ok op=%s size=%lld %s total=%.6f distribute=%.6f compute=%.6f reduce=%.6f\n",
+             job_op_names[job->op], result->size, value, result->total, result->phases[0], result->phases[1],
+             result->phases[2]);
+}
+
+int main(int argc, char* argv[]) {
+    Server srv;
+    int thread_support, listen_fd = -1;
+    long long jobs = 0, dropped = 0;
+    const char* socket_path = job_socket_path();
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+    MPI_Comm_rank(MPI_COMM_WORLD, &srv.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &srv.num_procs);
+    srv.threads = thread_support >= MPI_THREAD_FUNNELED ? threads_per_rank() : 1;
+    numa_setup(srv.threads, MPI_COMM_WORLD);
+
+    char* max_size_str = getenv("SERVER_MAX_SIZE");
+    char* max_inputs_str = getenv("SERVER_MAX_INPUTS");
+    srv.max_size = max_size_str ? atoll(max_size_str) : DEFAULT_MAX_SIZE;
+    srv.max_inputs = max_inputs_str ? atoi(max_inputs_str) : DEFAULT_MAX_INPUTS;
+    if (srv.max_size <= 0) srv.max_size = DEFAULT_MAX_SIZE;
+    if (srv.max_inputs < 1 || srv.max_inputs > EXPR_MAX_INPUTS) srv.max_inputs = DEFAULT_MAX_INPUTS;
+    char* timeout_str = getenv("SERVER_TIMEOUT");
+    int timeout = timeout_str ? atoi(timeout_str) : DEFAULT_TIMEOUT;
+    if (timeout <= 0) timeout = DEFAULT_TIMEOUT;
+
+    // Every buffer a job can need, once: an even split never gives a rank
+    // more than ceil(max / P) elements
+    srv.max_local = (srv.max_size + srv.num_procs - 1) / srv.num_procs;
+    size_t slice_bytes = (size_t)(srv.max_local > 0 ? srv.max_local : 1) * sizeof(double);
+    if (arena_init(&srv.arena, (size_t)(srv.max_inputs + 1) * arena_size(slice_bytes), srv.threads) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for the buffers of process %d\n", srv.rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    memset(srv.local, 0, sizeof(srv.local));
+    for (int k = 0; k < srv.max_inputs; k++) srv.local[k] = (double*)arena_alloc(&srv.arena, slice_bytes);
+    srv.out = (double*)arena_alloc(&srv.arena, slice_bytes);
+    if (!srv.out) {
+        fprintf(stderr, "Error: Arena too small for the buffers of process %d\n", srv.rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // The reductions of every job, set up once (common/comm_plan.h)
+    int persistent = comm_plan_persistent_from_env();
+    stats_mpi_init(&srv.stats_mpi);
+    if (comm_plan_reduce(&srv.sum_plan, &srv.local_sum, &srv.total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0,
+                         MPI_COMM_WORLD, persistent) != MPI_SUCCESS ||
+        comm_plan_reduce(&srv.stats_plan, &srv.local_stats, &srv.total_stats, 1, srv.stats_mpi.type,
+                         srv.stats_mpi.op, 0, MPI_COMM_WORLD, persistent) != MPI_SUCCESS) {
+        fprintf(stderr, "Error: Setting up the communication plans failed in process %d\n", srv.rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (srv.rank == 0) {
+        listen_fd = server_listen(socket_path);
+        if (listen_fd < 0) {
+            fprintf(stderr, "Error: Cannot listen on %s\n", socket_path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        printf("Server: listening on %s\n", socket_path);
+        printf("Layout: %d ranks x %d threads, jobs up to %lld elements, expressions up to %d inputs\n",
+               srv.num_procs, srv.threads, srv.max_size, srv.max_inputs);
+        printf("Collectives: %s\n", comm_plan_backend(persistent));
+        fflush(stdout);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (;;) {
+        Job job;
+        JobResult result;
+        Segment seg = {NULL, 0};
+        char line[JOB_LINE_MAX], reply[512];
+        int client = -1;
+
+        // Rank 0 takes requests until one can run, answering bad ones directly
+        while (srv.rank == 0) {
+            client = server_accept(listen_fd, timeout);
+            if (client < 0) continue;
+            memset(&result, 0, sizeof(result));
+            if (job_read_line(client, line) != 0) {
+                dropped++;
+                close(client);
+                continue;
+            }
+            if (job_parse(&job, line, result.error, sizeof(result.error)) == 0 &&
+                server_check(&srv, &job, &seg, &result) == 0) {
+                break;
+            }
+            server_format(&job, &result, reply, sizeof(reply));
+            server_reply(client, reply, &dropped);
+        }
+        MPI_Bcast(&job, (int)sizeof(job), MPI_BYTE, 0, MPI_COMM_WORLD);
+        if (job.op == JOB_SHUTDOWN) {
+            if (srv.rank == 0) {
+                snprintf(reply, sizeof(reply), "ok op=shutdown jobs=%lld\n", jobs);
+                server_reply(client, reply, &dropped);
+            }
+            break;
+        }
+
+        if (job.op == JOB_PING) {
+            // One barrier across the world: the floor of any job's latency
+            double start = MPI_Wtime();
+            MPI_Barrier(MPI_COMM_WORLD);
+            snprintf(reply, sizeof(reply), "ok op=ping ranks=%d total=%.6f\n", srv.num_procs, MPI_Wtime() - start);
+        } else {
+            memset(&result, 0, sizeof(result));
+            server_run(&srv, &job, &seg, &result);
+            server_format(&job, &result, reply, sizeof(reply));
+        }
+        jobs++;
+        if (srv.rank == 0) {
+            server_reply(client, reply, &dropped);
+            if (seg.data) munmap(seg.data, seg.bytes);
+        }
+    }
+
+    if (srv.rank == 0) {
+        close(listen_fd);
+        unlink(socket_path);
+        printf("Server: shut down after %lld jobs, %lld clients dropped (timed out or gone before the reply)\n",
+               jobs, dropped);
+    }
+    comm_plan_free(&srv.sum_plan);
+    comm_plan_free(&srv.stats_plan);
+    stats_mpi_free(&srv.stats_mpi);
+    arena_free(&srv.arena);
+    MPI_Finalize();
+    return 0;
+}
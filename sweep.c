@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "common/philox.h"
+#include "common/sum_kernels.h"
+#include "common/threads.h"
+#include "common/elementwise.h"
+#include "common/distribution.h"
+#include "common/large_count.h"
+#include "common/bench.h"
+#include "common/scan.h"
+
+// Strong/weak scaling sweep of the workloads (the array sum and the
+// distributed scan of Task1.c, OPERATION=scan, and the fused elementwise
+// operations of Task 3.c) in one MPI job. Every process
+// count of the grid runs on a sub-communicator of the first p world ranks,
+// so a single `mpirun -np P` produces the whole scaling curve.
+//
+// Environment:
+//   SWEEP_PROCS  process counts, comma separated (default 1, 2, 4, ... and P)
+//   SWEEP_SIZES  array sizes, comma separated (default 1000000,4000000);
+//                for weak scaling this is the size per process
+//   SWEEP_MODE   strong, weak or both (default)
+//   ITERATIONS   measured iterations per point (default 10), after warm-up
+
+#define DEFAULT_ITERATIONS 10
+#define MAX_POINTS 64
+
+typedef enum { WORKLOAD_SUM, WORKLOAD_ELEMENTWISE, WORKLOAD_SCAN, NUM_WORKLOADS } Workload;
+
+static const char* workload_names[] = {"sum", "elementwise", "scan"};
+
+typedef struct {
+    const char* mode;
+    Workload workload;
+    long long size;   // total elements
+    int procs;
+    double time;      // median seconds, slowest rank
+    double baseline;  // median seconds of the 1-process run it is compared with
+} SweepPoint;
+
+typedef struct {
+    int* arr;
+    double* a, * b;
+    double* add, * sub, * mul, * div;
+    int* local_arr;
+    double* local_a, * local_b;
+    long long* scan_out;  // the rank's running totals
+    ScanState scan;
+} SweepBuffers;
+
+// Comma separated list of positive integers; returns how many were parsed
+int parse_list(const char* str, long long* out, int max) {
+    int n = 0;
+    char* end;
+    while (str && *str && n < max) {
+        long long value = strtoll(str, &end, 10);
+        if (end == str) break;
+        if (value > 0) out[n++] = value;
+        str = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// Default grid: powers of two below the world size, then the world size
+int default_procs(int world_size, long long* out) {
+    int n = 0;
+    for (int p = 1; p < world_size && n < MAX_POINTS - 1; p *= 2) out[n++] = p;
+    out[n++] = world_size;
+    return n;
+}
+
+// One iteration on `comm`: scatter from rank 0, compute, and reduce (sum)
+// or exchange the slice offsets (scan). Returns this rank's elapsed time;
+// all ranks start together.
+double run_once(Workload workload, SweepBuffers* buf, const Distribution* dist,
+                int threads, MPI_Comm comm, long long* check) {
+    long long local = dist->local_count;
+    MPI_Barrier(comm);
+    double start = MPI_Wtime();
+    if (workload == WORKLOAD_SUM) {
+        long long local_sum, total = 0;
+        large_scatterv(buf->arr, dist->counts, dist->displs, MPI_INT,
+                       buf->local_arr, local, 0, comm);
+        local_sum = sum_i32_threaded(buf->local_arr, (size_t)local, threads);
+        MPI_Reduce(&local_sum, &total, 1, MPI_LONG_LONG, MPI_SUM, 0, comm);
+        *check = total;
+    } else if (workload == WORKLOAD_SCAN) {
+        long long local_sum, offset = 0;
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        large_scatterv(buf->arr, dist->counts, dist->displs, MPI_INT,
+                       buf->local_arr, local, 0, comm);
+        local_sum = scan_local(&buf->scan, buf->local_arr, ELEMENT_INT32, buf->scan_out, (size_t)local);
+        MPI_Exscan(&local_sum, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+        if (rank == 0) offset = 0;
+        scan_add_offset(&buf->scan, buf->scan_out, (size_t)local, offset);
+        *check = offset + local_sum;
+    } else {
+        large_scatterv(buf->a, dist->counts, dist->displs, MPI_DOUBLE,
+                       buf->local_a, local, 0, comm);
+        large_scatterv(buf->b, dist->counts, dist->displs, MPI_DOUBLE,
+                       buf->local_b, local, 0, comm);
+        ew_fused_threaded(buf->local_a, buf->local_b, buf->add, buf->sub, buf->mul, buf->div,
+                          (size_t)local, threads);
+    }
+    return MPI_Wtime() - start;
+}
+
+// Median time (slowest rank per iteration) of one workload at `size`
+// elements on `comm`; meaningful on rank 0 of `comm`.
+double measure(Workload workload, long long size, const BenchConfig* bench, int threads,
+               unsigned int seed, MPI_Comm comm) {
+    int rank, warming = bench->max_warmup > 0;
+    SweepBuffers buf = {0};
+    Distribution dist;
+    BenchSeries series;
+    BenchWarmup warmup = {{0}, 0};
+    BenchStats stats;
+    long long check = 0;
+
+    MPI_Comm_rank(comm, &rank);
+    int rc = distribution_init(&dist, size, NULL, comm);
+    rc |= bench_series_init(&series, workload_names[workload], bench->iterations);
+    if (rc != 0) {
+        printf("Error: Memory allocation failed for sweep bookkeeping\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    size_t local = (size_t)(dist.local_count > 0 ? dist.local_count : 1);
+    int failed;
+    if (workload == WORKLOAD_SUM || workload == WORKLOAD_SCAN) {
+        buf.local_arr = (int*)malloc(local * sizeof(int));
+        if (rank == 0) {
+            buf.arr = (int*)malloc((size_t)size * sizeof(int));
+            if (buf.arr) philox_fill_int(buf.arr, 0, (size_t)size, seed, 0, 100);
+        }
+        failed = !buf.local_arr || (rank == 0 && !buf.arr);
+        if (workload == WORKLOAD_SCAN) {
+            buf.scan_out = (long long*)malloc(local * sizeof(long long));
+            failed |= !buf.scan_out || scan_state_init(&buf.scan, threads) != 0;
+        }
+    } else {
+        buf.local_a = (double*)malloc(local * sizeof(double));
+        buf.local_b = (double*)malloc(local * sizeof(double));
+        buf.add = (double*)malloc(local * sizeof(double));
+        buf.sub = (double*)malloc(local * sizeof(double));
+        buf.mul = (double*)malloc(local * sizeof(double));
+        buf.div = (double*)malloc(local * sizeof(double));
+        if (rank == 0) {
+            buf.a = (double*)malloc((size_t)size * sizeof(double));
+            buf.b = (double*)malloc((size_t)size * sizeof(double));
+            if (buf.a && buf.b) {
+                philox_fill_double(buf.a, 0, (size_t)size, seed, 0, 1, 100);
+                philox_fill_double(buf.b, 0, (size_t)size, seed, 1, 1, 100);
+            }
+        }
+        failed = !buf.local_a || !buf.local_b || !buf.add || !buf.sub || !buf.mul || !buf.div ||
+                 (rank == 0 && (!buf.a || !buf.b));
+    }
+    if (failed) {
+        printf("Error: Memory allocation failed for %lld elements\n", size);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    for (int measured = 0; measured < bench->iterations;) {
+        double elapsed = run_once(workload, &buf, &dist, threads, comm, &check), slowest = 0.0;
+        MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+        if (warming) {
+            int done = 0;
+            if (rank == 0) done = bench_warmup_done(&warmup, bench, slowest);
+            MPI_Bcast(&done, 1, MPI_INT, 0, comm);
+            warming = !done;
+        } else {
+            if (rank == 0) bench_series_add(&series, slowest);
+            measured++;
+        }
+    }
+    bench_stats(&series, bench, &stats);
+
+    if (rank == 0 && workload == WORKLOAD_SUM && check != sum_i32(buf.arr, (size_t)size)) {
+        printf("Error: sweep sum check failed for %lld elements\n", size);
+    }
+    if (workload == WORKLOAD_SCAN) {
+        // The running total at the end of every slice, against rank 0's array
+        long long* lasts = (long long*)malloc((size_t)dist.num_procs * sizeof(long long));
+        if (!lasts) {
+            printf("Error: Memory allocation failed for the scan check\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Gather(&check, 1, MPI_LONG_LONG, lasts, 1, MPI_LONG_LONG, 0, comm);
+        long long running = 0;
+        for (int r = 0; rank == 0 && r < dist.num_procs; r++) {
+            running += sum_i32(buf.arr + dist.displs[r], (size_t)dist.counts[r]);
+            if (lasts[r] != running) {
+                printf("Error: sweep scan check failed for %lld elements\n", size);
+                break;
+            }
+        }
+        free(lasts);
+        scan_state_free(&buf.scan);
+    }
+
+    free(buf.arr); free(buf.a); free(buf.b);
+    free(buf.local_arr); free(buf.local_a); free(buf.local_b);
+    free(buf.add); free(buf.sub); free(buf.mul); free(buf.div);
+    free(buf.scan_out);
+    bench_series_free(&series);
+    distribution_free(&dist);
+    return stats.median;
+}
+
+// Karp-Flatt experimentally determined serial fraction
+// e = (1/S - 1/p) / (1 - 1/p); rising e with p means growing overhead
+// rather than a fixed serial part.
+double karp_flatt(double speedup, int procs) {
+    if (procs < 2 || speedup <= 0) return 0.0;
+    return (1.0 / speedup - 1.0 / procs) / (1.0 - 1.0 / procs);
+}
+
+// Strong scaling: S = T1(n) / Tp(n), E = S / p. Weak scaling compares
+// against the per-process size on one rank: E = T1(n) / Tp(p n), S = p E.
+void point_metrics(const SweepPoint* pt, double* speedup, double* efficiency) {
+    double ratio = pt->time > 0 ? pt->baseline / pt->time : 0.0;
+    if (strcmp(pt->mode, "weak") == 0) {
+        *efficiency = ratio;
+        *speedup = ratio * pt->procs;
+    } else {
+        *speedup = ratio;
+        *efficiency = ratio / pt->procs;
+    }
+}
+
+void print_points(const SweepPoint* points, int count, const BenchConfig* bench) {
+    double speedup, efficiency;
+    if (bench->format == BENCH_CSV) {
+        printf("mode,workload,size,procs,median,speedup,efficiency,karp_flatt\n");
+        for (int i = 0; i < count; i++) {
+            const SweepPoint* pt = &points[i];
+            point_metrics(pt, &speedup, &efficiency);
+            printf("%s,%s,%lld,%d,%.9f,%.4f,%.4f,%.4f\n", pt->mode, workload_names[pt->workload],
+                   pt->size, pt->procs, pt->time, speedup, efficiency, karp_flatt(speedup, pt->procs));
+        }
+        return;
+    }
+    if (bench->format == BENCH_JSON) {
+        printf("[");
+        for (int i = 0; i < count; i++) {
+            const SweepPoint* pt = &points[i];
+            point_metrics(pt, &speedup, &efficiency);
+            printf("%s{\"mode\":\"%s\",\"workload\":\"%s\",\"size\":%lld,\"procs\":%d,"
+                   "\"median\":%.9f,\"speedup\":%.4f,\"efficiency\":%.4f,\"karp_flatt\":%.4f}",
+                   i ? "," : "", pt->mode, workload_names[pt->workload], pt->size, pt->procs,
+                   pt->time, speedup, efficiency, karp_flatt(speedup, pt->procs));
+        }
+        printf("]\n");
+        return;
+    }
+
+    printf("%-7s %-12s %12s %6s %12s %9s %11s %11s\n",
+           "mode", "workload", "size", "procs", "median (s)", "speedup", "efficiency", "karp-flatt");
+    for (int i = 0; i < count; i++) {
+        const SweepPoint* pt = &points[i];
+        point_metrics(pt, &speedup, &efficiency);
+        printf("%-7s %-12s %12lld %6d %12.6f %8.2fx %10.1f%% ", pt->mode,
+               workload_names[pt->workload], pt->size, pt->procs, pt->time, speedup,
+               100.0 * efficiency);
+        if (pt->procs > 1) {
+            printf("%11.4f\n", karp_flatt(speedup, pt->procs));
+        } else {
+            printf("%11s\n", "-");
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int rank, world_size, thread_support, threads;
+    long long procs[MAX_POINTS], sizes[MAX_POINTS];
+    int num_procs, num_sizes, strong, weak;
+    SweepPoint* points;
+    int num_points = 0;
+    BenchConfig bench;
+    unsigned int seed = 12345;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    threads = thread_support >= MPI_THREAD_FUNNELED ? threads_per_rank() : 1;
+    bench_config_from_env(&bench, DEFAULT_ITERATIONS);
+
+    num_procs = parse_list(getenv("SWEEP_PROCS"), procs, MAX_POINTS);
+    if (num_procs == 0) num_procs = default_procs(world_size, procs);
+    num_sizes = parse_list(getenv("SWEEP_SIZES"), sizes, MAX_POINTS);
+    if (num_sizes == 0) {
+        sizes[0] = 1000000;
+        sizes[1] = 4000000;
+        num_sizes = 2;
+    }
+    char* mode_str = getenv("SWEEP_MODE");
+    strong = !mode_str || strcmp(mode_str, "weak") != 0;
+    weak = !mode_str || strcmp(mode_str, "strong") != 0;
+
+    for (int i = 0; i < num_procs; i++) {
+        if (procs[i] > world_size) {
+            if (rank == 0) {
+                printf("Error: SWEEP_PROCS asks for %lld processes, job has %d\n", procs[i], world_size);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    points = (SweepPoint*)malloc((size_t)2 * NUM_WORKLOADS * num_procs * num_sizes * sizeof(SweepPoint));
+    if (!points) {
+        printf("Error: Memory allocation failed for sweep results\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (rank == 0 && bench_human_output(&bench)) {
+        printf("=== Scaling sweep ===\n");
+        printf("World size: %d, threads per rank: %d, iterations per point: %d\n",
+               world_size, threads, bench.iterations);
+        printf("Sum kernel: %s, scan kernel: %s\n\n", sum_kernel()->name, scan_kernel()->name);
+    }
+
+    // Baselines on world rank 0 alone, then every (p, size, workload) point
+    // on the first p ranks. Rank 0 of each sub-communicator is world rank 0.
+    MPI_Comm solo;
+    MPI_Comm_split(MPI_COMM_WORLD, rank == 0 ? 0 : MPI_UNDEFINED, rank, &solo);
+    double baseline[NUM_WORKLOADS][MAX_POINTS] = {{0}};
+    for (int w = 0; w < NUM_WORKLOADS; w++) {
+        for (int s = 0; s < num_sizes; s++) {
+            if (solo != MPI_COMM_NULL) baseline[w][s] = measure((Workload)w, sizes[s], &bench, threads, seed, solo);
+        }
+    }
+    if (solo != MPI_COMM_NULL) MPI_Comm_free(&solo);
+
+    for (int m = 0; m < 2; m++) {
+        if ((m == 0 && !strong) || (m == 1 && !weak)) continue;
+        for (int w = 0; w < NUM_WORKLOADS; w++) {
+            for (int s = 0; s < num_sizes; s++) {
+                for (int i = 0; i < num_procs; i++) {
+                    int p = (int)procs[i];
+                    long long size = m == 0 ? sizes[s] : sizes[s] * p;
+                    if (p == 1) {
+                        // Same run as the baseline
+                        if (rank == 0) {
+                            SweepPoint pt = {m == 0 ? "strong" : "weak", (Workload)w, size, p,
+                                             baseline[w][s], baseline[w][s]};
+                            points[num_points++] = pt;
+                        }
+                        continue;
+                    }
+                    MPI_Comm sub;
+                    MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &sub);
+                    if (sub == MPI_COMM_NULL) continue;
+                    double time = measure((Workload)w, size, &bench, threads, seed, sub);
+                    MPI_Comm_free(&sub);
+                    if (rank == 0) {
+                        SweepPoint pt = {m == 0 ? "strong" : "weak", (Workload)w, size, p,
+                                         time, baseline[w][s]};
+                        points[num_points++] = pt;
+                    }
+                }
+            }
+        }
+    }
+
+    if (rank == 0) print_points(points, num_points, &bench);
+    free(points);
+
+    MPI_Finalize();
+    return 0;
+}
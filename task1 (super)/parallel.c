@@ -1,67 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
-#include <locale.h>
-
-void fill_array(int* arr, int size, unsigned int seed) {
-    srand(seed);
-    for (int i = 0; i < size; i++) {
-        arr[i] = rand() % 100;
-    }
-}
-
-long long calculate_sum(int* arr, int size) {
-    long long sum = 0;
-    for (int i = 0; i < size; i++) {
-        sum += arr[i];
-    }
-    return sum;
-}
-
-int main() {
-    setlocale(LC_ALL, "ru");
-
-    // Получение размера массива из переменных окружения
-    char* size_str = getenv("ARRAY_SIZE");
-    int array_size = size_str ? atoi(size_str) : 1000000;
-    unsigned int seed = (unsigned int)time(NULL);
-
-    // Выделение памяти
-    int* arr = malloc(array_size * sizeof(int));
-    if (!arr) {
-        fprintf(stderr, "Ошибка выделения памяти\n");
-        return 1;
-    }
-
-    // Заполнение массива
-    fill_array(arr, array_size, seed);
-
-    // Вычисление суммы с замером времени
-    clock_t start = clock();
-    long long sum = calculate_sum(arr, array_size);
-    clock_t end = clock();
-
-    // Вывод результатов
-    printf("=== Последовательная версия ===\n");
-    printf("Размер массива: %d\n", array_size);
-    printf("Сумма элементов: %lld\n", sum);
-    printf("Время выполнения: %.3f мс\n",
-          (double)(end - start) * 1000 / CLOCKS_PER_SEC);
-
-    free(arr);
-    return 0;
-}
-[ilyaafanasyev05.gmail.com@mgr Task_1]$ ^C
-[ilyaafanasyev05.gmail.com@mgr Task_1]$ cat parallel.c
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
 #include <mpi.h>
 #include <locale.h>
+#include "../common/sum_kernels.h"
+#include "../common/distribution.h"
+#include "../common/large_count.h"
+#include "../common/bench.h"
+#include "../common/arena.h"
 
-void fill_array(int* arr, int size, unsigned int seed) {
+void fill_array(int* arr, long long size, unsigned int seed) {
     srand(seed);
-    for (int i = 0; i < size; i++) {
+    for (long long i = 0; i < size; i++) {
         arr[i] = rand() % 100;
     }
 }
@@ -75,51 +25,132 @@ int main(int argc, char** argv) {
 
     // Получение параметров
     char* size_str = getenv("ARRAY_SIZE");
-    int array_size = size_str ? atoi(size_str) : 1000000;
-    int local_size = array_size / num_procs;
+    long long array_size = size_str ? atoll(size_str) : 1000000;
+    // Распределение любого размера: остаток не теряется (large_scatterv,
+    // 64-битные счётчики)
+    Distribution dist;
+    if (distribution_init(&dist, array_size, NULL, MPI_COMM_WORLD) != 0) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    long long local_size = dist.local_count;
     unsigned int seed = (unsigned int)time(NULL);
 
-    // Выделение памяти
+    // Выделение памяти: один раз из арены процесса (выравнивание, большие
+    // страницы), внутри цикла замеров ничего не выделяется
+    Arena arena;
+    size_t local_bytes = (size_t)local_size * sizeof(int);
+    size_t full_bytes = rank == 0 ? (size_t)array_size * sizeof(int) : 0;
+    numa_setup(1, MPI_COMM_WORLD);
     int* arr = NULL;
-    int* local_arr = malloc(local_size * sizeof(int));
+    int* local_arr = NULL;
+    if (arena_init(&arena, arena_size(local_bytes) + arena_size(full_bytes), 1) == 0) {
+        local_arr = arena_alloc(&arena, local_bytes);
+        if (rank == 0) arr = arena_alloc(&arena, full_bytes);
+    }
+    if (!local_arr || (rank == 0 && !arr)) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     long long local_sum = 0, global_sum = 0;
+    MemUsage mem_before, mem_after;
 
     // Главный процесс готовит данные
     if (rank == 0) {
-        arr = malloc(array_size * sizeof(int));
         fill_array(arr, array_size, seed);
     }
 
-    // Замер времени работы MPI
-    double start_time = MPI_Wtime();
-
-    // Распределение данных
-    MPI_Scatter(arr, local_size, MPI_INT,
-               local_arr, local_size, MPI_INT,
-               0, MPI_COMM_WORLD);
-
-    // Локальные вычисления
-    for (int i = 0; i < local_size; i++) {
-        local_sum += local_arr[i];
+    // Прогрев до стабилизации (решает процесс 0), затем ITERATIONS замеров
+    // распределения, суммирования и сбора (по умолчанию 10)
+    BenchConfig bench;
+    BenchSeries series[2];
+    BenchWarmup warmup = {{0}, 0};
+    int warming, warmup_iterations = 0;
+    bench_config_from_env(&bench, 10);
+    if (bench_series_init(&series[0], "total", bench.iterations) != 0 ||
+        bench_series_init(&series[1], "compute", bench.iterations) != 0) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    warming = bench.max_warmup > 0;
+    mem_usage_now(&mem_before);
+
+    for (int measured = 0; measured < bench.iterations;) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_time = MPI_Wtime();
+
+        // Распределение данных
+        large_scatterv(arr, dist.counts, dist.displs, MPI_INT,
+                       local_arr, local_size, 0, MPI_COMM_WORLD);
+
+        // Локальные вычисления
+        double compute_start = MPI_Wtime();
+        local_sum = sum_i32(local_arr, (size_t)local_size);
+        double compute_time = MPI_Wtime() - compute_start;
+
+        // Сбор результатов
+        MPI_Reduce(&local_sum, &global_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        double end_time = MPI_Wtime();
+
+        // Время вычислений самого медленного процесса
+        double max_compute_time = 0.0;
+        MPI_Reduce(&compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        if (warming) {
+            int done = 0;
+            if (rank == 0) done = bench_warmup_done(&warmup, &bench, end_time - start_time);
+            MPI_Bcast(&done, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            warmup_iterations++;
+            warming = !done;
+            if (!warming) mem_usage_now(&mem_before);
+        } else {
+            if (rank == 0) {
+                bench_series_add(&series[0], end_time - start_time);
+                bench_series_add(&series[1], max_compute_time);
+            }
+            measured++;
+        }
     }
 
-    // Сбор результатов
-    MPI_Reduce(&local_sum, &global_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-
-    double end_time = MPI_Wtime();
+    mem_usage_now(&mem_after);
 
     // Вывод результатов
     if (rank == 0) {
-        printf("\n=== Параллельная версия ===\n");
-        printf("Размер массива: %d\n", array_size);
-        printf("Количество процессов: %d\n", num_procs);
-        printf("Сумма элементов: %lld\n", global_sum);
-        printf("Время выполнения: %.3f мс\n", (end_time - start_time) * 1000);
-
-        free(arr);
+        BenchStats total, compute;
+        bench_stats(&series[0], &bench, &total);
+        bench_stats(&series[1], &bench, &compute);
+        // Пропускная способность локального суммирования (по самому медленному процессу)
+        double gbs = sum_i32_gbs((size_t)array_size, compute.median);
+
+        if (bench_human_output(&bench)) {
+            printf("\n=== Параллельная версия ===\n");
+            printf("Размер массива: %lld\n", array_size);
+            printf("Количество процессов: %d\n", num_procs);
+            printf("Сумма элементов: %lld\n", global_sum);
+            printf("Время выполнения (медиана): %.3f мс\n", total.median * 1000);
+
+            double node_bw = node_mem_bw_gbs();
+            printf("Ядро суммирования: %s\n", sum_kernel()->name);
+            printf("Пропускная способность: %.2f ГБ/с", gbs);
+            if (node_bw > 0) {
+                printf(" (%.1f%% от %.1f ГБ/с узла)", 100.0 * gbs / node_bw, node_bw);
+            }
+            printf("\n");
+        }
+
+        BenchParam params[3];
+        bench_param(&params[0], "array_size", "%.0f", array_size);
+        bench_param(&params[1], "processes", "%.0f", num_procs);
+        bench_param_str(&params[2], "sum_kernel", sum_kernel()->name);
+        bench_report(&bench, "task1_parallel", series, 2, params, 3, warmup_iterations);
     }
+    if (bench_human_output(&bench)) mem_usage_report(&mem_before, &mem_after, MPI_COMM_WORLD);
 
-    free(local_arr);
+    bench_series_free(&series[0]);
+    bench_series_free(&series[1]);
+    arena_free(&arena);
+    distribution_free(&dist);
     MPI_Finalize();
     return 0;
 }
@@ -2,20 +2,30 @@
 #include <stdlib.h>
 #include <time.h>
 #include <locale.h>
+#include "../common/sum_kernels.h"
+#include "../common/bench.h"
 
-void fill_array(int* arr, int size, unsigned int seed) {
+void fill_array(int* arr, long long size, unsigned int seed) {
     srand(seed);
-    for (int i = 0; i < size; i++) {
+    for (long long i = 0; i < size; i++) {
         arr[i] = rand() % 100;
     }
 }
 
-long long calculate_sum(int* arr, int size) {
-    long long sum = 0;
-    for (int i = 0; i < size; i++) {
-        sum += arr[i];
+long long calculate_sum(int* arr, long long size) {
+    return sum_i32(arr, (size_t)size);
+}
+
+// Вывод ядра суммирования и достигнутой пропускной способности памяти
+void print_bandwidth(long long array_size, double seconds) {
+    double gbs = sum_i32_gbs((size_t)array_size, seconds);
+    double node_bw = node_mem_bw_gbs();
+    printf("Ядро суммирования: %s\n", sum_kernel()->name);
+    printf("Пропускная способность: %.2f ГБ/с", gbs);
+    if (node_bw > 0) {
+        printf(" (%.1f%% от %.1f ГБ/с узла)", 100.0 * gbs / node_bw, node_bw);
     }
-    return sum;
+    printf("\n");
 }
 
 int main() {
@@ -23,11 +33,11 @@ int main() {
 
     // Получение размера массива из переменных окружения
     char* size_str = getenv("ARRAY_SIZE");
-    int array_size = size_str ? atoi(size_str) : 1000000;
+    long long array_size = size_str ? atoll(size_str) : 1000000;
     unsigned int seed = (unsigned int)time(NULL);
 
     // Выделение памяти
-    int* arr = malloc(array_size * sizeof(int));
+    int* arr = malloc((size_t)array_size * sizeof(int));
     if (!arr) {
         fprintf(stderr, "Ошибка выделения памяти\n");
         return 1;
@@ -36,18 +46,51 @@ int main() {
     // Заполнение массива
     fill_array(arr, array_size, seed);
 
-    // Вычисление суммы с замером времени
-    clock_t start = clock();
-    long long sum = calculate_sum(arr, array_size);
-    clock_t end = clock();
+    // Прогрев до стабилизации, затем ITERATIONS замеров (по умолчанию 10);
+    // время — настенное (clock() считает процессорное время)
+    BenchConfig bench;
+    BenchSeries series;
+    BenchWarmup warmup = {{0}, 0};
+    MemUsage mem_before, mem_after, mem;
+    int warmup_iterations = 0;
+    long long sum = 0;
+    bench_config_from_env(&bench, 10);
+    if (bench_series_init(&series, "sum", bench.iterations) != 0) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        return 1;
+    }
+    for (int warming = bench.max_warmup > 0; warming; warmup_iterations++) {
+        double start = bench_now();
+        sum = calculate_sum(arr, array_size);
+        warming = !bench_warmup_done(&warmup, &bench, bench_now() - start);
+    }
+    mem_usage_now(&mem_before);
+    for (int iter = 0; iter < bench.iterations; iter++) {
+        double start = bench_now();
+        sum = calculate_sum(arr, array_size);
+        bench_series_add(&series, bench_now() - start);
+    }
+    mem_usage_now(&mem_after);
+    mem = mem_usage_delta(&mem_before, &mem_after);
+    BenchStats stats;
+    bench_stats(&series, &bench, &stats);
 
     // Вывод результатов
-    printf("=== Последовательная версия ===\n");
-    printf("Размер массива: %d\n", array_size);
-    printf("Сумма элементов: %lld\n", sum);
-    printf("Время выполнения: %.3f мс\n",
-          (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+    if (bench_human_output(&bench)) {
+        printf("=== Последовательная версия ===\n");
+        printf("Размер массива: %lld\n", array_size);
+        printf("Сумма элементов: %lld\n", sum);
+        printf("Время выполнения (медиана): %.3f мс\n", stats.median * 1000);
+        print_bandwidth(array_size, stats.median);
+        printf("Память (за время замеров): ");
+        mem_usage_print(&mem);
+    }
+    BenchParam params[2];
+    bench_param(&params[0], "array_size", "%.0f", array_size);
+    bench_param_str(&params[1], "sum_kernel", sum_kernel()->name);
+    bench_report(&bench, "task1_sequential", &series, 1, params, 2, warmup_iterations);
 
+    bench_series_free(&series);
     free(arr);
     return 0;
 }
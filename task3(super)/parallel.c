@@ -3,46 +3,78 @@
 #include <time.h>
 #include <mpi.h>
 #include <string.h>
+#include "../common/elementwise.h"
+#include "../common/distribution.h"
+#include "../common/large_count.h"
+#include "../common/bench.h"
+#include "../common/arena.h"
+#include "../common/result_store.h"
 
 typedef struct {
     double add_time;
     double sub_time;
     double mul_time;
     double div_time;
+    double fused_time;
 } OperationTimes;
 
-void fill_array(double* arr, int size) {
+void fill_array(double* arr, long long size) {
     unsigned int seed = time(NULL) + MPI_Wtime();
-    for (int i = 0; i < size; i++) {
+    for (long long i = 0; i < size; i++) {
         arr[i] = (double)rand_r(&seed) / RAND_MAX * 100.0;
     }
 }
 
 void array_ops_timed(double* a, double* b, double* res_add, double* res_sub,
-                    double* res_mul, double* res_div, int size, OperationTimes* times) {
+                    double* res_mul, double* res_div, long long size, EwOp div_op, OperationTimes* times) {
     double start;
     
     // Сложение
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) res_add[i] = a[i] + b[i];
+    ew_op(EW_ADD, a, b, res_add, (size_t)size, 1);
     times->add_time = MPI_Wtime() - start;
     
     // Вычитание
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) res_sub[i] = a[i] - b[i];
+    ew_op(EW_SUB, a, b, res_sub, (size_t)size, 1);
     times->sub_time = MPI_Wtime() - start;
     
     // Умножение
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) res_mul[i] = a[i] * b[i];
+    ew_op(EW_MUL, a, b, res_mul, (size_t)size, 1);
     times->mul_time = MPI_Wtime() - start;
     
     // Деление
     start = MPI_Wtime();
-    for (int i = 0; i < size; i++) res_div[i] = b[i] != 0 ? a[i] / b[i] : 0;
+    ew_op(div_op, a, b, res_div, (size_t)size, 1);
     times->div_time = MPI_Wtime() - start;
 }
 
+// Все четыре операции за один потоковый проход (ELEMENTWISE=fused)
+void array_ops_fused(double* a, double* b, double* res_add, double* res_sub,
+                    double* res_mul, double* res_div, long long size, OperationTimes* times) {
+    double start = MPI_Wtime();
+    ew_fused(a, b, res_add, res_sub, res_mul, res_div, (size_t)size);
+    times->fused_time = MPI_Wtime() - start;
+}
+
+// Имена серий замеров: одна в режиме fused, четыре в режиме timed
+static const char* fused_series[] = {"fused"};
+static const char* timed_series[] = {"add", "sub", "mul", "div"};
+
+// Замеры одной итерации в порядке серий; возвращает их число
+int operation_samples(const OperationTimes* times, int fused, double* out) {
+    if (fused) {
+        out[0] = times->fused_time;
+        return 1;
+    }
+    out[0] = times->add_time;
+    out[1] = times->sub_time;
+    out[2] = times->mul_time;
+    out[3] = times->div_time;
+    return 4;
+}
+
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv);
 
@@ -58,91 +90,230 @@ int main(int argc, char** argv) {
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    int array_size = atoi(array_size_str);
+    long long array_size = atoll(array_size_str);
     if (array_size <= 0 && rank == 0) {
-        fprintf(stderr, "Error: Invalid array size %d\n", array_size);
+        fprintf(stderr, "Error: Invalid array size %lld\n", array_size);
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    // Проверка делимости размера массива
-    if (array_size % num_procs != 0 && rank == 0) {
-        fprintf(stderr, "Warning: Array size (%d) not divisible by number of processes (%d)\n",
-                array_size, num_procs);
+    // Результаты остаются на процессах (по умолчанию), собираются на
+    // процессе 0 или пишутся в файлы (RESULT_MODE, см. result_store.h)
+    int result_mode = result_mode_from_env();
+    if (result_mode < 0 && rank == 0) {
+        fprintf(stderr, "Error: Invalid RESULT_MODE %s (distributed, gather or file)\n", getenv("RESULT_MODE"));
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    const char* result_prefix = getenv("RESULT_PREFIX") ? getenv("RESULT_PREFIX") : "result";
 
-    int local_size = array_size / num_procs;
+    // Распределение любого размера: первые array_size % num_procs процессов
+    // получают на один элемент больше (large_scatterv/large_gatherv)
+    Distribution dist;
+    if (distribution_init(&dist, array_size, NULL, MPI_COMM_WORLD) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for distribution\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    long long local_size = dist.local_count;
+    // Все буферы один раз из арены процесса: шесть локальных частей, а у
+    // процесса 0 ещё a и b (и четыре массива результатов при RESULT_MODE=gather)
+    Arena arena;
+    size_t local_bytes = (size_t)local_size * sizeof(double);
+    size_t full_bytes = rank == 0 ? (size_t)array_size * sizeof(double) : 0;
+    numa_setup(1, MPI_COMM_WORLD);
     double *a = NULL, *b = NULL;
-    double *local_a = malloc(local_size * sizeof(double));
-    double *local_b = malloc(local_size * sizeof(double));
-    double *local_add = malloc(local_size * sizeof(double));
-    double *local_sub = malloc(local_size * sizeof(double));
-    double *local_mul = malloc(local_size * sizeof(double));
-    double *local_div = malloc(local_size * sizeof(double));
+    double *res_add = NULL, *res_sub = NULL, *res_mul = NULL, *res_div = NULL;
+    double *local_a = NULL, *local_b = NULL;
+    double *local_add = NULL, *local_sub = NULL, *local_mul = NULL, *local_div = NULL;
+    int num_full = result_mode == RESULT_GATHER ? 6 : 2;
+    int allocated = arena_init(&arena, 6 * arena_size(local_bytes) + num_full * arena_size(full_bytes), 1) == 0;
+    double** local_bufs[6] = {&local_a, &local_b, &local_add, &local_sub, &local_mul, &local_div};
+    double** full_bufs[6] = {&a, &b, &res_add, &res_sub, &res_mul, &res_div};
+    for (int i = 0; allocated && i < 6; i++) {
+        *local_bufs[i] = arena_alloc(&arena, local_bytes);
+        if (rank == 0 && i < num_full) *full_bufs[i] = arena_alloc(&arena, full_bytes);
+        allocated = *local_bufs[i] && (rank != 0 || i >= num_full || *full_bufs[i]);
+    }
+    if (!allocated) {
+        fprintf(stderr, "Error: Memory allocation failed for the buffer arena\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MemUsage mem_before, mem_after;
 
     // Главный процесс заполняет массивы
     if (rank == 0) {
-        a = malloc(array_size * sizeof(double));
-        b = malloc(array_size * sizeof(double));
         fill_array(a, array_size);
         fill_array(b, array_size);
     }
 
-    // Распределение данных
-    MPI_Scatter(a, local_size, MPI_DOUBLE, local_a, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Scatter(b, local_size, MPI_DOUBLE, local_b, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    // Режим: fused (по умолчанию) или timed (отдельный проход на операцию)
+    char* elementwise_str = getenv("ELEMENTWISE");
+    int fused = !(elementwise_str && strcmp(elementwise_str, "timed") == 0);
 
-    // Локальные вычисления с замером времени
-    OperationTimes local_times;
-    array_ops_timed(local_a, local_b, local_add, local_sub, local_mul, local_div, local_size, &local_times);
+    // Деление в режиме timed: exact (по умолчанию) или fast, через обратную
+    // величину, не дальше DIV_FAST_MAX_ULP от точного (common/fast_div.h)
+    int div_mode = div_mode_from_env();
+    if (div_mode < 0) {
+        if (rank == 0) fprintf(stderr, "Error: DIV_MODE must be exact or fast\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    EwOp div_op = div_mode ? EW_DIV_FAST : EW_DIV;
 
-    // Сбор результатов времени выполнения операций
-    OperationTimes global_times;
-    MPI_Reduce(&local_times.add_time, &global_times.add_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&local_times.sub_time, &global_times.sub_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&local_times.mul_time, &global_times.mul_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&local_times.div_time, &global_times.div_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    // Прогрев до стабилизации (решает процесс 0), затем ITERATIONS замеров
+    // (по умолчанию 10): распределение, вычисления и максимум времени по процессам
+    BenchConfig bench;
+    BenchSeries series[5];  // серии операций и "total" (распределение + вычисления)
+    BenchStats stats[5];
+    BenchWarmup warmup = {{0}, 0};
+    int num_ops = fused ? 1 : 4, warming, warmup_iterations = 0;
+    bench_config_from_env(&bench, 10);
+    for (int i = 0; i <= num_ops; i++) {
+        const char* name = i == num_ops ? "total" : fused ? fused_series[i] : timed_series[i];
+        if (bench_series_init(&series[i], name, bench.iterations) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed for benchmark samples\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    warming = bench.max_warmup > 0;
+    mem_usage_now(&mem_before);
 
-    // Сбор результатов вычислений
-    double *res_add = NULL, *res_sub = NULL, *res_mul = NULL, *res_div = NULL;
-    if (rank == 0) {
-        res_add = malloc(array_size * sizeof(double));
-        res_sub = malloc(array_size * sizeof(double));
-        res_mul = malloc(array_size * sizeof(double));
-        res_div = malloc(array_size * sizeof(double));
+    for (int measured = 0; measured < bench.iterations;) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_time = MPI_Wtime();
+
+        // Распределение данных
+        large_scatterv(a, dist.counts, dist.displs, MPI_DOUBLE, local_a, local_size, 0, MPI_COMM_WORLD);
+        large_scatterv(b, dist.counts, dist.displs, MPI_DOUBLE, local_b, local_size, 0, MPI_COMM_WORLD);
+
+        // Локальные вычисления с замером времени
+        OperationTimes local_times = {0};
+        if (fused) {
+            array_ops_fused(local_a, local_b, local_add, local_sub, local_mul, local_div, local_size, &local_times);
+        } else {
+            array_ops_timed(local_a, local_b, local_add, local_sub, local_mul, local_div, local_size, div_op,
+                            &local_times);
+        }
+        double elapsed = MPI_Wtime() - start_time;
+
+        // Время самого медленного процесса
+        double local_samples[5], max_samples[5];
+        operation_samples(&local_times, fused, local_samples);
+        local_samples[num_ops] = elapsed;
+        MPI_Reduce(local_samples, max_samples, num_ops + 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        if (warming) {
+            int done = 0;
+            if (rank == 0) done = bench_warmup_done(&warmup, &bench, max_samples[num_ops]);
+            MPI_Bcast(&done, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            warmup_iterations++;
+            warming = !done;
+            if (!warming) mem_usage_now(&mem_before);
+        } else {
+            if (rank == 0) {
+                for (int i = 0; i <= num_ops; i++) bench_series_add(&series[i], max_samples[i]);
+            }
+            measured++;
+        }
     }
 
-    MPI_Gather(local_add, local_size, MPI_DOUBLE, res_add, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Gather(local_sub, local_size, MPI_DOUBLE, res_sub, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Gather(local_mul, local_size, MPI_DOUBLE, res_mul, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Gather(local_div, local_size, MPI_DOUBLE, res_div, local_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    mem_usage_now(&mem_after);
+
+    // Результаты: контрольная сумма складывается из частей процессов;
+    // элементы RESULT_RANGE процесс 0 берёт из собранного массива или
+    // читает у владельцев через MPI_Get
+    static const char* result_names[4] = {"add", "sub", "mul", "div"};
+    double* local_results[4] = {local_add, local_sub, local_mul, local_div};
+    double* full_results[4] = {res_add, res_sub, res_mul, res_div};
+    uint64_t checksums[4];
+    long long show_first, show_count;
+    int results_ok = 1;
+    result_range_from_env(array_size, &show_first, &show_count);
+    double* shown = rank == 0 ? malloc((size_t)(4 * show_count + 1) * sizeof(double)) : NULL;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double result_start = MPI_Wtime();
+    for (int i = 0; i < 4; i++) {
+        if (result_mode == RESULT_FILE) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s_%s.arr", result_prefix, result_names[i]);
+            if (array_output_write(path, ARRAYFILE_FLOAT64, local_results[i], dist.local_first, local_size,
+                                   array_size, &checksums[i], MPI_COMM_WORLD) != 0) {
+                results_ok = 0;
+            }
+        } else {
+            checksums[i] = arrayfile_checksum_all(local_results[i], ARRAYFILE_FLOAT64, dist.local_first,
+                                                  local_size, MPI_COMM_WORLD);
+        }
+        if (result_mode == RESULT_GATHER) {
+            large_gatherv(local_results[i], local_size, full_results[i], dist.counts, dist.displs, MPI_DOUBLE,
+                          0, MPI_COMM_WORLD);
+            if (rank == 0) {
+                // Собранный массив должен дать ту же сумму, что и части
+                results_ok = results_ok && arrayfile_checksum(full_results[i], ARRAYFILE_FLOAT64, 0,
+                                                              (size_t)array_size) == checksums[i];
+                memcpy(shown + i * show_count, full_results[i] + show_first, (size_t)show_count * sizeof(double));
+            }
+        } else {
+            ResultArray result;
+            result_array_init(&result, local_results[i], &dist, MPI_DOUBLE, MPI_COMM_WORLD);
+            if (rank == 0) result_array_get(&result, show_first, show_count, shown + i * show_count);
+            result_array_free(&result);
+        }
+    }
+    double result_time = MPI_Wtime() - result_start;
+    MPI_Allreduce(MPI_IN_PLACE, &results_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
 
     // Вывод результатов
     if (rank == 0) {
-        printf("\nParallel version results:\n");
-        printf("Array size: %d\n", array_size);
-        printf("Number of processes: %d\n", num_procs);
-        
-        printf("\nExecution times (max across all processes):\n");
-        printf("Addition time:    %.3f ms\n", global_times.add_time * 1000);
-        printf("Subtraction time: %.3f ms\n", global_times.sub_time * 1000);
-        printf("Multiplication time: %.3f ms\n", global_times.mul_time * 1000);
-        printf("Division time:    %.3f ms\n", global_times.div_time * 1000);
-        
-        printf("\nFirst 5 results:\n");
-        for (int i = 0; i < 5 && i < array_size; i++) {
-            printf("[%d] +:%.2f -:%.2f *:%.2f /:%.2f\n",
-                  i, res_add[i], res_sub[i], res_mul[i], res_div[i]);
-        }
+        for (int i = 0; i <= num_ops; i++) bench_stats(&series[i], &bench, &stats[i]);
+        if (bench_human_output(&bench)) {
+            printf("\nParallel version results:\n");
+            printf("Array size: %lld\n", array_size);
+            printf("Number of processes: %d\n", num_procs);
+
+            printf("\nExecution times (max across all processes, median of %d):\n", bench.iterations);
+            if (fused) {
+                printf("Fused (all four) time: %.3f ms\n", stats[0].median * 1000);
+            } else {
+                printf("Addition time:    %.3f ms\n", stats[0].median * 1000);
+                printf("Subtraction time: %.3f ms\n", stats[1].median * 1000);
+                printf("Multiplication time: %.3f ms\n", stats[2].median * 1000);
+                printf("Division time:    %.3f ms (%s, %s)\n", stats[3].median * 1000,
+                       div_mode ? "fast" : "exact", div_kernel(div_mode)->name);
+            }
+            printf("With scatter: %.3f ms\n", stats[num_ops].median * 1000);
+            printf("Memory traffic: %.1f MB (four passes: %.1f MB)\n",
+                   ew_traffic_bytes((size_t)array_size, fused) / 1e6,
+                   ew_traffic_bytes((size_t)array_size, 0) / 1e6);
 
-        free(a); free(b);
-        free(res_add); free(res_sub);
-        free(res_mul); free(res_div);
+            printf("\nResults (%s", result_mode_name(result_mode));
+            if (result_mode == RESULT_FILE) printf(", %s_{add,sub,mul,div}.arr", result_prefix);
+            printf("): %.3f ms\n", result_time * 1000);
+            for (int i = 0; i < 4; i++) {
+                printf("Checksum %s: %016llx\n", result_names[i], (unsigned long long)checksums[i]);
+            }
+            printf("\nResults [%lld, %lld):\n", show_first, show_first + show_count);
+            for (long long i = 0; i < show_count; i++) {
+                printf("[%lld] +:%.2f -:%.2f *:%.2f /:%.2f\n", show_first + i, shown[i],
+                       shown[show_count + i], shown[2 * show_count + i], shown[3 * show_count + i]);
+            }
+        }
+        if (!results_ok) {
+            fprintf(stderr, "Error: %s\n", result_mode == RESULT_FILE ? "Writing the result files failed"
+                                                                        : "Gathered results do not match the checksums");
+        }
+        BenchParam params[5];
+        bench_param(&params[0], "array_size", "%.0f", array_size);
+        bench_param(&params[1], "processes", "%.0f", num_procs);
+        bench_param_str(&params[2], "elementwise", fused ? "fused" : "timed");
+        bench_param_str(&params[3], "result_mode", result_mode_name(result_mode));
+        bench_param_str(&params[4], "div_mode", div_mode ? "fast" : "exact");
+        bench_report(&bench, "task3_parallel", series, num_ops + 1, params, 5, warmup_iterations);
     }
+    if (bench_human_output(&bench)) mem_usage_report(&mem_before, &mem_after, MPI_COMM_WORLD);
 
-    free(local_a); free(local_b);
-    free(local_add); free(local_sub);
-    free(local_mul); free(local_div);
+    free(shown);
+    arena_free(&arena);
+    distribution_free(&dist);
+    for (int i = 0; i <= num_ops; i++) bench_series_free(&series[i]);
 
     MPI_Finalize();
-    return 0;
+    return results_ok ? 0 : 1;
 }
@@ -2,46 +2,74 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include "../common/elementwise.h"
+#include "../common/bench.h"
 
 typedef struct {
     double add_time;
     double sub_time;
     double mul_time;
     double div_time;
+    double fused_time;
 } OperationTimes;
 
-void fill_array(double* arr, int size) {
-    for (int i = 0; i < size; i++) {
+void fill_array(double* arr, long long size) {
+    for (long long i = 0; i < size; i++) {
         arr[i] = (double)rand() / RAND_MAX * 100.0;
     }
 }
 
 void array_ops_timed(double* a, double* b, double* res_add, double* res_sub,
-                    double* res_mul, double* res_div, int size, OperationTimes* times) {
-    clock_t start;
+                    double* res_mul, double* res_div, long long size, EwOp div_op, OperationTimes* times) {
+    double start;
     
     // Сложение
-    start = clock();
-    for (int i = 0; i < size; i++) res_add[i] = a[i] + b[i];
-    times->add_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = bench_now();
+    ew_op(EW_ADD, a, b, res_add, (size_t)size, 1);
+    times->add_time = bench_now() - start;
     
     // Вычитание
-    start = clock();
-    for (int i = 0; i < size; i++) res_sub[i] = a[i] - b[i];
-    times->sub_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = bench_now();
+    ew_op(EW_SUB, a, b, res_sub, (size_t)size, 1);
+    times->sub_time = bench_now() - start;
     
     // Умножение
-    start = clock();
-    for (int i = 0; i < size; i++) res_mul[i] = a[i] * b[i];
-    times->mul_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = bench_now();
+    ew_op(EW_MUL, a, b, res_mul, (size_t)size, 1);
+    times->mul_time = bench_now() - start;
     
     // Деление
-    start = clock();
-    for (int i = 0; i < size; i++) res_div[i] = b[i] != 0 ? a[i] / b[i] : 0;
-    times->div_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = bench_now();
+    ew_op(div_op, a, b, res_div, (size_t)size, 1);
+    times->div_time = bench_now() - start;
 }
 
-int main(int argc, char** argv) {
+// Все четыре операции за один потоковый проход (ELEMENTWISE=fused)
+void array_ops_fused(double* a, double* b, double* res_add, double* res_sub,
+                    double* res_mul, double* res_div, long long size, OperationTimes* times) {
+    double start = bench_now();
+    ew_fused(a, b, res_add, res_sub, res_mul, res_div, (size_t)size);
+    times->fused_time = bench_now() - start;
+}
+
+// Имена серий замеров: одна в режиме fused, четыре в режиме timed
+static const char* fused_series[] = {"fused"};
+static const char* timed_series[] = {"add", "sub", "mul", "div"};
+
+// Замеры одной итерации в порядке серий; возвращает их число
+int operation_samples(const OperationTimes* times, int fused, double* out) {
+    if (fused) {
+        out[0] = times->fused_time;
+        return 1;
+    }
+    out[0] = times->add_time;
+    out[1] = times->sub_time;
+    out[2] = times->mul_time;
+    out[3] = times->div_time;
+    return 4;
+}
+
+int main(void) {
     // Получение размера массива из переменных окружения
     char* array_size_str = getenv("ARRAY_SIZE");
     if (!array_size_str) {
@@ -50,37 +78,106 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    int array_size = atoi(array_size_str);
+    long long array_size = atoll(array_size_str);
     if (array_size <= 0) {
-        fprintf(stderr, "Error: Invalid array size %d\n", array_size);
+        fprintf(stderr, "Error: Invalid array size %lld\n", array_size);
         return 1;
     }
 
     // Выделение памяти
-    double *a = malloc(array_size * sizeof(double));
-    double *b = malloc(array_size * sizeof(double));
-    double *res_add = malloc(array_size * sizeof(double));
-    double *res_sub = malloc(array_size * sizeof(double));
-    double *res_mul = malloc(array_size * sizeof(double));
-    double *res_div = malloc(array_size * sizeof(double));
+    double *a = malloc((size_t)array_size * sizeof(double));
+    double *b = malloc((size_t)array_size * sizeof(double));
+    double *res_add = malloc((size_t)array_size * sizeof(double));
+    double *res_sub = malloc((size_t)array_size * sizeof(double));
+    double *res_mul = malloc((size_t)array_size * sizeof(double));
+    double *res_div = malloc((size_t)array_size * sizeof(double));
 
     // Инициализация массивов
     srand(time(NULL));
     fill_array(a, array_size);
     fill_array(b, array_size);
 
-    // Выполнение операций с замером времени
-    OperationTimes times;
-    array_ops_timed(a, b, res_add, res_sub, res_mul, res_div, array_size, &times);
+    // Режим: fused (по умолчанию) или timed (отдельный проход на операцию)
+    char* elementwise_str = getenv("ELEMENTWISE");
+    int fused = !(elementwise_str && strcmp(elementwise_str, "timed") == 0);
+
+    // Деление в режиме timed: exact (по умолчанию) или fast, через обратную
+    // величину, не дальше DIV_FAST_MAX_ULP от точного (common/fast_div.h)
+    int div_mode = div_mode_from_env();
+    if (div_mode < 0) {
+        fprintf(stderr, "Error: DIV_MODE must be exact or fast\n");
+        return 1;
+    }
+    EwOp div_op = div_mode ? EW_DIV_FAST : EW_DIV;
+
+    // Выполнение операций: прогрев до стабилизации, затем ITERATIONS
+    // замеров (по умолчанию 10)
+    BenchConfig bench;
+    BenchSeries series[4];
+    BenchStats stats[4];
+    BenchWarmup warmup = {{0}, 0};
+    MemUsage mem_before, mem_after, mem;
+    int num_series = fused ? 1 : 4, warming, warmup_iterations = 0;
+    bench_config_from_env(&bench, 10);
+    for (int i = 0; i < num_series; i++) {
+        if (bench_series_init(&series[i], fused ? fused_series[i] : timed_series[i], bench.iterations) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return 1;
+        }
+    }
+    warming = bench.max_warmup > 0;
+    mem_usage_now(&mem_before);
+
+    for (int measured = 0; measured < bench.iterations;) {
+        OperationTimes times = {0};
+        double samples[4], total = 0.0;
+        if (fused) {
+            array_ops_fused(a, b, res_add, res_sub, res_mul, res_div, array_size, &times);
+        } else {
+            array_ops_timed(a, b, res_add, res_sub, res_mul, res_div, array_size, div_op, &times);
+        }
+        operation_samples(&times, fused, samples);
+        for (int i = 0; i < num_series; i++) total += samples[i];
+
+        if (warming) {
+            warmup_iterations++;
+            warming = !bench_warmup_done(&warmup, &bench, total);
+            if (!warming) mem_usage_now(&mem_before);
+        } else {
+            for (int i = 0; i < num_series; i++) bench_series_add(&series[i], samples[i]);
+            measured++;
+        }
+    }
+    mem_usage_now(&mem_after);
+    mem = mem_usage_delta(&mem_before, &mem_after);
+    for (int i = 0; i < num_series; i++) bench_stats(&series[i], &bench, &stats[i]);
 
     // Вывод результатов
-    printf("Sequential version results:\n");
-    printf("Array size: %d\n", array_size);
-    printf("\nExecution times:\n");
-    printf("Addition time:    %.3f ms\n", times.add_time * 1000);
-    printf("Subtraction time: %.3f ms\n", times.sub_time * 1000);
-    printf("Multiplication time: %.3f ms\n", times.mul_time * 1000);
-    printf("Division time:    %.3f ms\n", times.div_time * 1000);
+    if (bench_human_output(&bench)) {
+        printf("Sequential version results:\n");
+        printf("Array size: %lld\n", array_size);
+        printf("\nExecution times (median of %d):\n", bench.iterations);
+        if (fused) {
+            printf("Fused (all four) time: %.3f ms\n", stats[0].median * 1000);
+        } else {
+            printf("Addition time:    %.3f ms\n", stats[0].median * 1000);
+            printf("Subtraction time: %.3f ms\n", stats[1].median * 1000);
+            printf("Multiplication time: %.3f ms\n", stats[2].median * 1000);
+            printf("Division time:    %.3f ms (%s, %s)\n", stats[3].median * 1000, div_mode ? "fast" : "exact",
+                   div_kernel(div_mode)->name);
+        }
+        printf("Memory traffic: %.1f MB (four passes: %.1f MB)\n",
+               ew_traffic_bytes((size_t)array_size, fused) / 1e6,
+               ew_traffic_bytes((size_t)array_size, 0) / 1e6);
+        printf("Memory (measured iterations): ");
+        mem_usage_print(&mem);
+    }
+    BenchParam params[3];
+    bench_param(&params[0], "array_size", "%.0f", array_size);
+    bench_param_str(&params[1], "elementwise", fused ? "fused" : "timed");
+    bench_param_str(&params[2], "div_mode", div_mode ? "fast" : "exact");
+    bench_report(&bench, "task3_sequential", series, num_series, params, 3, warmup_iterations);
+    for (int i = 0; i < num_series; i++) bench_series_free(&series[i]);
 
     // Освобождение памяти
     free(a); free(b);
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/bench.h"
+#include "../common/job.h"
+
+// Local client of the resident server (server.c): sends one request
+// (common/job.h) REPEAT times, each over its own connection, prints the
+// last reply and the round-trip latency per request. The server's own
+// "total=" time is subtracted from the round trip to show what the socket
+// and broadcast cost on top of the job.
+//
+//   job_client sum size=1000000
+//   job_client -n 100 stats size=100000 seed=7
+//   job_client expr size=1000000 expr=(a+b)*c/d
+//   job_client shutdown
+//
+// SERVER_SOCKET selects the socket, as for the server. Exits with 1 when a
+// request fails or the server answers with an error.
+
+// Value of " key=" in a reply line, 0.0 when absent
+static double reply_value(const char* reply, const char* key) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), " %s=", key);
+    const char* at = strstr(reply, pattern);
+    return at ? atof(at + strlen(pattern)) : 0.0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = job_socket_path();
+    char request[JOB_LINE_MAX] = "", reply[JOB_LINE_MAX];
+    int repeat = 1, arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+        repeat = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (arg >= argc || repeat < 1) {
+        fprintf(stderr, "Usage: %s [-n REPEAT] OPERATION [key=value ...]\n", argv[0]);
+        return 1;
+    }
+    for (; arg < argc; arg++) {
+        if (strlen(request) + strlen(argv[arg]) + 2 > sizeof(request)) {
+            fprintf(stderr, "Error: Request longer than %d characters\n", JOB_LINE_MAX - 1);
+            return 1;
+        }
+        if (request[0]) strcat(request, " ");
+        strcat(request, argv[arg]);
+    }
+
+    BenchSeries round_trip, overhead;
+    if (bench_series_init(&round_trip, "round_trip", repeat) != 0 ||
+        bench_series_init(&overhead, "overhead", repeat) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for latency samples\n");
+        return 1;
+    }
+    for (int i = 0; i < repeat; i++) {
+        double start = bench_now();
+        if (job_request(path, request, reply) != 0) {
+            fprintf(stderr, "Error: No reply from the server on %s\n", path);
+            return 1;
+        }
+        double elapsed = bench_now() - start;
+        if (strncmp(reply, "ok", 2) != 0) {
+            printf("%s\n", reply);
+            return 1;
+        }
+        bench_series_add(&round_trip, elapsed);
+        bench_series_add(&overhead, elapsed - reply_value(reply, "total"));
+    }
+    printf("%s\n", reply);
+
+    BenchConfig cfg = {repeat, 0, 0.0, 1e9, BENCH_TEXT, NULL};
+    BenchStats rt, extra;
+    bench_stats(&round_trip, &cfg, &rt);
+    bench_stats(&overhead, &cfg, &extra);
+    printf("Latency over %d request%s: min %.6f, median %.6f, p90 %.6f, p99 %.6f sec\n", repeat,
+           repeat > 1 ? "s" : "", rt.min, rt.median, rt.p90, rt.p99);
+    printf("Outside the job (socket, broadcast): median %.6f sec\n", extra.median);
+    bench_series_free(&round_trip);
+    bench_series_free(&overhead);
+    return 0;
+}
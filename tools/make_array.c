@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/philox.h"
+#include "../common/arrayfile.h"
+
+// Writes an array file (common/arrayfile.h) of Philox data, the same values
+// the programs generate with DATA_GEN=local: int32 in [0, 100), float64 in
+// [1, 101). Generated and written in blocks, so any count fits in memory.
+//
+//   make_array int32 100000000 sum.arr [seed]
+//   make_array float64 30000000 a.arr [seed] 0
+//   make_array float64 30000000 b.arr [seed] 1
+//
+// Task1.c reads INPUT_FILE, Task 3.c INPUT_A and INPUT_B.
+
+#define BLOCK_ELEMENTS (1 << 20)
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s int32|float64 COUNT PATH [SEED] [STREAM]\n", argv[0]);
+        return 1;
+    }
+    uint32_t dtype = strcmp(argv[1], "int32") == 0 ? ARRAYFILE_INT32
+                   : strcmp(argv[1], "float64") == 0 ? ARRAYFILE_FLOAT64 : 0;
+    long long count = atoll(argv[2]);
+    const char* path = argv[3];
+    uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 12345;
+    uint32_t stream = argc > 5 ? (uint32_t)atoi(argv[5]) : 0;
+    if (dtype == 0 || count < 0) {
+        fprintf(stderr, "Error: Invalid type %s or count %s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    size_t esize = arrayfile_dtype_size(dtype);
+    void* block = malloc(BLOCK_ELEMENTS * esize);
+    FILE* out = fopen(path, "wb");
+    if (!block || !out) {
+        fprintf(stderr, "Error: Cannot write %s\n", path);
+        free(block);
+        if (out) fclose(out);
+        return 1;
+    }
+
+    // Header with the checksum once all blocks are written
+    ArrayFileHeader header;
+    uint64_t checksum = 0;
+    arrayfile_header_init(&header, dtype, (uint64_t)count, 0);
+    int rc = arrayfile_write_header(out, &header);
+    for (long long first = 0; rc == 0 && first < count; first += BLOCK_ELEMENTS) {
+        size_t n = (size_t)(count - first < BLOCK_ELEMENTS ? count - first : BLOCK_ELEMENTS);
+        if (dtype == ARRAYFILE_INT32) {
+            philox_fill_int((int*)block, (size_t)first, n, seed, stream, 100);
+        } else {
+            philox_fill_double((double*)block, (size_t)first, n, seed, stream, 1, 100);
+        }
+        checksum += arrayfile_checksum(block, dtype, (uint64_t)first, n);
+        if (fwrite(block, esize, n, out) != n) rc = -1;
+    }
+    header.checksum = checksum;
+    if (rc == 0) rc = arrayfile_write_header(out, &header);
+    if (fclose(out) != 0) rc = -1;
+    free(block);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Writing %s failed\n", path);
+        return 1;
+    }
+    printf("%s: %lld %s elements, checksum %016llx\n", path, count, arrayfile_dtype_name(dtype),
+           (unsigned long long)checksum);
+    return 0;
+}